@@ -0,0 +1,93 @@
+# *****************************************************************************
+# Host (native) build of a project against the M0N0 simulator
+#
+# Include at the end of a project Makefile (after MAKEFILE_DIR, M0N0_*_DIR 
+# are set) and run:
+#   make host
+#   ./build_host/m0n0_host
+# *****************************************************************************
+M0N0_HOST_DIR		:= $(abspath $(dir $(lastword $(MAKEFILE_LIST))) )
+HOST_BUILD_DIR		:= build_host
+HOST_TARGET		= m0n0_host
+
+HOST_CC  = gcc
+HOST_CPP = g++
+HOST_LD  = g++
+
+HOST_CCFLAGS  = -DM0N0_HOST
+HOST_CCFLAGS += -O2 -g
+HOST_CCFLAGS += -Wall -Werror
+HOST_CCFLAGS += -Wshadow
+HOST_CCFLAGS += -Wextra
+# the target is 32-bit: addresses are passed around as uint32_t
+HOST_CCFLAGS += -Wno-int-to-pointer-cast
+HOST_CCFLAGS += -fno-strict-aliasing
+# custom print
+HOST_CCFLAGS += -DM0N0_PRINT=1
+# m0n0_s2
+HOST_CCFLAGS += -DM0N0_S2=1
+HOST_CCFLAGS += -DARMCM33_DSP_FP -DCMSIS_device_header=\"ARMCM33_DSP_FP.h\" 
+# the simulated STDOUT interrupt (see M0N0_STDOUT_BUFFERED)
+HOST_CCFLAGS += -DM0N0_STDOUT_IRQ_NUM=2
+#HOST_CCFLAGS += -DM0N0_STDOUT_BUFFERED
+#HOST_CCFLAGS += -DM0N0_PROFILE
+#HOST_CCFLAGS += -DM0N0_PC_SAMPLE
+# interrupts.h defines the interrupt counters (shared by C and C++)
+HOST_CFLAGS   = --std=gnu11 -fcommon
+HOST_CPPFLAGS = --std=gnu++11
+HOST_CPPFLAGS += -DDEFAULT_LOG_LEVEL=DEBUG
+HOST_CPPFLAGS += -DEXTRA_CHECKS
+#HOST_CPPFLAGS += -DM0N0_SHADOW_REGS
+#HOST_CPPFLAGS += -DM0N0_REG_TRACE
+#HOST_CPPFLAGS += -DM0N0_LOG_TOKENIZED
+#HOST_CPPFLAGS += -DM0N0_LOG_CONSTEXPR
+#HOST_CPPFLAGS += -DM0N0_LOG_MIN_LEVEL=1
+HOST_LDFLAGS  = -lm
+
+# The host include directory goes first: it replaces the CMSIS device headers
+HOST_INCLUDE_PATHS  = -I$(M0N0_HOST_DIR)/include
+HOST_INCLUDE_PATHS += -I$(M0N0_SYSTEM_DIR)/include
+HOST_INCLUDE_PATHS += -I$(M0N0_PRINTF_DIR)/include
+HOST_INCLUDE_PATHS += -I$(M0N0_TEST_UTIL_DIR)/include
+HOST_INCLUDE_PATHS += -I$(MAKEFILE_DIR)/include
+
+# No system_m0n0.c or startup file: the simulator provides them
+HOST_C_FILES += $(M0N0_PRINTF_DIR)/src/m0n0_printf.c
+HOST_C_FILES += $(M0N0_SYSTEM_DIR)/src/m0n0_defs.c
+HOST_C_FILES += $(M0N0_SYSTEM_DIR)/src/interrupts.c
+HOST_CPP_FILES += $(M0N0_SYSTEM_DIR)/src/m0n0.cpp
+HOST_CPP_FILES += $(M0N0_SYSTEM_DIR)/src/sysutil.cpp
+HOST_CPP_FILES += $(M0N0_TEST_UTIL_DIR)/src/tc_functions.cpp
+HOST_CPP_FILES += $(M0N0_HOST_DIR)/src/m0n0_sim.cpp
+HOST_CPP_FILES += $(MAKEFILE_DIR)/src/main.cpp
+HOST_C_FILES += $(HOST_EXTRA_C_FILES)
+HOST_CPP_FILES += $(HOST_EXTRA_CPP_FILES)
+
+HOST_C_OBJECTS = $(addprefix $(HOST_BUILD_DIR)/, $(notdir $(HOST_C_FILES:.c=.o)))
+HOST_CPP_OBJECTS = $(addprefix $(HOST_BUILD_DIR)/, $(notdir $(HOST_CPP_FILES:.cpp=.o)))
+
+vpath %.c $(dir $(HOST_C_FILES))
+vpath %.cpp $(dir $(HOST_CPP_FILES))
+
+.PHONY: host
+.PHONY: host_clean
+
+host: $(HOST_BUILD_DIR)/$(HOST_TARGET)
+
+host_clean:
+	rm -rf $(HOST_BUILD_DIR)
+
+$(HOST_BUILD_DIR):
+	$(MKDIR_P) $(HOST_BUILD_DIR)
+
+$(HOST_BUILD_DIR)/%.o: %.c | $(HOST_BUILD_DIR)
+	$(V)echo Compiling file for host using gcc: $(notdir $<)
+	$(V)$(HOST_CC) $(HOST_CCFLAGS) $(HOST_CFLAGS) $(HOST_INCLUDE_PATHS) -c -o $@ $<
+
+$(HOST_BUILD_DIR)/%.o: %.cpp | $(HOST_BUILD_DIR)
+	$(V)echo Compiling file for host using g++: $(notdir $<)
+	$(V)$(HOST_CPP) $(HOST_CCFLAGS) $(HOST_CPPFLAGS) $(HOST_INCLUDE_PATHS) -c -o $@ $<
+
+$(HOST_BUILD_DIR)/$(HOST_TARGET): $(HOST_C_OBJECTS) $(HOST_CPP_OBJECTS)
+	$(V)echo Linking host target: $@
+	$(V)$(HOST_LD) $^ $(HOST_LDFLAGS) -o $@
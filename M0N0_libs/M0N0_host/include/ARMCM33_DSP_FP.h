@@ -0,0 +1,256 @@
+
+/*
+ * Copyright (c) 2020, Arm Limited
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+#ifndef ARMCM33_DSP_FP_H
+#define ARMCM33_DSP_FP_H
+
+/**
+@file
+@brief Host (native) build replacement for the CMSIS ARMCM33_DSP_FP device
+    header
+
+Provides the subset of the CMSIS core definitions used by the M0N0 libraries.
+The core peripherals (SCB, SysTick, DWT and CoreDebug) are plain structures
+updated by the M0N0 simulator (m0n0_sim.cpp), and the NVIC and intrinsic
+functions are implemented by the simulator. Only used with -DM0N0_HOST.
+*/
+
+#include <stdint.h>
+
+#ifndef M0N0_HOST
+#error "The M0N0_host CMSIS header is only for host builds (M0N0_HOST)"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Interrupt numbers (as ARMCM33_DSP_FP.h)
+ */
+typedef enum IRQn {
+    NonMaskableInt_IRQn   = -14,
+    HardFault_IRQn        = -13,
+    MemoryManagement_IRQn = -12,
+    BusFault_IRQn         = -11,
+    UsageFault_IRQn       = -10,
+    SecureFault_IRQn      =  -9,
+    SVCall_IRQn           =  -5,
+    DebugMonitor_IRQn     =  -4,
+    PendSV_IRQn           =  -2,
+    SysTick_IRQn          =  -1,
+    Interrupt0_IRQn       =   0,
+    Interrupt1_IRQn       =   1,
+    Interrupt2_IRQn       =   2,
+    Interrupt3_IRQn       =   3,
+    Interrupt4_IRQn       =   4,
+    Interrupt5_IRQn       =   5,
+    Interrupt6_IRQn       =   6,
+    Interrupt7_IRQn       =   7,
+    Interrupt8_IRQn       =   8,
+    Interrupt9_IRQn       =   9
+} IRQn_Type;
+
+#define __I     volatile const
+#define __O     volatile
+#define __IO    volatile
+#define __IM    volatile const
+#define __OM    volatile
+#define __IOM   volatile
+
+#define __ASM                   __asm
+#define __INLINE                inline
+#define __STATIC_INLINE         static inline
+#define __STATIC_FORCEINLINE    __attribute__((always_inline)) static inline
+#define __WEAK                  __attribute__((weak))
+#define __PACKED                __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)            __attribute__((aligned(x)))
+
+/** System Control Block (subset)
+ */
+typedef struct {
+    __IM  uint32_t CPUID;
+    __IOM uint32_t ICSR;
+    __IOM uint32_t VTOR;
+    __IOM uint32_t AIRCR;
+    __IOM uint32_t SCR;
+    __IOM uint32_t CCR;
+    __IOM uint32_t CFSR;
+    __IOM uint32_t HFSR;
+    __IOM uint32_t DFSR;
+    __IOM uint32_t MMFAR;
+    __IOM uint32_t BFAR;
+    __IOM uint32_t AFSR;
+    __IOM uint32_t CPACR;
+} SCB_Type;
+
+#define SCB_SCR_SLEEPONEXIT_Msk     (1UL << 1)
+#define SCB_SCR_SLEEPDEEP_Msk       (1UL << 2)
+#define SCB_CCR_UNALIGN_TRP_Msk     (1UL << 3)
+
+/** System Timer (SysTick)
+ */
+typedef struct {
+    __IOM uint32_t CTRL;
+    __IOM uint32_t LOAD;
+    __IOM uint32_t VAL;
+    __IM  uint32_t CALIB;
+} SysTick_Type;
+
+#define SysTick_CTRL_ENABLE_Msk     (1UL << 0)
+#define SysTick_CTRL_TICKINT_Msk    (1UL << 1)
+#define SysTick_CTRL_CLKSOURCE_Msk  (1UL << 2)
+#define SysTick_CTRL_COUNTFLAG_Msk  (1UL << 16)
+#define SysTick_LOAD_RELOAD_Msk     (0xFFFFFFUL)
+
+/** Core Debug (subset)
+ */
+typedef struct {
+    __IOM uint32_t DHCSR;
+    __OM  uint32_t DCRSR;
+    __IOM uint32_t DCRDR;
+    __IOM uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+
+extern SCB_Type m0n0_host_scb;
+extern SysTick_Type m0n0_host_systick;
+extern CoreDebug_Type m0n0_host_coredebug;
+
+#define SCB         (&m0n0_host_scb)
+#define SysTick     (&m0n0_host_systick)
+#define CoreDebug   (&m0n0_host_coredebug)
+
+/** Reads the simulated CPU cycle count (host time at SystemCoreClock)
+ */
+uint32_t m0n0_host_cyccnt_read(void);
+/** Sets the simulated CPU cycle count
+ */
+void m0n0_host_cyccnt_write(uint32_t value);
+
+#ifdef __cplusplus
+}
+
+/** DWT CYCCNT: reads/writes are forwarded to the simulator (which derives 
+ * the cycle count from the host clock)
+ */
+struct M0N0_Host_Cyccnt {
+    operator uint32_t() const { return m0n0_host_cyccnt_read(); }
+    M0N0_Host_Cyccnt& operator=(uint32_t value) {
+        m0n0_host_cyccnt_write(value);
+        return *this;
+    }
+};
+
+/** Data Watchpoint and Trace unit (CYCCNT only, C++ only)
+ */
+typedef struct {
+    __IOM uint32_t CTRL;
+    M0N0_Host_Cyccnt CYCCNT;
+} DWT_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+
+extern DWT_Type m0n0_host_dwt;
+#define DWT         (&m0n0_host_dwt)
+
+extern "C" {
+#endif
+
+/* NVIC (implemented by the simulator) */
+void __NVIC_EnableIRQ(IRQn_Type IRQn);
+void __NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t __NVIC_GetEnableIRQ(IRQn_Type IRQn);
+void __NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void __NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t __NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void __NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+#define NVIC_EnableIRQ          __NVIC_EnableIRQ
+#define NVIC_DisableIRQ         __NVIC_DisableIRQ
+#define NVIC_GetEnableIRQ       __NVIC_GetEnableIRQ
+#define NVIC_SetPendingIRQ      __NVIC_SetPendingIRQ
+#define NVIC_ClearPendingIRQ    __NVIC_ClearPendingIRQ
+#define NVIC_GetPendingIRQ      __NVIC_GetPendingIRQ
+#define NVIC_SetPriority        __NVIC_SetPriority
+
+/* Core intrinsics */
+/** Wait for interrupt: the simulator advances to the next interrupt (or
+ * shuts down if SLEEPDEEP is set)
+ */
+void __WFI(void);
+#define __WFE __WFI
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+/** The active exception number (0 in thread mode) */
+uint32_t __get_IPSR(void);
+
+__STATIC_FORCEINLINE void __NOP(void) {}
+__STATIC_FORCEINLINE void __SEV(void) {}
+__STATIC_FORCEINLINE void __DSB(void) { __sync_synchronize(); }
+__STATIC_FORCEINLINE void __DMB(void) { __sync_synchronize(); }
+__STATIC_FORCEINLINE void __ISB(void) { __sync_synchronize(); }
+
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value) {
+    return (value == 0U) ? 32U : (uint8_t)__builtin_clz(value);
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value) {
+    uint32_t result = 0;
+    for (int i = 0; i < 32; i++) {
+        result = (result << 1) | ((value >> i) & 1U);
+    }
+    return result;
+}
+
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+__STATIC_FORCEINLINE int32_t __SSAT(int32_t val, uint32_t sat) {
+    const int32_t max = (int32_t)((1U << (sat - 1U)) - 1U);
+    const int32_t min = -1 - max;
+    return (val > max) ? max : ((val < min) ? min : val);
+}
+
+__STATIC_FORCEINLINE uint32_t __USAT(int32_t val, uint32_t sat) {
+    const uint32_t max = ((1U << sat) - 1U);
+    return (val > (int32_t)max) ? max : ((val < 0) ? 0U : (uint32_t)val);
+}
+
+__STATIC_FORCEINLINE uint32_t __SMLAD(uint32_t op1, uint32_t op2, uint32_t op3) {
+    int32_t a = (int16_t)(op1 & 0xFFFF) * (int16_t)(op2 & 0xFFFF);
+    int32_t b = (int16_t)(op1 >> 16) * (int16_t)(op2 >> 16);
+    return (uint32_t)((int32_t)op3 + a + b);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARMCM33_DSP_FP_H
@@ -0,0 +1,93 @@
+
+/*
+ * Copyright (c) 2020, Arm Limited
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+#ifndef M0N0_SIM_H
+#define M0N0_SIM_H
+
+#include <stdint.h>
+
+/**
+@file
+@brief Simulated M0N0 memory map for the host (native) build
+
+The simulator implements the M0N0 memory map on the host and registers its
+read/write drivers with M0N0_set_host_drivers (before main is called), so 
+the unmodified libraries and examples run natively. It models:
+ - The RTC, counting at 33 kHz from the host clock (STATUS_2 and STATUS_4)
+ - STDOUT (written to the host stdout) and STDIN (read from the host stdin)
+ - Shutdown RAM (SHRAM), the control registers (including the set/clear 
+   aliases), GPIO and AES register storage (AES data is not encrypted)
+ - SPI, with PCSM register writes via slave select SS3 (performance level,
+   ROM power-on delay, RTC wakeup and the interrupt timer) and a temperature
+   sensor on SS0
+ - STATUS_7 (DEVE, performance level, ROM power-on delay and memory remap)
+ - SysTick, the DWT cycle counter and the PCSM interrupt timer (IRQ5, or
+   IRQ1 with SPI auto-sampling)
+
+Interrupts are delivered between register accesses and in __WFI. A WFI with
+SLEEPDEEP set shuts down: with an RTC wakeup set, the simulator waits for
+the wakeup time and restarts the program with SHRAM and the PCSM state 
+retained (as on the chip), otherwise the program exits. Set the environment
+variable M0N0_SIM_NO_REBOOT to exit on every shutdown. Set M0N0_SIM_RTC_START
+to start the RTC from a given value (e.g. 0xFFFFF000, to test the rollover of
+the RTC LSBs). 
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The simulated RTC frequency (Hz)
+ */
+#define M0N0_SIM_RTC_HZ 33000
+
+/** Returns the current (simulated) RTC tick count
+ *
+ * @return RTC ticks since the simulated power-on
+ */
+uint64_t m0n0_sim_get_rtc(void);
+
+/** Delivers any pending (and enabled) interrupts
+ *
+ * Called on every simulated register access, so that interrupts occur 
+ * while the program polls registers. 
+ *
+ * @return The number of interrupt handlers called
+ */
+uint32_t m0n0_sim_poll(void);
+
+/** Returns the number of simulated register accesses
+ *
+ * @return The total number of reads and writes to the memory map
+ */
+uint64_t m0n0_sim_get_access_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // M0N0_SIM_H
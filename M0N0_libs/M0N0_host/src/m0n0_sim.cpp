@@ -0,0 +1,768 @@
+
+/*
+ * Copyright (c) 2020, Arm Limited
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
+
+#include "m0n0_sim.h"
+
+extern "C" {
+    #include "m0n0_defs.h"
+}
+
+// Interrupt handlers (weak references: only called if linked)
+extern "C" {
+    void SysTick_Handler(void) __attribute__((weak));
+    void Interrupt0_Handler(void) __attribute__((weak));
+    void Interrupt1_Handler(void) __attribute__((weak));
+    void Interrupt2_Handler(void) __attribute__((weak));
+    void Interrupt3_Handler(void) __attribute__((weak));
+    void Interrupt4_Handler(void) __attribute__((weak));
+    void Interrupt5_Handler(void) __attribute__((weak));
+    void Interrupt6_Handler(void) __attribute__((weak));
+    void Interrupt7_Handler(void) __attribute__((weak));
+    void Interrupt8_Handler(void) __attribute__((weak));
+    void Interrupt9_Handler(void) __attribute__((weak));
+}
+
+// ---------- CMSIS core peripherals ---------- //
+extern "C" {
+    SCB_Type m0n0_host_scb = {};
+    SysTick_Type m0n0_host_systick = {};
+    CoreDebug_Type m0n0_host_coredebug = {};
+    uint32_t SystemCoreClock = 25000000; // as system_m0n0.c
+}
+DWT_Type m0n0_host_dwt;
+
+namespace {
+
+const uint32_t kNumIrqs = 10;
+// STDOUT FIFO depth and the time for ADP to read one character
+const uint32_t kStdoutFifoDepth = 8;
+const uint64_t kStdoutCharNs = 10000;
+const uint32_t kSysTickPending = (1 << kNumIrqs);
+const uint32_t kNumControlRegs = 7;
+const uint32_t kNumPcsmRegs = 0x40;
+const uint32_t kShramWords = MEM_MAP_SHRAM_SIZE / 4;
+const uint32_t kAesWords = (AES_SIZE / 4) + 1;
+const uint8_t kTemperatureC = 25; // temperature sensor (SS0) reading
+const uint8_t kAdcSample = 0x80; // auto-sample (SS2) reading
+
+const Handler_Func kIrqHandlers[kNumIrqs] = {
+    Interrupt0_Handler, Interrupt1_Handler, Interrupt2_Handler,
+    Interrupt3_Handler, Interrupt4_Handler, Interrupt5_Handler,
+    Interrupt6_Handler, Interrupt7_Handler, Interrupt8_Handler,
+    Interrupt9_Handler
+};
+
+// PCSM power-on reset values (pcsm.regs.yaml)
+const uint32_t kPcsmPor[kNumPcsmRegs] = {
+    0x000000, 0x394B60, 0x000027, 0x00C0B2, 0x001E20, 0x000000, 0x000000,
+    0x31004E, 0x000F07, 0x000000, 0x000000, 0x000033, 0x000100, 0x000000,
+    0x000000, 0x000000, 0x000000, 0x00001C, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000019,
+    0x000000, 0x000000, 0xFF9E7F, 0xFF9E7F, 0xFF9E7F, 0xFF9E7F, 0xFF9E7C
+};
+
+/** State retained through a (simulated) timed shutdown
+ */
+struct RetainedState {
+    uint64_t power_on_ns;
+    uint32_t pcsm[kNumPcsmRegs];
+    uint32_t shram[kShramWords];
+};
+
+uint64_t host_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+class M0N0Sim {
+    public:
+        M0N0Sim() {
+            this->_power_on();
+        }
+
+        uint64_t rtc() {
+            return ((host_ns() - this->_retained.power_on_ns) 
+                    * M0N0_SIM_RTC_HZ) / 1000000000ULL;
+        }
+
+        uint64_t access_count() {
+            return this->_accesses;
+        }
+
+        uint32_t read(uint32_t address) {
+            this->_accesses++;
+            uint32_t data = this->_read(address);
+            this->poll();
+            return data;
+        }
+
+        void write(uint32_t address, uint32_t data) {
+            this->_accesses++;
+            this->_write(address, data);
+            this->poll();
+        }
+
+        uint32_t cyccnt() {
+            return (uint32_t)(((host_ns() - this->_cyccnt_ns) 
+                    * SystemCoreClock) / 1000000000ULL);
+        }
+
+        void set_cyccnt(uint32_t value) {
+            this->_cyccnt_ns = host_ns() - 
+                    (((uint64_t)value * 1000000000ULL) / SystemCoreClock);
+        }
+
+        void nvic_enable(IRQn_Type irqn, bool enable) {
+            if (irqn < 0 || (uint32_t)irqn >= kNumIrqs) {
+                return; // system exceptions are always enabled
+            }
+            if (enable) {
+                this->_nvic_enabled |= (1 << irqn);
+            } else {
+                this->_nvic_enabled &= ~(1 << irqn);
+            }
+        }
+
+        uint32_t nvic_is_enabled(IRQn_Type irqn) {
+            if (irqn < 0 || (uint32_t)irqn >= kNumIrqs) {
+                return 1;
+            }
+            return (this->_nvic_enabled >> irqn) & 1;
+        }
+
+        void set_pending(IRQn_Type irqn, bool pending) {
+            uint32_t bit = (irqn == SysTick_IRQn) ? kSysTickPending : 
+                    ((irqn >= 0) ? (1u << irqn) : 0);
+            if (pending) {
+                this->_pending |= bit;
+            } else {
+                this->_pending &= ~bit;
+            }
+        }
+
+        uint32_t is_pending(IRQn_Type irqn) {
+            uint32_t bit = (irqn == SysTick_IRQn) ? kSysTickPending : 
+                    ((irqn >= 0) ? (1u << irqn) : 0);
+            return (this->_pending & bit) ? 1 : 0;
+        }
+
+        uint32_t primask() {
+            return this->_primask;
+        }
+
+        uint32_t ipsr() {
+            return this->_ipsr;
+        }
+
+        void set_primask(uint32_t primask) {
+            this->_primask = primask & 1;
+            if (!this->_primask) {
+                this->poll();
+            }
+        }
+
+        // Updates the timers and calls any pending and enabled handlers
+        uint32_t poll() {
+            this->_update_systick();
+            this->_update_inttimer();
+            this->_update_stdout();
+            if (this->_in_handler || this->_primask) {
+                return 0;
+            }
+            uint32_t calls = 0;
+            this->_in_handler = true;
+            while (1) {
+                if (this->_pending & kSysTickPending) {
+                    this->_pending &= ~kSysTickPending;
+                    if (SysTick_Handler) {
+                        this->_ipsr = 16 + SysTick_IRQn;
+                        SysTick_Handler();
+                        calls++;
+                    }
+                    continue;
+                }
+                uint32_t ready = this->_pending & this->_nvic_enabled;
+                if (ready == 0) {
+                    break;
+                }
+                uint32_t irq = __builtin_ctz(ready);
+                this->_pending &= ~(1u << irq);
+                if (kIrqHandlers[irq]) {
+                    this->_ipsr = 16 + irq;
+                    kIrqHandlers[irq]();
+                    calls++;
+                }
+            }
+            this->_ipsr = 0;
+            this->_in_handler = false;
+            return calls;
+        }
+
+        void wfi() {
+            fflush(stdout);
+            if (SCB->SCR & SCB_SCR_SLEEPDEEP_Msk) {
+                this->_shutdown();
+            }
+            while (this->poll() == 0) {
+                if (this->_primask && (this->_pending & this->_nvic_enabled)) {
+                    // wakes up, the handler is called when unmasked
+                    return;
+                }
+                bool systick_on = (SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) &&
+                        (SysTick->CTRL & SysTick_CTRL_TICKINT_Msk);
+                bool stdout_on = this->_stdout_int_ctrl & 
+                        STDOUT_R03_INTERRUPT_ENABLE_BIT_MASK;
+                if (!systick_on && !this->_inttimer_period && !stdout_on && 
+                        !(this->_pending & this->_nvic_enabled)) {
+                    fprintf(stderr, "[m0n0_sim] WFI with no interrupt "
+                            "source enabled, exiting\n");
+                    exit(0);
+                }
+                usleep(100); // sleep until the next interrupt
+            }
+        }
+
+    private:
+        RetainedState _retained;
+        uint32_t _control[kNumControlRegs];
+        uint32_t _aes[kAesWords];
+        uint32_t _spi_clk_divide;
+        uint32_t _spi_control;
+        uint32_t _spi_data_write;
+        uint32_t _spi_data_read;
+        uint32_t _spi_sensor_data;
+        uint32_t _spi_byte_index; // bytes transferred since slave select
+        uint32_t _pcsm_shift; // PCSM write being received via SPI
+        uint32_t _gpio_data;
+        uint32_t _gpio_direction;
+        uint32_t _gpio_interrupt;
+        uint32_t _stdout_int_ctrl;
+        uint32_t _stdout_count; // characters in the FIFO
+        uint64_t _stdout_drain_ns;
+        uint32_t _stdin_int_ctrl;
+        uint32_t _nvic_enabled;
+        uint32_t _pending;
+        uint32_t _primask;
+        bool _in_handler;
+        uint32_t _ipsr;
+        uint64_t _accesses;
+        uint64_t _cyccnt_ns;
+        uint64_t _inttimer_period; // 0 when disabled
+        uint64_t _inttimer_next;
+        uint32_t _systick_ctrl; // last seen SysTick CTRL
+        uint32_t _systick_load; // last seen SysTick LOAD
+        uint64_t _systick_start_ns;
+        uint64_t _systick_periods;
+
+        void _power_on() {
+            memset((void*)this, 0, sizeof(*this));
+            this->_retained.power_on_ns = host_ns();
+            // optional RTC value at power-on (e.g. to test the rollover of 
+            // the RTC LSBs)
+            const char* rtc_start = getenv("M0N0_SIM_RTC_START");
+            if (rtc_start != NULL) {
+                this->_retained.power_on_ns -= 
+                        ((strtoull(rtc_start, NULL, 0) * 1000000000ULL) 
+                        + M0N0_SIM_RTC_HZ - 1) / M0N0_SIM_RTC_HZ;
+            }
+            memcpy(this->_retained.pcsm, kPcsmPor, sizeof(kPcsmPor));
+            this->_restore();
+            // control power-on reset values (control.regs.yaml)
+            this->_control[1] = 0x7FFF0;
+            this->_control[3] = 0x55AA0000;
+            this->_control[4] = 0x00000225;
+            this->_control[6] = 0x0000AA50;
+            // SPI power-on reset values (spi.regs.yaml)
+            this->_spi_clk_divide = 0x4;
+            this->_spi_control = 0x8700;
+            this->_cyccnt_ns = host_ns();
+            this->_set_inttimer(this->_retained.pcsm[PCSM_INTTIMER0_REG]);
+        }
+
+        // Restores SHRAM and the PCSM state after a timed shutdown
+        void _restore() {
+            const char* path = getenv("M0N0_SIM_STATE");
+            if (path == NULL) {
+                return;
+            }
+            FILE* f = fopen(path, "rb");
+            if (f == NULL) {
+                return;
+            }
+            if (fread(&this->_retained, sizeof(this->_retained), 1, f) != 1) {
+                fprintf(stderr, "[m0n0_sim] Could not restore state\n");
+            }
+            fclose(f);
+            remove(path);
+            unsetenv("M0N0_SIM_STATE");
+        }
+
+        [[noreturn]] void _shutdown() {
+            uint32_t* pcsm = this->_retained.pcsm;
+            uint64_t wakeup = ((uint64_t)pcsm[PCSM_RTC_WKUP1_REG] << 24) | 
+                    pcsm[PCSM_RTC_WKUP0_REG];
+            if (wakeup == 0 || getenv("M0N0_SIM_NO_REBOOT")) {
+                fprintf(stderr, "[m0n0_sim] Shutdown, exiting\n");
+                exit(0);
+            }
+#ifdef __linux__
+            fprintf(stderr, "[m0n0_sim] Timed shutdown for %llu RTC ticks\n",
+                    (unsigned long long)wakeup);
+            usleep((useconds_t)((wakeup * 1000000ULL) / M0N0_SIM_RTC_HZ));
+            char path[] = "/tmp/m0n0_sim_XXXXXX";
+            int fd = mkstemp(path);
+            if (fd >= 0) {
+                FILE* f = fdopen(fd, "wb");
+                fwrite(&this->_retained, sizeof(this->_retained), 1, f);
+                fclose(f);
+                setenv("M0N0_SIM_STATE", path, 1);
+                execl("/proc/self/exe", "m0n0", (char*)NULL);
+            }
+            fprintf(stderr, "[m0n0_sim] Could not restart, exiting\n");
+#else
+            fprintf(stderr, "[m0n0_sim] Timed shutdown, exiting\n");
+#endif
+            exit(0);
+        }
+
+        [[noreturn]] void _bus_error(const char* rw, uint32_t address) {
+            fflush(stdout);
+            fprintf(stderr, "[m0n0_sim] Bus error: %s 0x%08X\n", rw, address);
+            abort();
+        }
+
+        uint32_t _status_7() {
+            uint32_t* pcsm = this->_retained.pcsm;
+            uint32_t code_ctrl = pcsm[PCSM_CODE_CTRL_REG];
+            uint32_t val = STATUS_R07_DEVE_CORE_BIT_MASK;
+            val |= (pcsm[PCSM_PERF_CTRL_REG] << STATUS_R07_PERF_BIT_SHIFT) 
+                    & STATUS_R07_PERF_BIT_MASK;
+            val |= STATUS_R07_REAL_TIME_FLAG_BIT_MASK;
+            val |= ((code_ctrl & PCSM_R12_MEMORY_REMAP_BIT_MASK) 
+                    << STATUS_R07_MEMORY_REMAP_BIT_SHIFT);
+            val |= (((code_ctrl & PCSM_R12_ROM_PWR_ON_DELAY_BIT_MASK) 
+                    >> PCSM_R12_ROM_PWR_ON_DELAY_BIT_SHIFT) 
+                    << STATUS_R07_ROM_WAKEUP_DELAY_BIT_SHIFT);
+            return val;
+        }
+
+        bool _in(uint32_t address, uint32_t base, uint32_t size) {
+            return (address >= base) && (address < (base + size));
+        }
+
+        uint32_t _read(uint32_t address) {
+            if (_in(address, MEM_MAP_SHRAM_BASE, MEM_MAP_SHRAM_SIZE)) {
+                return this->_retained.shram[(address - MEM_MAP_SHRAM_BASE)/4];
+            }
+            if (_in(address, CONTROL_BASE_ADDR, kNumControlRegs * 4)) {
+                return this->_control[(address - CONTROL_BASE_ADDR) / 4];
+            }
+            if (_in(address, AES_BASE_ADDR, AES_SIZE + 4)) {
+                if (address == AES_STATUS_REG) {
+                    return 1; // always complete
+                }
+                return this->_aes[(address - AES_BASE_ADDR) / 4];
+            }
+            switch (address) {
+                case STATUS_STATUS_2_REG: 
+                    return (uint32_t)this->rtc();
+                case STATUS_STATUS_4_REG: 
+                    return (uint32_t)(this->rtc() >> 32) 
+                        & STATUS_R04_RTC_MSBS_BIT_MASK;
+                case STATUS_STATUS_7_REG: 
+                    return this->_status_7();
+                case STATUS_STATUS_0_REG:
+                case STATUS_STATUS_1_REG:
+                case STATUS_STATUS_3_REG:
+                case STATUS_STATUS_5_REG:
+                    return 0;
+                case STDOUT_WDATA_REG:
+                case STDOUT_RDATA_REG:
+                case STDIN_WDATA_REG:
+                    return 0;
+                case STDOUT_STATUS_REG: 
+                    return this->_stdout_full() ? STDOUT_R02_TXF_BIT_MASK : 0;
+                case STDOUT_INT_CTRL_REG: 
+                    return this->_stdout_int_ctrl | (this->_stdout_full() ? 
+                            0 : STDOUT_R03_FIFO_NOT_FULL_BIT_MASK);
+                case STDIN_STATUS_REG:
+                    return this->_stdin_ready() ? 0 : STDIN_R02_RXE_BIT_MASK;
+                case STDIN_RDATA_REG: {
+                    char c = 0;
+                    if (::read(0, &c, 1) != 1) {
+                        c = 0;
+                    }
+                    return (uint8_t)c;
+                }
+                case STDIN_INT_CTRL_REG:
+                    return this->_stdin_int_ctrl;
+                case SPI_STATUS_REG: 
+                    return 0; // never busy
+                case SPI_DATA_WRITE_REG:
+                    return this->_spi_data_write;
+                case SPI_DATA_READ_REG:
+                    return this->_spi_data_read;
+                case SPI_CLK_DIVIDE_REG:
+                    return this->_spi_clk_divide;
+                case SPI_CONTROL_REG:
+                    return this->_spi_control;
+                case SPI_SENSOR_DATA_REG:
+                    return this->_spi_sensor_data;
+                case GPIO_DATA_REG:
+                    return this->_gpio_data & 0xF;
+                case GPIO_DIRECTION_REG:
+                    return this->_gpio_direction;
+                case GPIO_INTERRUPT_REG:
+                    return this->_gpio_interrupt;
+                default:
+                    this->_bus_error("read", address);
+            }
+        }
+
+        void _write(uint32_t address, uint32_t data) {
+            if (_in(address, MEM_MAP_SHRAM_BASE, MEM_MAP_SHRAM_SIZE)) {
+                this->_retained.shram[(address - MEM_MAP_SHRAM_BASE)/4] = data;
+                return;
+            }
+            if (_in(address, CONTROL_BASE_ADDR, kNumControlRegs * 4)) {
+                this->_control[(address - CONTROL_BASE_ADDR) / 4] = data;
+                return;
+            }
+            if (_in(address, CONTROL_BASE_ADDR + CONTROL_SET_OFFSET, 
+                    kNumControlRegs * 4)) {
+                this->_control[(address - CONTROL_BASE_ADDR - 
+                        CONTROL_SET_OFFSET) / 4] |= data;
+                return;
+            }
+            if (_in(address, CONTROL_BASE_ADDR + CONTROL_CLR_OFFSET, 
+                    kNumControlRegs * 4)) {
+                this->_control[(address - CONTROL_BASE_ADDR - 
+                        CONTROL_CLR_OFFSET) / 4] &= ~data;
+                return;
+            }
+            if (_in(address, AES_BASE_ADDR, AES_SIZE)) {
+                // data registers echo (no encryption is modelled)
+                this->_aes[(address - AES_BASE_ADDR) / 4] = data;
+                return;
+            }
+            switch (address) {
+                case STDOUT_WDATA_REG:
+                    if (!this->_stdout_full()) {
+                        this->_stdout_count++;
+                    }
+                    putchar((int)(data & STDOUT_WRITE_CHAR_BIT_MASK));
+                    return;
+                case STDOUT_INT_CTRL_REG:
+                    this->_stdout_int_ctrl = data;
+                    return;
+                case STDIN_INT_CTRL_REG:
+                    this->_stdin_int_ctrl = data;
+                    return;
+                case SPI_COMMAND_REG:
+                    if (data & 1) {
+                        this->_spi_transfer();
+                    }
+                    return;
+                case SPI_DATA_WRITE_REG:
+                    this->_spi_data_write = data & 0xFF;
+                    return;
+                case SPI_CLK_DIVIDE_REG:
+                    this->_spi_clk_divide = data;
+                    return;
+                case SPI_CONTROL_REG:
+                    if ((data ^ this->_spi_control) & 
+                            (SPI_R05_CHIP_SELECT_BIT_MASK | 
+                             SPI_R05_ENABLE_MASK_BIT_MASK)) {
+                        this->_spi_byte_index = 0; // new SPI transaction
+                    }
+                    this->_spi_control = data;
+                    return;
+                case GPIO_DATA_REG:
+                    this->_gpio_data = data & 0xF;
+                    return;
+                case GPIO_DIRECTION_REG:
+                    this->_gpio_direction = data & 0xF;
+                    return;
+                case GPIO_INTERRUPT_REG:
+                    this->_gpio_interrupt = data;
+                    return;
+                default:
+                    this->_bus_error("write", address);
+            }
+        }
+
+        bool _stdin_ready() {
+            struct pollfd pfd;
+            pfd.fd = 0;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            return (::poll(&pfd, 1, 0) > 0) && (pfd.revents & POLLIN);
+        }
+
+        // One SPI byte transfer to the selected slave
+        void _spi_transfer() {
+            uint32_t cs = (this->_spi_control & SPI_R05_CHIP_SELECT_BIT_MASK) 
+                    >> SPI_R05_CHIP_SELECT_BIT_SHIFT;
+            uint8_t tx = (uint8_t)this->_spi_data_write;
+            uint8_t rx = 0;
+            if (cs == SS3) { 
+                // PCSM: address byte followed by 24-bit data (MSB first)
+                this->_pcsm_shift = (this->_pcsm_shift << 8) | tx;
+                if (this->_spi_byte_index % 4 == 3) {
+                    this->_pcsm_write((this->_pcsm_shift >> 24) & 0xFF,
+                            this->_pcsm_shift & 0xFFFFFF);
+                }
+            } else if (cs == SS0) { 
+                // temperature sensor (13-bit, 0.0625 C LSB, in [15:3])
+                uint16_t temp_reg = (uint16_t)(kTemperatureC << 7);
+                if (this->_spi_byte_index == 0) {
+                    rx = (uint8_t)(temp_reg >> 8);
+                } else if (this->_spi_byte_index == 1) {
+                    rx = (uint8_t)temp_reg;
+                }
+            }
+            this->_spi_byte_index++;
+            this->_spi_data_read = rx;
+        }
+
+        void _pcsm_write(uint32_t address, uint32_t data) {
+            if (address >= kNumPcsmRegs) {
+                fprintf(stderr, "[m0n0_sim] Invalid PCSM address 0x%02X\n", 
+                        address);
+                return;
+            }
+            this->_retained.pcsm[address] = data;
+            if (address == PCSM_INTTIMER0_REG) {
+                this->_set_inttimer(data);
+            }
+        }
+
+        void _set_inttimer(uint32_t value) {
+            // counts N+1 RTC periods, 0 disables
+            this->_inttimer_period = value ? (uint64_t)value + 1 : 0;
+            this->_inttimer_next = this->rtc() + this->_inttimer_period;
+        }
+
+        void _update_inttimer() {
+            if (!this->_inttimer_period) {
+                return;
+            }
+            uint64_t now = this->rtc();
+            if (now < this->_inttimer_next) {
+                return;
+            }
+            this->_inttimer_next += this->_inttimer_period;
+            if (this->_inttimer_next <= now) {
+                this->_inttimer_next = now + this->_inttimer_period;
+            }
+            if (this->_spi_control & SPI_R05_ENABLE_AUTO_SAMPLE_BIT_MASK) {
+                this->_spi_sensor_data = kAdcSample;
+                this->_pending |= (1 << Interrupt1_IRQn);
+            } else {
+                this->_pending |= (1 << Interrupt5_IRQn);
+            }
+        }
+
+        // ADP reads one character every kStdoutCharNs
+        bool _stdout_full() {
+            uint64_t now = host_ns();
+            uint64_t drained = (now - this->_stdout_drain_ns) / kStdoutCharNs;
+            if (drained >= this->_stdout_count) {
+                this->_stdout_count = 0;
+                this->_stdout_drain_ns = now;
+            } else if (drained) {
+                this->_stdout_count -= drained;
+                this->_stdout_drain_ns += drained * kStdoutCharNs;
+            }
+            return this->_stdout_count >= kStdoutFifoDepth;
+        }
+
+        // the (level) interrupt is asserted while enabled and not full
+        void _update_stdout() {
+            if ((this->_stdout_int_ctrl & 
+                    STDOUT_R03_INTERRUPT_ENABLE_BIT_MASK) && 
+                    !this->_stdout_full()) {
+                this->_pending |= (1 << M0N0_STDOUT_IRQ_NUM);
+            }
+        }
+
+        void _update_systick() {
+            uint32_t ctrl = SysTick->CTRL;
+            if (!(ctrl & SysTick_CTRL_ENABLE_Msk)) {
+                this->_systick_ctrl = ctrl;
+                return;
+            }
+            uint64_t now = host_ns();
+            if (!(this->_systick_ctrl & SysTick_CTRL_ENABLE_Msk) || 
+                    (SysTick->LOAD != this->_systick_load)) {
+                // (re)started
+                this->_systick_start_ns = now;
+                this->_systick_periods = 0;
+                this->_systick_load = SysTick->LOAD;
+            }
+            this->_systick_ctrl = ctrl;
+            uint64_t period = (uint64_t)this->_systick_load + 1;
+            uint64_t cycles = ((now - this->_systick_start_ns) 
+                    * SystemCoreClock) / 1000000000ULL;
+            uint64_t periods = cycles / period;
+            SysTick->VAL = (uint32_t)(this->_systick_load - (cycles % period));
+            if (periods != this->_systick_periods) {
+                this->_systick_periods = periods;
+                SysTick->CTRL |= SysTick_CTRL_COUNTFLAG_Msk;
+                this->_systick_ctrl = SysTick->CTRL;
+                if (ctrl & SysTick_CTRL_TICKINT_Msk) {
+                    this->_pending |= kSysTickPending;
+                }
+            }
+        }
+};
+
+M0N0Sim& sim() {
+    static M0N0Sim instance;
+    return instance;
+}
+
+uint32_t sim_read(uint32_t address) {
+    return sim().read(address);
+}
+
+void sim_write(uint32_t address, uint32_t data) {
+    sim().write(address, data);
+}
+
+// register the drivers before any static constructors/main
+__attribute__((constructor(101))) void sim_register(void) {
+    setvbuf(stdout, NULL, _IOLBF, 0); // as the STDOUT peripheral, per line
+    sim();
+    M0N0_set_host_drivers(&sim_read, &sim_write);
+}
+
+void sim_exit(void) {
+    M0N0_flush_stdout(); // (the queue, with M0N0_STDOUT_BUFFERED)
+    fflush(stdout);
+}
+
+__attribute__((constructor(102))) void sim_register_exit(void) {
+    atexit(&sim_exit);
+}
+
+} // namespace
+
+// ---------- Simulator API ---------- //
+extern "C" {
+
+uint64_t m0n0_sim_get_rtc(void) {
+    return sim().rtc();
+}
+
+uint32_t m0n0_sim_poll(void) {
+    return sim().poll();
+}
+
+uint64_t m0n0_sim_get_access_count(void) {
+    return sim().access_count();
+}
+
+// ---------- CMSIS functions ---------- //
+
+void SystemInit(void) {
+}
+
+void SystemCoreClockUpdate(void) {
+}
+
+uint32_t m0n0_host_cyccnt_read(void) {
+    return sim().cyccnt();
+}
+
+void m0n0_host_cyccnt_write(uint32_t value) {
+    sim().set_cyccnt(value);
+}
+
+void __NVIC_EnableIRQ(IRQn_Type IRQn) {
+    sim().nvic_enable(IRQn, true);
+}
+
+void __NVIC_DisableIRQ(IRQn_Type IRQn) {
+    sim().nvic_enable(IRQn, false);
+}
+
+uint32_t __NVIC_GetEnableIRQ(IRQn_Type IRQn) {
+    return sim().nvic_is_enabled(IRQn);
+}
+
+void __NVIC_SetPendingIRQ(IRQn_Type IRQn) {
+    sim().set_pending(IRQn, true);
+    sim().poll();
+}
+
+void __NVIC_ClearPendingIRQ(IRQn_Type IRQn) {
+    sim().set_pending(IRQn, false);
+}
+
+uint32_t __NVIC_GetPendingIRQ(IRQn_Type IRQn) {
+    return sim().is_pending(IRQn);
+}
+
+void __NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) {
+    (void)IRQn;
+    (void)priority; // all interrupts have the same priority (no nesting)
+}
+
+void __WFI(void) {
+    sim().wfi();
+}
+
+void __disable_irq(void) {
+    sim().set_primask(1);
+}
+
+void __enable_irq(void) {
+    sim().set_primask(0);
+}
+
+uint32_t __get_IPSR(void) {
+    return sim().ipsr();
+}
+
+uint32_t __get_PRIMASK(void) {
+    return sim().primask();
+}
+
+void __set_PRIMASK(uint32_t primask) {
+    sim().set_primask(primask);
+}
+
+} // extern "C"
@@ -36,9 +36,29 @@
  * The formats specifiers supported by this implementation are:
  * 'd' 'u' 'x' 'X' 'c' 's'.
  *
+ * 'd' 'u' 'x' 'X' support the 'l' and 'll' (64-bit) length modifiers, e.g.
+ * "%llx" for the 64-bit RTC value. Hex output does not use division. 
+ *
+ * Signed 32-bit fixed-point values are printed as decimals with 'q' followed 
+ * by the number of fractional bits, e.g. "%q15" (Q15), "%q31" (Q31) or 
+ * "%q16" (Q16.16). The precision sets the number of (rounded) digits after 
+ * the decimal point (default 4, max 9), e.g. "%.2q16". 
+ *
  * Zero padding and field width are also supported, as well as pad right and
  * variable pad width.
  *
+ * The output goes to a sink (m0n0_sink_t), which receives the characters in
+ * batches (SINK_BATCH_LEN) from a buffer on the stack, rather than one at a
+ * time. The following sinks are provided:
+ *  - m0n0_stdout_sink: STDOUT (used by m0n0_printf)
+ *  - m0n0_null_sink: discards the output (e.g. to measure its length)
+ *  - m0n0_buf_sink_t: a bounded RAM buffer, which can be flushed to another 
+ *    sink in one burst (m0n0_buf_sink_flush)
+ *  - m0n0_shram_ring_t: a ring buffer in SHRAM, which is retained during a
+ *    shutdown (e.g. a log that is read after wake-up)
+ * m0n0_snprintf and m0n0_vsnprintf format into a buffer of a given size, 
+ * the output is truncated (and always terminated).
+ *
  * To use printf() your program should provide an implementation of putchar()
  * to output a character, for example:
  *
@@ -61,9 +81,65 @@
 // extern int putchar(int c);
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdarg.h>
+
+/* Characters passed to a sink per call */
+#ifndef SINK_BATCH_LEN
+#define SINK_BATCH_LEN 32
+#endif
+
+/* Output sink: write is called with each batch of formatted characters */
+typedef struct m0n0_sink {
+	void (*write)(struct m0n0_sink *sink, const char *data, size_t len);
+} m0n0_sink_t;
+
+/* Bounded RAM buffer sink (initialise with m0n0_buf_sink_init). Characters
+ * that do not fit are dropped, the contents are always terminated */
+typedef struct {
+	m0n0_sink_t sink;
+	char *buf;
+	size_t size;
+	size_t len;
+} m0n0_buf_sink_t;
+
+/* SHRAM ring buffer sink (initialise with m0n0_shram_ring_init). The first
+ * word of the region holds the total number of characters written, the 
+ * rest holds the most recent characters. Not re-entrant */
+typedef struct {
+	m0n0_sink_t sink;
+	uint32_t base;
+	uint32_t size;
+} m0n0_shram_ring_t;
+
+extern m0n0_sink_t m0n0_stdout_sink;
+extern m0n0_sink_t m0n0_null_sink;
+
+void m0n0_buf_sink_init(m0n0_buf_sink_t *bs, char *buf, size_t size);
+/* Writes the contents of the buffer to another sink and empties it */
+void m0n0_buf_sink_flush(m0n0_buf_sink_t *bs, m0n0_sink_t *to);
+/* base is the (SHRAM relative) address of the region, base and size must
+ * be multiples of 4. reset clears the ring, otherwise the retained contents
+ * are appended to */
+void m0n0_shram_ring_init(m0n0_shram_ring_t *ring, uint32_t base, uint32_t size, int reset);
+/* Copies the most recent (up to size-1) characters from the ring into buf
+ * and terminates it. Returns the number of characters copied */
+size_t m0n0_shram_ring_read(m0n0_shram_ring_t *ring, char *buf, size_t size);
+
 int m0n0_printf(const char *fmt, ...);
-int m0n0_simple_sprintf(char *buf, char *fmt, ...);
+int m0n0_vprintf(const char *fmt, va_list ap);
+int m0n0_sink_printf(m0n0_sink_t *sink, const char *fmt, ...);
+int m0n0_sink_vprintf(m0n0_sink_t *sink, const char *fmt, va_list ap);
+/* Return the length of the complete output (which is truncated to size-1 
+ * characters), as snprintf */
+int m0n0_snprintf(char *buf, size_t size, const char *fmt, ...);
+int m0n0_vsnprintf(char *buf, size_t size, const char *fmt, va_list ap);
+/* Unbounded: prefer m0n0_snprintf */
+int m0n0_simple_sprintf(char *buf, const char *fmt, ...);
+/* out is NULL (STDOUT) or an unbounded buffer (advanced past the output).
+ * Prefer m0n0_vprintf/m0n0_vsnprintf */
 int simple_vsprintf(char **out, const char *format, va_list ap);
+/* Prints a string without formatting (and without a trailing newline) */
+int m0n0_print_string(const char *string);
 
 #endif /* __m0n0_printf__ */
@@ -35,14 +35,25 @@
 #include "m0n0_printf.h"
 #include "m0n0_defs.h"
 
-static void simple_outputchar(char **str, char c)
+/* Formatter output: characters are collected in buf, which is either the
+ * destination (bounded buffer, sink is NULL) or a batch that is passed to
+ * the sink when full */
+typedef struct {
+	char *buf;
+	size_t size;
+	size_t len;
+	m0n0_sink_t *sink;
+} printf_out_t;
+
+static void simple_outputchar(printf_out_t *out, char c)
 {
-	if (str) {
-		**str = c;
-		++(*str);
-	} else {
-		M0N0_write_stdout(c);
+	if (out->len >= out->size) {
+		if (!out->sink)
+			return; /* truncated */
+		out->sink->write(out->sink, out->buf, out->len);
+		out->len = 0;
 	}
+	out->buf[out->len++] = c;
 }
 
 enum flags {
@@ -50,7 +61,7 @@ enum flags {
 	PAD_RIGHT	= 2,
 };
 
-static int prints(char **out, const char *string, int width, int flags)
+static int prints(printf_out_t *out, const char *string, int width, int flags)
 {
 	int pc = 0, padchar = ' ';
 
@@ -83,35 +94,143 @@ static int prints(char **out, const char *string, int width, int flags)
 
 #define PRINT_BUF_LEN 64
 
-static int simple_outputi(char **out, int i, int base, int sign, int width, int flags, int letbase)
+static int simple_outputu(printf_out_t *out, unsigned long long u, int neg, int base, int width, int flags, int letbase)
 {
 	char print_buf[PRINT_BUF_LEN];
 	char *s;
-	int t, neg = 0, pc = 0;
-	unsigned int u = i;
+	int t, pc = 0;
+	unsigned int u32;
 
-	if (i == 0) {
+	if (u == 0) {
 		print_buf[0] = '0';
 		print_buf[1] = '\0';
 		return prints(out, print_buf, width, flags);
 	}
 
+	s = print_buf + PRINT_BUF_LEN-1;
+	*s = '\0';
+
+	if (base == 16) {
+		/* divide-free */
+		while (u) {
+			t = u & 0xF;
+			if( t >= 10 )
+				t += letbase - '0' - 10;
+			*--s = t + '0';
+			u >>= 4;
+		}
+	}
+	else {
+		/* 64-bit values are split into 9 digit chunks (at most 2 64-bit
+		 * divisions), the digits are generated with 32-bit divisions */
+		while (u >> 32) {
+			u32 = (unsigned int)(u % 1000000000U);
+			u /= 1000000000U;
+			for (t = 0; t < 9; ++t) {
+				*--s = (u32 % 10) + '0';
+				u32 /= 10;
+			}
+		}
+		u32 = (unsigned int)u;
+		while (u32) {
+			*--s = (u32 % 10) + '0';
+			u32 /= 10;
+		}
+	}
+
+	if (neg) {
+		if( width && (flags & PAD_ZERO) ) {
+			simple_outputchar (out, '-');
+			++pc;
+			--width;
+		}
+		else {
+			*--s = '-';
+		}
+	}
+
+	return pc + prints (out, s, width, flags);
+}
+
+static int simple_outputi(printf_out_t *out, int i, int base, int sign, int width, int flags, int letbase)
+{
+	unsigned int u = i;
+	int neg = 0;
+
 	if (sign && base == 10 && i < 0) {
 		neg = 1;
-		u = -i;
+		u = 0U - u;
 	}
+	return simple_outputu(out, u, neg, base, width, flags, letbase);
+}
 
-	s = print_buf + PRINT_BUF_LEN-1;
-	*s = '\0';
+static int simple_outputll(printf_out_t *out, long long i, int base, int sign, int width, int flags, int letbase)
+{
+	unsigned long long u = i;
+	int neg = 0;
+
+	if (sign && base == 10 && i < 0) {
+		neg = 1;
+		u = 0U - u;
+	}
+	return simple_outputu(out, u, neg, base, width, flags, letbase);
+}
+
+#define Q_DEFAULT_DIGITS 4
+#define Q_MAX_DIGITS 9
+
+/* Prints a signed 32-bit fixed-point value with frac_bits fractional bits
+ * (e.g. 15 for Q15, 16 for Q16.16) as a decimal with (rounded) digits
+ * after the decimal point. The fraction uses multiplications only. */
+static int simple_outputq(printf_out_t *out, int i, int frac_bits, int digits, int width, int flags)
+{
+	char print_buf[PRINT_BUF_LEN];
+	char *s, *d;
+	unsigned int u = i, ipart;
+	unsigned long long frac;
+	unsigned long long one;
+	int neg = 0, n, pc = 0;
 
-	while (u) {
-		t = u % base;
-		if( t >= 10 )
-			t += letbase - '0' - 10;
-		*--s = t + '0';
-		u /= base;
+	if (frac_bits > 31)
+		frac_bits = 31;
+	if (digits > Q_MAX_DIGITS)
+		digits = Q_MAX_DIGITS;
+	if (i < 0) {
+		neg = 1;
+		u = 0U - u;
 	}
+	one = 1ULL << frac_bits;
+	ipart = u >> frac_bits;
+	frac = u & (unsigned int)(one - 1);
 
+	/* fraction digits, then round half up */
+	d = print_buf + PRINT_BUF_LEN - Q_MAX_DIGITS - 1;
+	for (n = 0; n < digits; ++n) {
+		frac *= 10;
+		d[n] = (char)(frac >> frac_bits) + '0';
+		frac &= one - 1;
+	}
+	d[digits] = '\0';
+	if ((frac << 1) >= one) {
+		for (n = digits - 1; n >= 0; --n) {
+			if (d[n] != '9') {
+				d[n]++;
+				break;
+			}
+			d[n] = '0';
+		}
+		if (n < 0)
+			ipart++;
+	}
+
+	/* integer part (backwards from the decimal point) */
+	s = d;
+	if (digits)
+		*--s = '.';
+	do {
+		*--s = (ipart % 10) + '0';
+		ipart /= 10;
+	} while (ipart);
 	if (neg) {
 		if( width && (flags & PAD_ZERO) ) {
 			simple_outputchar (out, '-');
@@ -127,9 +246,9 @@ static int simple_outputi(char **out, int i, int base, int sign, int width, int
 }
 
 
-int simple_vsprintf(char **out, const char *format, va_list ap)
+static int out_vprintf(printf_out_t *out, const char *format, va_list ap)
 {
-	int width, flags;
+	int width, flags, precision, length;
 	int pc = 0;
 	char scr[2];
 	union {
@@ -137,13 +256,15 @@ int simple_vsprintf(char **out, const char *format, va_list ap)
 		char *s;
 		int i;
 		unsigned int u;
+		long long ll;
 		void *p;
 	} u;
 
 	for (; *format != 0; ++format) {
 		if (*format == '%') {
 			++format;
-			width = flags = 0;
+			width = flags = length = 0;
+			precision = -1;
 			if (*format == '\0')
 				break;
 			if (*format == '%')
@@ -165,25 +286,60 @@ int simple_vsprintf(char **out, const char *format, va_list ap)
 					width += *format - '0';
 				}
 			}
+			if (*format == '.') {
+				++format;
+				for (precision = 0; *format >= '0' && *format <= '9'; ++format) {
+					precision *= 10;
+					precision += *format - '0';
+				}
+			}
+			/* "l" is the size of long, "ll" is 64-bit */
+			while (*format == 'l') {
+				++format;
+				++length;
+			}
+			if (length == 1 && sizeof(long) == sizeof(long long))
+				length = 2;
 			switch (*format) {
 				case('d'):
-					u.i = va_arg(ap, int);
+					if (length == 2) {
+						u.ll = va_arg(ap, long long);
+						pc += simple_outputll(out, u.ll, 10, 1, width, flags, 'a');
+						break;
+					}
+					u.i = (length == 1) ? (int)va_arg(ap, long) : va_arg(ap, int);
 					pc += simple_outputi(out, u.i, 10, 1, width, flags, 'a');
 					break;
 
 				case('u'):
-					u.u = va_arg(ap, unsigned int);
+					if (length == 2) {
+						u.ll = va_arg(ap, long long);
+						pc += simple_outputll(out, u.ll, 10, 0, width, flags, 'a');
+						break;
+					}
+					u.u = (length == 1) ? (unsigned int)va_arg(ap, unsigned long) : va_arg(ap, unsigned int);
 					pc += simple_outputi(out, u.u, 10, 0, width, flags, 'a');
 					break;
 
 				case('x'):
-					u.u = va_arg(ap, unsigned int);
-					pc += simple_outputi(out, u.u, 16, 0, width, flags, 'a');
+				case('X'):
+					if (length == 2) {
+						u.ll = va_arg(ap, long long);
+						pc += simple_outputll(out, u.ll, 16, 0, width, flags, (*format == 'x') ? 'a' : 'A');
+						break;
+					}
+					u.u = (length == 1) ? (unsigned int)va_arg(ap, unsigned long) : va_arg(ap, unsigned int);
+					pc += simple_outputi(out, u.u, 16, 0, width, flags, (*format == 'x') ? 'a' : 'A');
 					break;
 
-				case('X'):
-					u.u = va_arg(ap, unsigned int);
-					pc += simple_outputi(out, u.u, 16, 0, width, flags, 'A');
+				case('q'):
+					/* %q<bits>: fixed-point with <bits> fractional bits */
+					u.i = va_arg(ap, int);
+					for (length = 0; format[1] >= '0' && format[1] <= '9'; ++format) {
+						length *= 10;
+						length += format[1] - '0';
+					}
+					pc += simple_outputq(out, u.i, length, (precision < 0) ? Q_DEFAULT_DIGITS : precision, width, flags);
 					break;
 
 				case('c'):
@@ -206,10 +362,155 @@ int simple_vsprintf(char **out, const char *format, va_list ap)
 			++pc;
 		}
 	}
-	if (out) **out = '\0';
 	return pc;
 }
 
+static int sink_vprintf(m0n0_sink_t *sink, const char *format, va_list ap)
+{
+	char batch[SINK_BATCH_LEN];
+	printf_out_t out = { batch, SINK_BATCH_LEN, 0, sink };
+	int r = out_vprintf(&out, format, ap);
+	if (out.len)
+		sink->write(sink, batch, out.len);
+	return r;
+}
+
+/* size includes the terminator (nothing is written if size is 0) */
+static int buf_vprintf(char *buf, size_t size, const char *format, va_list ap)
+{
+	printf_out_t out = { buf, size ? size - 1 : 0, 0, NULL };
+	int r = out_vprintf(&out, format, ap);
+	if (size)
+		buf[out.len] = '\0';
+	return r;
+}
+
+int simple_vsprintf(char **out, const char *format, va_list ap)
+{
+	int r;
+	if (!out)
+		return sink_vprintf(&m0n0_stdout_sink, format, ap);
+	r = buf_vprintf(*out, (size_t)-1, format, ap);
+	*out += r;
+	return r;
+}
+
+/* Sinks */
+
+static void stdout_write(m0n0_sink_t *sink, const char *data, size_t len)
+{
+	(void)sink;
+#ifndef SUPPRESS_STDOUT
+	M0N0_write_stdout_buf(data, len);
+#else
+	(void)data;
+	(void)len;
+#endif
+}
+
+static void null_write(m0n0_sink_t *sink, const char *data, size_t len)
+{
+	(void)sink;
+	(void)data;
+	(void)len;
+}
+
+m0n0_sink_t m0n0_stdout_sink = { stdout_write };
+m0n0_sink_t m0n0_null_sink = { null_write };
+
+static void buf_sink_write(m0n0_sink_t *sink, const char *data, size_t len)
+{
+	/* the sink is the first member */
+	m0n0_buf_sink_t *bs = (m0n0_buf_sink_t *)sink;
+	if (!bs->size)
+		return;
+	for ( ; len && bs->len < bs->size - 1; --len)
+		bs->buf[bs->len++] = *data++;
+	bs->buf[bs->len] = '\0';
+}
+
+void m0n0_buf_sink_init(m0n0_buf_sink_t *bs, char *buf, size_t size)
+{
+	bs->sink.write = buf_sink_write;
+	bs->buf = buf;
+	bs->size = size;
+	bs->len = 0;
+	if (size)
+		buf[0] = '\0';
+}
+
+void m0n0_buf_sink_flush(m0n0_buf_sink_t *bs, m0n0_sink_t *to)
+{
+	if (bs->len)
+		to->write(to, bs->buf, bs->len);
+	bs->len = 0;
+	if (bs->size)
+		bs->buf[0] = '\0';
+}
+
+/* SHRAM is accessed in words: characters are packed little-endian and each
+ * word is written once per batch (words that are only partly overwritten 
+ * are read back first) */
+static void shram_ring_write(m0n0_sink_t *sink, const char *data, size_t len)
+{
+	m0n0_shram_ring_t *ring = (m0n0_shram_ring_t *)sink;
+	uint32_t cap = ring->size - 4;
+	uint32_t total, offset, addr, word = 0, shift;
+
+	if (!len)
+		return;
+	total = M0N0_read(ring->base);
+	M0N0_write(ring->base, total + len);
+	offset = total % cap;
+	addr = ring->base + 4 + (offset & ~3U);
+	if ((offset & 3) || len < 4)
+		word = M0N0_read(addr);
+	for ( ; len; --len) {
+		shift = (offset & 3) * 8;
+		word &= ~(0xFFU << shift);
+		word |= (uint32_t)(uint8_t)*data++ << shift;
+		if (shift == 24 || len == 1)
+			M0N0_write(addr, word);
+		if (++offset == cap)
+			offset = 0;
+		if (!(offset & 3) && len > 1) {
+			addr = ring->base + 4 + offset;
+			word = (len - 1 < 4) ? M0N0_read(addr) : 0;
+		}
+	}
+}
+
+void m0n0_shram_ring_init(m0n0_shram_ring_t *ring, uint32_t base, uint32_t size, int reset)
+{
+	ring->sink.write = shram_ring_write;
+	ring->base = MEM_MAP_SHRAM_BASE + base;
+	ring->size = size;
+	if (reset)
+		M0N0_write(ring->base, 0);
+}
+
+size_t m0n0_shram_ring_read(m0n0_shram_ring_t *ring, char *buf, size_t size)
+{
+	uint32_t cap = ring->size - 4;
+	uint32_t total = M0N0_read(ring->base);
+	uint32_t n = (total < cap) ? total : cap;
+	uint32_t offset;
+	size_t i;
+
+	if (!size)
+		return 0;
+	if (n > size - 1)
+		n = size - 1;
+	offset = (total - n) % cap;
+	for (i = 0; i < n; ++i) {
+		buf[i] = (char)(M0N0_read(ring->base + 4 + (offset & ~3U)) >> ((offset & 3) * 8));
+		if (++offset == cap)
+			offset = 0;
+	}
+	buf[n] = '\0';
+	return n;
+}
+
 #ifdef M0N0_PRINT
 int m0n0_printf(const char *fmt, ...)
 {
@@ -219,10 +520,18 @@ int m0n0_printf(const char *fmt, ...)
 	va_list ap;
 	int r;
 	va_start(ap, fmt);
-	r = simple_vsprintf(NULL, fmt, ap);
+	r = sink_vprintf(&m0n0_stdout_sink, fmt, ap);
 	va_end(ap);
 	return r;
 }
+
+int m0n0_vprintf(const char *fmt, va_list ap)
+{
+#ifdef SUPPRESS_STDOUT
+    return -1;
+#endif
+	return sink_vprintf(&m0n0_stdout_sink, fmt, ap);
+}
 #else
 int m0n0_printf(const char *fmt, ...){
 #ifdef SUPPRESS_STDOUT
@@ -231,9 +540,61 @@ int m0n0_printf(const char *fmt, ...){
 	int aux = (int) fmt;
 	return aux;
 }
+
+int m0n0_vprintf(const char *fmt, va_list ap){
+#ifdef SUPPRESS_STDOUT
+    return -1;
+#endif
+	(void)ap;
+	int aux = (int) fmt;
+	return aux;
+}
+#endif
+
+int m0n0_sink_printf(m0n0_sink_t *sink, const char *fmt, ...)
+{
+	va_list ap;
+	int r;
+	va_start(ap, fmt);
+	r = sink_vprintf(sink, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int m0n0_sink_vprintf(m0n0_sink_t *sink, const char *fmt, va_list ap)
+{
+	return sink_vprintf(sink, fmt, ap);
+}
+
+int m0n0_snprintf(char *buf, size_t size, const char *fmt, ...)
+{
+	va_list ap;
+	int r;
+	va_start(ap, fmt);
+	r = buf_vprintf(buf, size, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int m0n0_vsnprintf(char *buf, size_t size, const char *fmt, va_list ap)
+{
+	return buf_vprintf(buf, size, fmt, ap);
+}
+
+int m0n0_print_string(const char *string)
+{
+#ifdef SUPPRESS_STDOUT
+    return -1;
 #endif
+	/* a single write (no copy into a batch) */
+	size_t len = 0;
+	while (string[len])
+		++len;
+	m0n0_stdout_sink.write(&m0n0_stdout_sink, string, len);
+	return (int)len;
+}
 
-int m0n0_simple_sprintf(char *buf, char *fmt, ...)
+int m0n0_simple_sprintf(char *buf, const char *fmt, ...)
 {
 #ifdef SUPPRESS_STDOUT
     return -1;
@@ -242,7 +603,7 @@ int m0n0_simple_sprintf(char *buf, char *fmt, ...)
 	int r;
 
 	va_start(ap, fmt);
-	r = simple_vsprintf(&buf, fmt, ap);
+	r = buf_vprintf(buf, (size_t)-1, fmt, ap);
 	va_end(ap);
 
 	return r;
@@ -48,6 +48,32 @@ volatile unsigned int interrupt5_flag;
 /** Counter that is incremented inside the Interrupt6_Handler (EXTWAKE)
  */
 volatile unsigned int interrupt6_flag;
+/** Counter that is incremented when an interrupt has no callback
+ */
+volatile unsigned int m0n0_irq_unhandled;
+
+/** The callbacks called by the interrupt handlers
+ */
+typedef enum {
+    M0N0_IRQ_SYSTICK = 0,
+    M0N0_IRQ_AUTOSAMPLE,
+    M0N0_IRQ_PCSM_TIMER,
+    M0N0_IRQ_EXTWAKE,
+    M0N0_IRQ_CALLBACKS
+} M0N0_IRQ_Callback_t;
+
+/** Callback table read by the interrupt handlers (never NULL: 
+ *  m0n0_irq_unhandled_callback if there is no callback)
+ *
+ * Set when the callbacks are registered (M0N0_System::enable_systick etc.),
+ * so that the handlers call the callback directly (without the 
+ * M0N0_System::get_sys lookup or a NULL check)
+ */
+extern void (*m0n0_irq_callbacks[M0N0_IRQ_CALLBACKS])(void);
+/** Callback in m0n0_irq_callbacks when none is registered (increments 
+ *  m0n0_irq_unhandled)
+ */
+void m0n0_irq_unhandled_callback(void);
 
 /** Default Handler
  */
@@ -67,6 +93,13 @@ void UsageFault_Handler(void);
 /** SysTick Handler
  */
 void SysTick_Handler(void);
+#ifdef M0N0_PC_SAMPLE
+/** SysTick Handler body with M0N0_PC_SAMPLE (counts the stacked PC)
+ *
+ * @param frame The exception frame (NULL in the host build)
+ */
+void SysTick_Handler_Sampled(const unsigned int* frame);
+#endif
 /** Interrupt0 (GPIO) Handler
  */
 void Interrupt0_Handler(void);
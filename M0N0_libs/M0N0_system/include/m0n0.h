@@ -28,10 +28,11 @@
 #ifndef M0N0_H
 #define M0N0_H
 #include <cstdint>
-#include <string>
 #include <cstdarg>
+#include <type_traits>
 #include "sysutil.h"
 #include "tc_functions.h" // for TC command via ADP
+#include "m0n0_fmt.h"
 
 #include "ARMCM33_DSP_FP.h" // ARM v8 Main Line processor and core peripherals
 #include "system_ARMCM33.h" // exectb_mcu System
@@ -49,6 +50,75 @@ extern "C" {
 // on the heap with the "new" keyword. 
 //#define M0N0_HEAP
 
+#ifdef M0N0_LOG_TOKENIZED
+#ifndef M0N0_LOG_RING_WORDS
+/** The size (in 32-bit words) of the tokenized log ring buffer. Each log 
+ * call uses one word plus one word per argument. 
+ */
+#define M0N0_LOG_RING_WORDS 128
+#endif
+
+/** Start of the section holding the tokenized log format strings (defined
+ * by the linker)
+ */
+extern "C" const char __start_m0n0_fmt[];
+
+/** The number of 32-bit words used to record the tokenized log arguments
+ * (two for 64-bit integers, e.g. %llx, one otherwise)
+ */
+template <typename... Args>
+struct M0N0_Log_Words {
+    static const uint32_t value = 0;
+};
+
+template <typename T, typename... Rest>
+struct M0N0_Log_Words<T, Rest...> {
+    static const uint32_t value = 
+            ((std::is_integral<T>::value && (sizeof(T) > 4)) ? 2 : 1) + 
+            M0N0_Log_Words<Rest...>::value;
+};
+
+/** Records a tokenized log argument as raw 32-bit word(s)
+ *
+ * @param words Where to write the word(s)
+ * @param value The argument (integer, character or enum)
+ * @return The position after the written word(s)
+ */
+template <typename T>
+inline uint32_t* m0n0_log_arg(uint32_t* words, T value) {
+    static_assert(!std::is_floating_point<T>::value,
+            "Tokenized log arguments cannot be floating point");
+    *words++ = (uint32_t)value;
+    if (std::is_integral<T>::value && (sizeof(T) > 4)) {
+        // 64-bit: low word first
+        *words++ = (uint32_t)((uint64_t)value >> 32);
+    }
+    return words;
+}
+
+/** Records a tokenized log pointer argument (e.g. %s) as a raw 32-bit word
+ *
+ * @param words Where to write the word
+ * @param value The pointer
+ * @return The position after the written word
+ */
+template <typename T>
+inline uint32_t* m0n0_log_arg(uint32_t* words, T* value) {
+    *words++ = (uint32_t)(uintptr_t)value;
+    return words;
+}
+
+/** Records the tokenized log arguments (see m0n0_log_arg) */
+inline uint32_t* m0n0_log_args(uint32_t* words) {
+    return words;
+}
+
+template <typename T, typename... Rest>
+inline uint32_t* m0n0_log_args(uint32_t* words, T value, Rest... rest) {
+    return m0n0_log_args(m0n0_log_arg(words, value), rest...);
+}
+#endif
+
 /**
  * A class for supporting the M0N0 System features
  *
@@ -91,18 +161,6 @@ class M0N0_System {
             30, 25, 31, 16,
             26, 21, 27, 22,
             17, 23, 18, 19};
-        /**
-         * A lookup table for converting raw HW ID to DVFS level (0-15)
-         */
-        uint8_t _inv_perf_lookup[32] = {
-            128, 128, 128, 128, // 0-3
-            128, 128, 128, 128, // 4-7
-            128, 128, 128, 128, // 8-11
-            128, 128, 128, 128, // 12-15
-            7  , 12 , 14 , 15 , // 16-19
-            3  , 9  , 11 , 13 , // 20-23
-            1  , 5  , 8  , 10 , // 24-27
-            0  , 2  , 4  , 6  };// 28-31
         /**
          * VBAT Power-on Reset (PoR) flag
          * 
@@ -110,6 +168,78 @@ class M0N0_System {
          * Power-on Reset (PoR) since the last shutdown. 
          */
         bool _vbat_por;
+        /** The RTC frequency (mHz) used by the time conversions
+         */
+        static uint32_t _rtc_freq_millihz;
+        /** RTC time conversion factors (set by _set_rtc_factors)
+         */
+        static uint32_t _rtc_us_per_tick_q24;
+        static uint32_t _rtc_ms_per_tick_q32;
+        static uint32_t _rtc_ticks_per_ms_q24;
+        static uint32_t _rtc_ticks_per_us_q32;
+        /** Derives the time conversion factors from the RTC frequency
+         *
+         * @param rtc_freq_millihz The RTC frequency in mHz
+         */
+        static void _set_rtc_factors(uint32_t rtc_freq_millihz);
+        /** The entry + exit cost (RTC ticks) of each sleep mechanism
+         */
+        uint32_t _sleep_costs[SLEEP_NUM_MECHANISMS];
+        /** Loads the sleep costs from SHRAM (or the defaults)
+         *
+         * If a timed shutdown was started by sleep_for, its cost is 
+         * measured (the time from the expected wake up to now) and stored.
+         */
+        void _load_sleep_costs(void);
+        /** Stores the sleep costs to SHRAM
+         */
+        void _store_sleep_costs(void);
+        /** Whether the PCSM interrupt timer (INTTIMER0) is in use by 
+         * autosampling, the SoftTimers or a registered callback (and so 
+         * cannot be borrowed for a WFI sleep)
+         */
+        bool _inttimer_in_use(void);
+        /** Errors if INTTIMER0 is owned by the SoftTimers and the caller 
+         * is not them (f is the callback being set, NULL to disable)
+         */
+        void _check_inttimer_owner(Handler_Func f);
+        /** The core frequency (kHz) at each perf level (0 if not 
+         * characterised)
+         */
+        uint32_t _perf_freq_khz[16];
+        /** Loads the perf frequency table from SHRAM (if its tag is valid)
+         */
+        void _load_perf_freqs(void);
+        /** Sets SystemCoreClock to the frequency of a perf level (if the 
+         * table has been characterised)
+         */
+        void _update_core_clock(uint8_t perf);
+        /** Core frequency tracking state (see enable_tcro_tracking)
+         */
+        volatile bool _tcro_tracking;
+        volatile bool _tcro_anchored; // the window start has been set
+        bool _tcro_chained; // the window follows on from the last one
+        uint32_t _tcro_anchor_cycles; // DWT CYCCNT at the window start
+        uint32_t _tcro_anchor_rtc; // RTC LSBs at the window start
+        uint32_t _tcro_segments; // unbroken runs of windows in the totals
+        uint32_t _tcro_total_rtc; // RTC ticks of the windows (decaying)
+        uint64_t _tcro_total_cycles; // cycles of the windows (decaying)
+        /** DVFS governor state (see enable_dvfs_governor)
+         */
+        bool _dvfs_governed;
+        bool _dvfs_in_job;
+        uint8_t _dvfs_level; // the perf level for the next job
+        uint8_t _dvfs_floor; // the lowest level allowed (raised by a miss)
+        uint32_t _dvfs_floor_jobs; // jobs until the floor is cleared
+        uint32_t _dvfs_slack_jobs; // consecutive jobs with enough slack
+        uint32_t _dvfs_deadline; // RTC ticks
+        uint32_t _dvfs_budget; // RTC ticks
+        uint32_t _dvfs_job_start; // RTC LSBs
+        /** DVFS governor statistics for each perf level
+         */
+        uint32_t _dvfs_jobs[16];
+        uint32_t _dvfs_overruns[16]; // over budget (but met the deadline)
+        uint32_t _dvfs_misses[16]; // missed the deadline
         /** A flag to signal whether SPI auto-sampling has been enabled
          *
          * This needs to be know because using the SPI for other purposes
@@ -144,6 +274,58 @@ class M0N0_System {
          * off will result in a lock-up). 
          */
         static bool _is_deve(void);
+        /**
+         * Shared implementation of the log_* functions
+         *
+         * Sends the level prefix, the formatted message and a newline 
+         * directly to STDOUT (no intermediate string or heap use), if the 
+         * level is enabled and DEVE mode is on. 
+         *
+         * @param level The level of the message
+         * @param fmt The printf format string
+         * @param ap The format arguments
+         * @return The number of characters printed, or -1 if not printed
+         */
+        int _vlog(LOG_LEVEL_t level, const char *fmt, va_list ap);
+        /**
+         * Prints a log message with the run-time formatter (used by 
+         * _log_fmt for the formats that are not parsed at compile time)
+         */
+        int _log(LOG_LEVEL_t level, const char *fmt, ...);
+        /**
+         * The prefix of the messages of a log level (e.g. "INFO:  ")
+         */
+        static const char* _log_prefix(LOG_LEVEL_t level);
+#ifdef M0N0_LOG_TOKENIZED
+        /**
+         * Writes a tokenized log message to the log ring buffer
+         *
+         * Frame format: a header word (format string ID in bits 19:0, 
+         * the number of argument words in bits 23:20, the level in bits 25:24), 
+         * followed by the raw arguments. Flushes the ring if there is not 
+         * enough space. 
+         *
+         * @param level The level of the message
+         * @param id The format string ID (offset in the m0n0_fmt section)
+         * @param args The arguments (as 32-bit words)
+         * @param nargs The number of argument words
+         * @return 0, or -1 if not recorded
+         */
+        static int _log_token_write(
+                LOG_LEVEL_t level,
+                uint32_t id,
+                const uint32_t* args,
+                uint32_t nargs);
+        /** The tokenized log ring buffer
+         */
+        static uint32_t _log_ring[M0N0_LOG_RING_WORDS];
+        /** The total number of words written to the log ring buffer
+         */
+        static volatile uint32_t _log_ring_head;
+        /** The total number of words read from the log ring buffer
+         */
+        static volatile uint32_t _log_ring_tail;
+#endif
         /**
          * The control register RegClass instance
          *
@@ -238,25 +420,143 @@ class M0N0_System {
 #endif
         /** Stores interrupt extwake hander callback function
          */
-        Handler_Func _handler_extwake; // to make static?
+        Handler_Func _handler_extwake;
         /** Stores systick interrupt hander callback function
          */
-        Handler_Func _handler_systick; // to make static?
+        Handler_Func _handler_systick;
         /** Stores pcsm inttimer interrupt hander callback function
          */
-        Handler_Func _handler_pcsm_inttimer; // to make static?
+        Handler_Func _handler_pcsm_inttimer;
         /** Stores autosample interrupt hander callback function
          */
-        Handler_Func _handler_autosample; // to make static?
-        /** Flag for signalling autosampling should be disabled
+        Handler_Func _handler_autosample;
+        /** Flag for signalling autosampling should be disabled (cleared by
+         *  the autosample interrupt)
          */
-        bool autosample_disable_flag;
+        volatile bool autosample_disable_flag;
+        /**
+         * Sets the interrupt callback table (m0n0_irq_callbacks, see 
+         * interrupts.h) from the registered callbacks. Called whenever a 
+         * callback, autosample_disable_flag or the core frequency tracking 
+         * changes, so that the interrupt handlers call the callbacks 
+         * directly
+         */
+        void _bind_irq_callbacks(void);
+        /**
+         * Returns the callback for the table (m0n0_irq_unhandled_callback
+         * if f is NULL)
+         */
+        static Handler_Func _irq_callback(Handler_Func f);
+        /**
+         * Table callbacks used while the core frequency is tracked (they
+         * call sample_tcro before the registered callback)
+         */
+        static void _irq_systick_tracked(void);
+        static void _irq_autosample_tracked(void);
+        static void _irq_pcsm_timer_tracked(void);
+        static void _irq_extwake_tracked(void);
+        /**
+         * Table callback (autosample) used by disable_autosampling_wait
+         */
+        static void _irq_autosample_disable(void);
         /**
          * Number of RTC ticks in one millisecond
          *
          * Used for converting times periods in milliseconds to RTC ticks
          */
         static const uint64_t kRtcOneMsTicks = 33;
+        /**
+         * Nominal RTC frequency in mHz (33 kHz)
+         *
+         * Used by the time conversions until a calibration is set (see 
+         * set_rtc_calibration)
+         */
+        static const uint32_t kRtcFreqMilliHz = M0N0_RTC_FREQ_MILLIHZ;
+        /**
+         * The range of RTC calibrations (in mHz) that are accepted
+         */
+        static const uint32_t kRtcCalMinMilliHz = 4000000;
+        static const uint32_t kRtcCalMaxMilliHz = 250000000;
+        /**
+         * The maximum PCSM inttimer interval (24-bit register)
+         */
+        static const uint32_t kInttimerMaxTicks = 0x00FFFFFF;
+        /**
+         * A sleep mechanism is only used if the interval is at least this 
+         * many times its entry/exit cost (the cost is spent at full power)
+         */
+        static const uint32_t kSleepBreakEvenRatio = 4;
+        /**
+         * Default sleep entry/exit costs (RTC ticks), used until 
+         * characterise_sleep is run
+         */
+        static const uint32_t kSleepCostSpinLp = 3;
+        static const uint32_t kSleepCostWfi = 6;
+        static const uint32_t kSleepCostShutdown = 66;
+        /**
+         * The DVFS governor steps the perf down a level after 
+         * kDvfsStepDownJobs consecutive jobs that finished within 
+         * kDvfsStepDownPct percent of the budget
+         */
+        static const uint32_t kDvfsStepDownPct = 75;
+        static const uint32_t kDvfsStepDownJobs = 4;
+        /**
+         * After a missed deadline, the DVFS governor does not return to 
+         * the level that missed (or below) for this many jobs
+         */
+        static const uint32_t kDvfsHoldJobs = 64;
+        /**
+         * The perf frequency table validity tag ("FREQ"), XORed with the 
+         * sum of the frequencies
+         */
+        static const uint32_t kPerfFreqTag = 0x46524551;
+        /**
+         * The time (ms) characterise_perf_freqs waits after changing the
+         * perf, for the IVR to settle, before measuring the frequency
+         */
+        static const uint32_t kPerfSettleMs = 2;
+        /**
+         * Core frequency tracking windows must be at least this many RTC 
+         * ticks (shorter ones are extended to the next sample) and at most
+         * kTcroMaxWindowTicks (the cycle count could have wrapped)
+         */
+        static const uint32_t kTcroMinWindowTicks = 32;
+        static const uint32_t kTcroMaxWindowTicks = 0x00100000;
+        /**
+         * The tracked totals are halved when they exceed this many RTC 
+         * ticks (i.e. the estimate follows the last ~0.5 s)
+         */
+        static const uint32_t kTcroHistoryTicks = 0x4000;
+        /**
+         * A window is discarded if it measures under this percentage of 
+         * the current estimate (the cycle counter stops while the core 
+         * sleeps in a WFI)
+         */
+        static const uint32_t kTcroRejectPct = 75;
+        /**
+         * A window is also discarded if it measures more core cycles per 
+         * RTC tick than any perf level can run (100 MHz at the nominal 
+         * 33 kHz RTC), e.g. if the cycle counter was written in the window
+         */
+        static const uint32_t kTcroMaxCyclesPerTick = 3030;
+#ifdef M0N0_PC_SAMPLE
+        /**
+         * The shortest SysTick period (core cycles) start_pc_sampling 
+         * sets, bounding the sampling overhead (about 60 cycles per sample
+         * including the exception entry and exit, i.e. ~6%)
+         */
+        static const uint32_t kPcSampleMinCycles = 1000;
+        /**
+         * Whether start_pc_sampling enabled the SysTick (with 
+         * _pc_sample_tick as the callback)
+         */
+        bool _pc_sample_owns_systick = false;
+        /**
+         * SysTick callback used while start_pc_sampling owns the SysTick
+         */
+        static void _pc_sample_tick(void) {
+        }
+#endif
         /**
          * Time period of one RTC tick in microseconds
          *
@@ -265,6 +565,19 @@ class M0N0_System {
          *  
          */
         static constexpr float kRtcPeriodUs = 30.3030303f;
+        /**
+         * Time period of one RTC tick in microseconds (Q16.16)
+         *
+         * Used for converting RTC ticks to microseconds without floating 
+         * point: us = (ticks * kRtcPeriodUsQ16) >> 16
+         */
+        static const uint32_t kRtcPeriodUsQ16 = 1985939;
+        /**
+         * The longest interval (in RTC ticks, ~18 hours) that is timed with
+         * the 32-bit RTC LSBs (see rtc_elapsed). Longer intervals use 
+         * get_rtc. 
+         */
+        static const uint32_t kRtcElapsedMax = 0x7FFFFFFF;
         /**
          * Function that returns M0N0_System singleton instance
          *
@@ -315,6 +628,8 @@ class M0N0_System {
          * Whether the message is sent over STDOUT depends on the set log 
          * level and whether DEVE mode is enabled. The message is prepended 
          * with "DEBUG: " and a carriage return is added automatically. 
+         * The call (including its arguments) is removed at compile time 
+         * if the level is below M0N0_LOG_MIN_LEVEL. 
          *
          * @note Usage example: sys->log_debug("My message, val: %d", val);
          */
@@ -325,6 +640,8 @@ class M0N0_System {
          * Whether the message is sent over STDOUT depends on the set log 
          * level and whether DEVE mode is enabled. The message is prepended 
          * with "INFO: " and a carriage return is added automatically. 
+         * The call (including its arguments) is removed at compile time 
+         * if the level is below M0N0_LOG_MIN_LEVEL. 
          *
          * @note Usage example: sys->log_info("My message, val: %d", val);
          */
@@ -335,6 +652,8 @@ class M0N0_System {
          * Whether the message is sent over STDOUT depends on the set log 
          * level and whether DEVE mode is enabled. The message is prepended 
          * with "WARN: " and a carriage return is added automatically. 
+         * The call (including its arguments) is removed at compile time 
+         * if the level is below M0N0_LOG_MIN_LEVEL. 
          *
          * @note Usage example: sys->log_warn("My message, val: %d", val);
          */
@@ -352,6 +671,92 @@ class M0N0_System {
          * @note Usage example: sys->log_error("My message, val: %d", val);
          */
         int log_error(const char *fmt, ...);
+        /**
+         * Sends any buffered (tokenized) log messages to STDOUT
+         *
+         * With M0N0_LOG_TOKENIZED, the log_* calls only write the format 
+         * string ID and the arguments to a RAM ring buffer. This function
+         * sends the buffered messages to STDOUT as a base64 encoded line
+         * (decoded by adpdev/silicon_libs/log_decoder.py using the ELF 
+         * file). It is called automatically when the ring buffer is full,
+         * before text is printed and before a shutdown. Does nothing 
+         * without M0N0_LOG_TOKENIZED. 
+         *
+         * @note Not to be called from an interrupt handler
+         */
+        static void log_flush(void);
+        /**
+         * Replaces the log_* calls that are below M0N0_LOG_MIN_LEVEL 
+         * 
+         * @return -1 (not printed)
+         */
+        int _log_disabled(size_t) {
+            return -1;
+        }
+#ifdef M0N0_LOG_TOKENIZED
+        /**
+         * Records a tokenized log message (see the log_* macros)
+         *
+         * @param level The level of the message
+         * @param id The format string ID (see M0N0_LOG_TOKEN)
+         * @param args The arguments (integers, characters or pointers)
+         * @return 0, or -1 if the message was filtered
+         */
+        template <typename... Args>
+        int _log_token(LOG_LEVEL_t level, uint32_t id, Args... args) {
+            static_assert(M0N0_Log_Words<Args...>::value <= 15, 
+                    "Tokenized log messages have at most 15 argument words");
+            if (level < this->_log_level) {
+                return -1;
+            }
+            uint32_t words[M0N0_Log_Words<Args...>::value + 1] = {};
+            m0n0_log_args(words, args...);
+            return M0N0_System::_log_token_write(
+                    level, id, words, M0N0_Log_Words<Args...>::value);
+        }
+#endif
+        /**
+         * Prints a log message with the format string parsed at compile 
+         * time (see the log_* macros and m0n0_fmt.h)
+         *
+         * @param level The level of the message
+         * @param fmt The format string literal
+         * @param args The arguments
+         * @return The number of characters printed, or -1 if not printed
+         */
+        template <uint64_t... Specs, typename... Args>
+        int _log_fmt(LOG_LEVEL_t level, const char *fmt, Args... args) {
+#ifdef SUPPRESS_STDOUT
+            return -1;
+#endif
+            if (level < this->_log_level) {
+                return -1;
+            }
+            if (!M0N0_System::_is_deve()) {
+                return -1;
+            }
+            if (!M0N0_Fmt_Supported<Specs...>::value) {
+                return this->_log(level, fmt, args...);
+            }
+            M0N0_System::log_flush();
+            return m0n0_fmt_print_line<Specs...>(&m0n0_stdout_sink, 
+                    M0N0_System::_log_prefix(level), fmt, args...);
+        }
+        /**
+         * print() with the format string parsed at compile time (see 
+         * M0N0_FMT_PRINT)
+         */
+        template <uint64_t... Specs, typename... Args>
+        static int _print_fmt(const char *fmt, Args... args) {
+#ifdef SUPPRESS_STDOUT
+            return -1;
+#endif
+            if (!M0N0_System::_is_deve()) {
+                return -1;
+            }
+            M0N0_System::log_flush();
+            return m0n0_fmt_printf<Specs...>(&m0n0_stdout_sink, fmt, args...);
+        }
         /** 
          * A "printf" function
          *
@@ -401,6 +806,10 @@ class M0N0_System {
          * Note that the perf does not update immediately after exiting
          * the function. 
          *
+         * SystemCoreClock is set to the frequency of the level if the 
+         * perf frequency table has been characterised (see 
+         * characterise_perf_freqs). 
+         *
          * @param perf The perf level to set (0-15). 
          */
         void set_perf(uint8_t perf);
@@ -416,14 +825,107 @@ class M0N0_System {
          * @return the real-time clock counter value
          */
         uint64_t get_rtc(void); // get the raw 44-bit RTC value
+        /** Reads the 32 least significant bits of the RTC counter
+         *
+         * A single register read (get_rtc reads the MSBs and LSBs, and 
+         * re-reads them if the LSBs roll over in between). The LSBs roll 
+         * over every ~36 hours. 
+         *
+         * @return the 32 LSBs of the real-time clock counter value
+         */
+        static uint32_t get_rtc_lsbs(void) {
+            return M0N0_read_direct(STATUS_STATUS_2_REG);
+        }
+        /** The RTC ticks elapsed since start (from get_rtc_lsbs)
+         *
+         * Uses 32-bit arithmetic only, and is correct across the rollover 
+         * of the LSBs for intervals of up to kRtcElapsedMax ticks, 
+         * provided it is called at least once every kRtcElapsedMax ticks. 
+         *
+         * @param start The get_rtc_lsbs value at the start of the interval
+         * @return The RTC ticks since start
+         */
+        static uint32_t rtc_elapsed(uint32_t start) {
+            return M0N0_System::get_rtc_lsbs() - start;
+        }
         /** Reads the current RTC in microseconds (expensive)
          *
          * A convenient (but less efficient) for reading the RTC counter
-         * in microseconds (us). 
+         * in microseconds (us). Uses the RTC calibration. 
+         *
+         * @note Converts to float (soft-float): see get_time_us
          *
          * @return The RTC value in microseconds
          */
         float get_rtc_us(void); // get the microseconds elapsed. 
+        /** Reads the current RTC in microseconds
+         *
+         * Integer (fixed-point) conversion with the RTC calibration
+         *
+         * @return The RTC value in microseconds
+         */
+        uint64_t get_time_us(void);
+        /** Reads the current RTC in milliseconds
+         *
+         * Integer (fixed-point) conversion with the RTC calibration
+         *
+         * @return The RTC value in milliseconds
+         */
+        uint64_t get_time_ms(void);
+        /** Converts RTC ticks to microseconds (rounded)
+         *
+         * Uses fixed-point factors derived from the RTC calibration (no 
+         * floating point or division). 
+         *
+         * @param rtc_ticks The number of RTC ticks
+         * @return The time in microseconds
+         */
+        static uint64_t rtc_to_us(uint64_t rtc_ticks);
+        /** Converts RTC ticks to milliseconds (rounded)
+         *
+         * @param rtc_ticks The number of RTC ticks
+         * @return The time in milliseconds
+         */
+        static uint64_t rtc_to_ms(uint64_t rtc_ticks);
+        /** Converts microseconds to RTC ticks (rounded)
+         *
+         * @param time_us The time in microseconds
+         * @return The number of RTC ticks
+         */
+        static uint64_t us_to_rtc(uint64_t time_us);
+        /** Converts milliseconds to RTC ticks (rounded)
+         *
+         * Replaces the multiplication by kRtcOneMsTicks, which rounds the 
+         * RTC frequency (and so long intervals drift). 
+         *
+         * @param time_ms The time in milliseconds
+         * @return The number of RTC ticks
+         */
+        static uint64_t ms_to_rtc(uint64_t time_ms);
+        /** Sets the measured RTC frequency used by the time conversions
+         *
+         * The frequency is also stored in SHRAM (M0N0_RTC_CAL_SHRAM_ADDR), 
+         * so it is retained through a timed shutdown and loaded by the 
+         * constructor. It can be written by adpdev after trimming the RTC 
+         * (M0N0S2.derive_rtc_trim and write_rtc_calibration). 
+         *
+         * @param rtc_freq_millihz The RTC frequency in mHz (e.g. 33000000), 
+         *     between kRtcCalMinMilliHz and kRtcCalMaxMilliHz
+         * @return Whether the calibration was accepted
+         */
+        static bool set_rtc_calibration(uint32_t rtc_freq_millihz);
+        /** Returns the RTC frequency used by the time conversions
+         *
+         * @return The RTC frequency in mHz
+         */
+        static uint32_t get_rtc_calibration(void);
+        /** Loads the RTC calibration from SHRAM (if it is valid)
+         *
+         * Called by the constructor. 
+         *
+         * @return Whether a valid calibration was found
+         */
+        static bool load_rtc_calibration(void);
         /** Reads flag indicating whether RTC counter has stopped
          *
          * In (deep) shutdown mode the RTC stops. This flag indicates whether
@@ -449,6 +951,139 @@ class M0N0_System {
          * (timed using the RTC)
          */
         void sleep_ms(uint32_t time_ms);
+        /** Chooses the lowest power wait mechanism for an interval
+         *
+         * Deeper mechanisms use less power while waiting but cost more 
+         * to enter and exit. A mechanism is chosen if the interval is at 
+         * least kSleepBreakEvenRatio times its cost (see 
+         * characterise_sleep) and the state that must survive allows it 
+         * (a timed shutdown needs RETAIN_SHRAM). WFI and timed shutdown 
+         * are not used while the PCSM interrupt timer is in use 
+         * (autosampling, SoftTimers or a registered callback), and only 
+         * SLEEP_SPIN is used while autosampling (the perf is set over 
+         * SPI). 
+         *
+         * @param rtc_ticks The interval in RTC ticks
+         * @param retention The state that must survive the sleep
+         * @return The mechanism that sleep_for would use
+         */
+        SLEEP_MECHANISM_t plan_sleep(uint64_t rtc_ticks, 
+                SLEEP_RETENTION_t retention);
+        /** Sleeps for a number of RTC ticks using the cheapest mechanism
+         *
+         * Uses the mechanism chosen by plan_sleep: spin, spin at the 
+         * lowest perf, WFI with the PCSM interrupt timer (only when it is 
+         * not otherwise in use) or a timed shutdown. The perf is restored before 
+         * returning. 
+         *
+         * @note With RETAIN_SHRAM, the system may restart from reset 
+         *     instead of returning: state must already be in SHRAM. 
+         *
+         * @param rtc_ticks The interval in RTC ticks
+         * @param retention The state that must survive the sleep
+         * @return The mechanism used
+         */
+        SLEEP_MECHANISM_t sleep_for(uint64_t rtc_ticks, 
+                SLEEP_RETENTION_t retention);
+        /** Sleeps for a number of milliseconds (see sleep_for)
+         *
+         * @param time_ms The interval in milliseconds
+         * @param retention The state that must survive the sleep
+         * @return The mechanism used
+         */
+        SLEEP_MECHANISM_t sleep_for_ms(uint32_t time_ms, 
+                SLEEP_RETENTION_t retention);
+        /** Measures the entry/exit costs of the sleep mechanisms
+         *
+         * The low perf spin and WFI costs are measured and stored in SHRAM
+         * (M0N0_SLEEP_COST_SHRAM_ADDR) with the other costs, and so only 
+         * need to be characterised once (e.g. after a VBAT PoR). The timed
+         * shutdown cost is measured each time sleep_for wakes up from one.
+         * The WFI cost is not measured while the PCSM interrupt timer is 
+         * in use, and nothing is measured while autosampling (the perf is 
+         * set over SPI). 
+         */
+        void characterise_sleep(void);
+        /** Returns the entry/exit cost of a sleep mechanism
+         *
+         * @param mechanism The sleep mechanism
+         * @return The cost in RTC ticks
+         */
+        uint32_t get_sleep_cost(SLEEP_MECHANISM_t mechanism);
+        /** Sets (and stores) the entry/exit cost of a sleep mechanism
+         *
+         * @param mechanism The sleep mechanism
+         * @param rtc_ticks The cost in RTC ticks
+         */
+        void set_sleep_cost(SLEEP_MECHANISM_t mechanism, uint32_t rtc_ticks);
+        /** Enables the DVFS governor for a periodic task
+         *
+         * The task brackets each job (e.g. the processing of a frame) with
+         * begin_dvfs_job and end_dvfs_job (RTCTimer::wait_lp does this 
+         * when the governor is enabled). The job runs at the level chosen
+         * by the governor, which measures each job with the RTC: 
+         * - a missed deadline records a miss and returns to the maximum 
+         *   perf (and the level that missed is not used for kDvfsHoldJobs
+         *   jobs)
+         * - a job over budget steps the perf up a level
+         * - kDvfsStepDownJobs jobs in a row within kDvfsStepDownPct 
+         *   percent of the budget step the perf down a level
+         * 
+         * Jobs start at the maximum perf. The statistics are reset. 
+         *
+         * @note The perf is set over SPI, and so is not changed while 
+         *     autosampling: the statistics are recorded against the perf 
+         *     the job ran at and the level is held
+         *
+         * @param deadline_rtc_ticks The time a job must finish in
+         * @param budget_rtc_ticks The time a job should finish in (at most
+         *     the deadline, leaving a margin for the jitter of the job and
+         *     the time the perf takes to change)
+         */
+        void enable_dvfs_governor(uint32_t deadline_rtc_ticks, 
+                uint32_t budget_rtc_ticks);
+        /** Enables the DVFS governor (see enable_dvfs_governor)
+         *
+         * @param deadline_ms The time a job must finish in (ms)
+         * @param budget_ms The time a job should finish in (ms)
+         */
+        void enable_dvfs_governor_ms(uint32_t deadline_ms, uint32_t budget_ms);
+        /** Disables the DVFS governor (the perf is left as it is)
+         */
+        void disable_dvfs_governor(void);
+        /** Returns whether the DVFS governor is enabled
+         */
+        bool is_dvfs_governed(void);
+        /** Starts a job: sets the perf chosen by the DVFS governor
+         */
+        void begin_dvfs_job(void);
+        /** Ends a job: measures it and updates the DVFS governor level
+         *
+         * @return Whether the job met its deadline (true if no job had 
+         *     begun)
+         */
+        bool end_dvfs_job(void);
+        /** Returns the perf level the DVFS governor will use for the next 
+         * job
+         */
+        uint8_t get_dvfs_level(void);
+        /** Returns the number of jobs run at a perf level
+         *
+         * @param perf The perf level (0-15)
+         */
+        uint32_t get_dvfs_jobs(uint8_t perf);
+        /** Returns the number of jobs that missed the deadline at a perf 
+         * level
+         *
+         * @param perf The perf level (0-15)
+         */
+        uint32_t get_dvfs_misses(uint8_t perf);
+        /** Clears the DVFS governor statistics
+         */
+        void reset_dvfs_stats(void);
+        /** Logs the DVFS governor statistics for the levels used
+         */
+        void print_dvfs_stats(void);
         /** Runs a testcase (workload)
          *
          * Testcases defined in tc_functions.h can be run using their ID. 
@@ -622,6 +1257,34 @@ class M0N0_System {
         /** Disables the SysTick Timer and corresponding interrupt
          */
         void disable_systick(void);
+#ifdef M0N0_PC_SAMPLE
+        /**
+         * Starts the PC sampling profiler (see M0N0_PC_SAMPLE in 
+         * m0n0_defs.h), which counts the interrupted PC on each SysTick 
+         * interrupt, before the SysTick callback. 
+         *
+         * If the SysTick is already enabled (enable_systick), its period and
+         * callback are kept. Otherwise, the SysTick is enabled with the 
+         * given period. The histogram covers the code from 0 to __etext. 
+         *
+         * @param period_cycles The SysTick period (core cycles, at least 
+         *     kPcSampleMinCycles) if it is not already enabled
+         */
+        void start_pc_sampling(uint32_t period_cycles);
+        /**
+         * Stops the PC sampling profiler (the histogram is kept), and the 
+         * SysTick if it was enabled by start_pc_sampling
+         */
+        void stop_pc_sampling(void);
+        /**
+         * Sends the PC histogram as an ADP transaction named "pc_samples", 
+         * with the sample count and the measured overhead as parameters and
+         * one "address count" line per non-empty bin (symbolised by 
+         * adpdev/silicon_libs/pc_sample.py). Stop the sampling first for 
+         * consistent counts
+         */
+        void send_pc_samples_via_adp(void);
+#endif
         /**
          * Enable PCSM SPI autosampling
          *
@@ -689,6 +1352,14 @@ class M0N0_System {
          *
          */
         void adp_tx_end();
+        /** 
+         * Sends the region profile (see M0N0_PROFILE_BEGIN) as an ADP 
+         * transaction named "profile", with one "name count cycles_min 
+         * cycles_max cycles_total rtc_min rtc_max rtc_total perf_min 
+         * perf_max" line per region. The table is empty without 
+         * M0N0_PROFILE
+         */
+        void send_profile_via_adp();
         /** 
          * Sets the level of log messages that are sent via STDOUT
          *
@@ -699,6 +1370,13 @@ class M0N0_System {
          * @param log_level The minimum message level to send
          */
         void set_log_level(LOG_LEVEL_t log_level);
+        /**
+         * Returns the minimum level of log messages that are sent via 
+         * STDOUT (see set_log_level)
+         *
+         * @return The minimum message level sent
+         */
+        LOG_LEVEL_t get_log_level(void);
         /**
          * Turns on the PCSM interrupt time (loop timer) to raise an interrupt
          * after the specified time. 
@@ -726,7 +1404,7 @@ class M0N0_System {
         /**
          * Disables the PCSM interrupt timer (loop timer).
          * after the specified time. Interrupt occurs periodically until
-         * disabled.
+         * disabled. The callback is removed. 
          *
          */
         void disable_pcsm_interrupt_timer(void);
@@ -734,9 +1412,134 @@ class M0N0_System {
          * A utility function for estimating the current TCRO frequency using
          * by comparing it to the RTC clock
          *
+         * Blocks for 10 ms and disables the SysTick (see 
+         * enable_tcro_tracking for a background estimate). 
+         *
          * @return the estimated TCRO frequency in kHz
          */
         uint32_t estimate_tcro(void);
+        /** Measures the core frequency at each perf level
+         *
+         * Runs estimate_tcro at the 16 perf levels (~200 ms in total) and
+         * stores the table in SHRAM (M0N0_PERF_FREQ_SHRAM_ADDR) with a 
+         * validity tag, and so only needs to be run once (e.g. after a 
+         * VBAT PoR). The table is loaded by the constructor, after which 
+         * set_perf keeps SystemCoreClock up to date. 
+         *
+         * @note As estimate_tcro, this disables the SysTick
+         */
+        void characterise_perf_freqs(void);
+        /** Returns whether the perf frequency table has been characterised
+         */
+        bool is_perf_freq_characterised(void);
+        /** Returns the core frequency at a perf level (from the table)
+         *
+         * @param perf The perf level (0-15)
+         * @return The frequency in kHz (0 if not characterised)
+         */
+        uint32_t get_perf_freq_khz(uint8_t perf);
+        /** Enables tracking of the core (TCRO) frequency
+         *
+         * The DWT cycle counter is compared with the RTC at the library 
+         * interrupt handlers (SysTick, autosample, PCSM interrupt timer and
+         * EXTWAKE), and so the estimate is updated in the background 
+         * without blocking or using the SysTick (unlike estimate_tcro). 
+         * It is reset by set_perf. 
+         *
+         * The cycle counter stops while the core sleeps: the library calls
+         * break_tcro_window before its WFIs, and windows that measure under
+         * kTcroRejectPct of the estimate are discarded. 
+         */
+        void enable_tcro_tracking(void);
+        /** Disables tracking of the core frequency
+         */
+        void disable_tcro_tracking(void);
+        /** Clears the tracked core frequency (e.g. after it changes)
+         */
+        void reset_tcro_tracking(void);
+        /** Ends the current tracking window (call before sleeping)
+         */
+        void break_tcro_window(void);
+        /** Adds a sample (called by the library interrupt handlers)
+         *
+         * Can also be called from other interrupt handlers, or with 
+         * interrupts masked. 
+         */
+        void sample_tcro(void);
+        /** Returns the tracked core frequency
+         *
+         * @return The frequency in kHz (0 if no window has been measured)
+         */
+        uint32_t get_tcro_khz(void);
+        /** Returns the confidence of the tracked core frequency
+         *
+         * @return The worst-case error due to the RTC resolution, in parts
+         *     per million (1000000 if no window has been measured)
+         */
+        uint32_t get_tcro_error_ppm(void);
 };
 
+#ifdef M0N0_LOG_TOKENIZED
+/** Places a log format string (must be a string literal) in the m0n0_fmt 
+ * section and returns its ID (its offset in the section). The section is 
+ * not loaded on the target (see m0n0.ld). 
+ */
+#define M0N0_LOG_TOKEN(fmt) __extension__({ \
+        static const char _m0n0_log_fmt[] \
+                __attribute__((section("m0n0_fmt"), used)) = fmt; \
+        (uint32_t)((uintptr_t)_m0n0_log_fmt - (uintptr_t)__start_m0n0_fmt); })
+
+/* The log_* calls are tokenized without changing the call sites: the 
+ * format string must be a string literal (use "%s" for other strings). 
+ * The text versions can still be called as (sys->log_info)(fmt, ...). 
+ */
+#define M0N0_LOG_CALL(level, fmt, ...) \
+        _log_token(level, M0N0_LOG_TOKEN(fmt), ##__VA_ARGS__)
+#endif
+
+/** M0N0_System::print with the format string (which must be a string 
+ * literal) parsed at compile time, e.g. M0N0_FMT_PRINT("val: %d\n", val)
+ */
+#define M0N0_FMT_PRINT(fmt, ...) \
+        M0N0_System::_print_fmt<M0N0_FMT_SPECS(fmt)>(fmt, ##__VA_ARGS__)
+
+#if defined(M0N0_LOG_CONSTEXPR) && !defined(M0N0_LOG_TOKENIZED)
+/* The log_* calls are parsed at compile time without changing the call 
+ * sites: the format string must be a string literal (use "%s" for other 
+ * strings). The run-time versions can still be called as 
+ * (sys->log_info)(fmt, ...). 
+ */
+#define M0N0_LOG_CALL(level, fmt, ...) \
+        _log_fmt<M0N0_FMT_SPECS(fmt)>(level, fmt, ##__VA_ARGS__)
+#endif
+
+/** Only used in unevaluated context (not defined), so that the arguments of
+ * disabled log calls still count as used (avoids unused variable warnings)
+ */
+template <typename... Args>
+int m0n0_log_unused(Args... args);
+
+/* Log calls below M0N0_LOG_MIN_LEVEL are replaced by _log_disabled() (the
+ * arguments are not evaluated) */
+#define M0N0_LOG_DISABLED(...) \
+        _log_disabled(sizeof(m0n0_log_unused(__VA_ARGS__)))
+#if M0N0_LOG_MIN_LEVEL > 0
+#define log_debug(...) M0N0_LOG_DISABLED(__VA_ARGS__)
+#elif defined(M0N0_LOG_TOKENIZED) || defined(M0N0_LOG_CONSTEXPR)
+#define log_debug(fmt, ...) M0N0_LOG_CALL(DEBUG, fmt, ##__VA_ARGS__)
+#endif
+#if M0N0_LOG_MIN_LEVEL > 1
+#define log_info(...) M0N0_LOG_DISABLED(__VA_ARGS__)
+#elif defined(M0N0_LOG_TOKENIZED) || defined(M0N0_LOG_CONSTEXPR)
+#define log_info(fmt, ...) M0N0_LOG_CALL(INFO, fmt, ##__VA_ARGS__)
+#endif
+#if M0N0_LOG_MIN_LEVEL > 2
+#define log_warn(...) M0N0_LOG_DISABLED(__VA_ARGS__)
+#elif defined(M0N0_LOG_TOKENIZED) || defined(M0N0_LOG_CONSTEXPR)
+#define log_warn(fmt, ...) M0N0_LOG_CALL(WARN, fmt, ##__VA_ARGS__)
+#endif
+#if defined(M0N0_LOG_TOKENIZED) || defined(M0N0_LOG_CONSTEXPR)
+#define log_error(fmt, ...) M0N0_LOG_CALL(ERROR, fmt, ##__VA_ARGS__)
+#endif
+
 #endif // M0N0_H
@@ -74,9 +74,41 @@ typedef struct
 #define STDOUT                    ((FIFO_Type*)   STDOUT_BASE)
 #define STDIN                     ((FIFO_Type*)   STDIN_BASE)
 
+#ifndef M0N0_STDOUT_QUEUE_SIZE
+/** The size of the STDOUT queue (M0N0_STDOUT_BUFFERED) in characters */
+#define M0N0_STDOUT_QUEUE_SIZE 256
+#endif
+/* M0N0_STDOUT_IRQ_NUM: the interrupt number of the STDOUT (FIFO not 
+ * full) interrupt. It has no default (it is not verified on the silicon), 
+ * and so must be set with M0N0_STDOUT_BUFFERED. */
+#if defined(M0N0_STDOUT_BUFFERED) && !defined(M0N0_STDOUT_IRQ_NUM)
+#error "M0N0_STDOUT_BUFFERED needs M0N0_STDOUT_IRQ_NUM (the STDOUT interrupt)"
+#endif
+
 /** Generic handler function definition
  */
 typedef void (*Handler_Func)(void);
+/** Register/memory read driver (e.g. M0N0_read)
+ */
+typedef uint32_t (*Read_Driver_Func)(uint32_t);
+/** Register/memory write driver (e.g. M0N0_write)
+ */
+typedef void (*Write_Driver_Func)(uint32_t, uint32_t);
+
+#ifdef M0N0_HOST
+/** Sets the drivers used by M0N0_read and M0N0_write in the host build
+ *
+ * The host (native) build has no M0N0 memory map, so all accesses are passed
+ *     to a simulated memory map (see M0N0_libs/M0N0_host), which registers 
+ *     its drivers using this function. 
+ *
+ * @param read_driver The function that reads a word from the memory map
+ * @param write_driver The function that writes a word to the memory map
+ */
+void M0N0_set_host_drivers(
+        Read_Driver_Func read_driver,
+        Write_Driver_Func write_driver);
+#endif
 
 /** Reads a word from the memory map (register or memory)
  * 
@@ -167,6 +199,28 @@ void M0N0_write_mask_and_shift(
         uint32_t mask,
         uint32_t data);
 
+/** Sets bits of a register (writes 1 to the bits in the mask)
+ *
+ * If the register supports set/clear aliases (see M0N0_HAS_SET_CLR_ALIAS), 
+ *     this is a single store to the set alias address (atomic, so safe 
+ *     against interrupt handlers updating other bits of the register). 
+ *     Otherwise, it is a read-modify-write. 
+ * 
+ * @param address The absolute (memory map) address of the register
+ * @param mask The bits to set
+ */
+void M0N0_set_bits(uint32_t address, uint32_t mask);
+/** Clears bits of a register (writes 0 to the bits in the mask)
+ *
+ * If the register supports set/clear aliases (see M0N0_HAS_SET_CLR_ALIAS), 
+ *     this is a single store to the clear alias address. Otherwise, it is a 
+ *     read-modify-write. 
+ * 
+ * @param address The absolute (memory map) address of the register
+ * @param mask The bits to clear
+ */
+void M0N0_clear_bits(uint32_t address, uint32_t mask);
+
 /** Calculates bit-shift distance from mask
  *
  * @param mask The bit-mask
@@ -174,6 +228,38 @@ void M0N0_write_mask_and_shift(
  */
 uint8_t mask_to_shift(uint32_t mask);
 
+/** Reads a word from the memory map with a single inlined volatile load
+ *
+ * Equivalent to M0N0_read, but is always inlined into the caller (avoiding
+ *     the function call, which is expensive with -mlong-calls). Used by the
+ *     compile-time register descriptors defined in m0n0_regs.h.
+ *
+ * @param address The absolute (memory map) address to read
+ * @return the read register word
+ */
+__STATIC_FORCEINLINE uint32_t M0N0_read_direct(uint32_t address) {
+#ifdef M0N0_HOST
+    return M0N0_read(address); // simulated memory map
+#else
+    return *((__IO uint32_t *)(address));
+#endif
+}
+
+/** Writes a word to the memory map with a single inlined volatile store
+ *
+ * Equivalent to M0N0_write, but is always inlined into the caller.
+ *
+ * @param address The absolute (memory map) address to write
+ * @param data The word to write.
+ */
+__STATIC_FORCEINLINE void M0N0_write_direct(uint32_t address, uint32_t data) {
+#ifdef M0N0_HOST
+    M0N0_write(address, data); // simulated memory map
+#else
+    *((__IO uint32_t *)(address)) = data;
+#endif
+}
+
 /** Reads a single character from STDIN (i.e. via ADP). If there is no 
  *  character in the buffer, it waits until it receives one. 
  *
@@ -184,10 +270,41 @@ char M0N0_read_stdin(void);
 /** Writes a single character to STDOUT (i.e. via ADP). Note that DEVE
  *  must be enabled (see M0N0_is_deve function). Furthermore ADP must be 
  *  actively read, otherwise the buffer will fill and the system will hang.
+ *  With M0N0_STDOUT_BUFFERED, the character is added to a RAM queue 
+ *  (M0N0_STDOUT_QUEUE_SIZE characters) which is sent by the STDOUT 
+ *  interrupt handler, and it only waits if the queue is full. 
  *
  * @return The next character in the buffer
  */
 void M0N0_write_stdout(uint8_t data);
+
+/** Writes len characters to STDOUT. Equivalent to calling M0N0_write_stdout
+ *  for each character, but with M0N0_STDOUT_BUFFERED the characters are 
+ *  copied into the queue (and the FIFO started) once per call, rather than 
+ *  once per character. 
+ *
+ * @param data The characters to write
+ * @param len The number of characters
+ */
+void M0N0_write_stdout_buf(const char *data, uint32_t len);
+
+/** Waits until all of the characters queued by M0N0_write_stdout have been
+ *  written to the STDOUT FIFO (only with M0N0_STDOUT_BUFFERED). The core
+ *  sleeps (WFI) while the STDOUT interrupt refills the FIFO. Called 
+ *  automatically before a shutdown, at the end of an ADP transaction and 
+ *  when the host build exits. Characters still queued when main returns 
+ *  are otherwise lost if interrupts stop being served, so call it before 
+ *  returning from main. 
+ */
+void M0N0_flush_stdout(void);
+
+#ifdef M0N0_STDOUT_BUFFERED
+/** Refills the STDOUT FIFO from the STDOUT queue. Called from the STDOUT 
+ *  interrupt handler (Interrupt<M0N0_STDOUT_IRQ_NUM>_Handler, defined in 
+ *  m0n0_defs.c). 
+ */
+void M0N0_stdout_irq_handler(void);
+#endif
 /** Write a byte over SPI
  *
  * @param data The data to write over SPI
@@ -195,12 +312,75 @@ void M0N0_write_stdout(uint8_t data);
  */
 uint8_t M0N0_spi_write(uint8_t data);
 
-/** Checks whether DEVE is set or not
+/** Checks whether DEVE is set or not. The state is read from the status
+ *  register on the first call after reset and then cached (see 
+ *  M0N0_refresh_deve). 
  *
  * @return TRUE is DEVE is enabled
  */
 uint8_t M0N0_is_deve(void);
 
+/** Re-reads the DEVE state from the status register (e.g. after waking up
+ *  from sleep)
+ *
+ * @return TRUE is DEVE is enabled
+ */
+uint8_t M0N0_refresh_deve(void);
+
+/** Converts a raw perf HW ID (STATUS_7) to the DVFS level (0-15)
+ *
+ * @param raw_perf The raw HW ID (16-31)
+ * @return The DVFS level (128 if the HW ID is invalid)
+ */
+uint8_t M0N0_perf_level(uint8_t raw_perf);
+
+/** Enables the DWT cycle counter (CYCCNT) without resetting it. Other 
+ *  users (e.g. the core frequency tracking and the profilers) measure 
+ *  windows that span each other, and so cycles are measured as the 
+ *  difference of two reads (which wraps correctly). 
+ */
+void M0N0_cyccnt_enable(void);
+
+/** The nominal RTC frequency (mHz), used until a calibration is set (see 
+ *  M0N0_System::set_rtc_calibration)
+ */
+#define M0N0_RTC_FREQ_MILLIHZ 33000000
+
+#ifndef M0N0_RTC_CAL_SHRAM_ADDR
+/** The (SHRAM relative) address of the RTC calibration: the RTC frequency 
+ * in mHz followed by its complement (see M0N0_System::set_rtc_calibration)
+ */
+#define M0N0_RTC_CAL_SHRAM_ADDR (MEM_MAP_SHRAM_SIZE - 8)
+#endif
+
+#ifndef M0N0_SLEEP_COST_SHRAM_ADDR
+/** The (SHRAM relative) address of the sleep cost record: the entry/exit 
+ * cost of each SLEEP_MECHANISM_t (RTC ticks), a check word and the 
+ * expected wake up time of a pending timed shutdown (see 
+ * M0N0_System::characterise_sleep)
+ */
+#define M0N0_SLEEP_COST_SHRAM_ADDR (M0N0_RTC_CAL_SHRAM_ADDR - 32)
+#endif
+
+#ifndef M0N0_PERF_FREQ_SHRAM_ADDR
+/** The (SHRAM relative) address of the perf frequency table: the core 
+ * frequency (kHz) at each perf level (0-15) followed by a validity tag 
+ * (see M0N0_System::characterise_perf_freqs)
+ */
+#define M0N0_PERF_FREQ_SHRAM_ADDR (M0N0_SLEEP_COST_SHRAM_ADDR - 128)
+#endif
+
+/** Reads the RTC calibration stored in SHRAM (M0N0_RTC_CAL_SHRAM_ADDR)
+ *
+ * @return The RTC frequency (mHz), or 0 if no calibration is stored
+ */
+uint32_t M0N0_read_rtc_calibration(void);
+
+/** The ADP command ID that prefixes the ADP transaction (TX) markers 
+ *  recognised by the ADPDev scripts
+ */
+#define ADP_COMMAND_ID "3d7db2ae"
+
 /** Enumerator for specifying the SPI Chip Select
  */
 typedef enum {
@@ -219,6 +399,25 @@ typedef enum {
    W, // write only
 } MEM_RD_WR_t;
 
+/** Enumerator for specifying the state that must survive a sleep (see 
+ *  M0N0_System::sleep_for)
+ */
+typedef enum {
+   RETAIN_CONTEXT = 0, // execution continues after the sleep
+   RETAIN_SHRAM = 1, // only SHRAM: the system may restart from reset
+} SLEEP_RETENTION_t;
+
+/** Enumerator for the wait mechanisms chosen by M0N0_System::sleep_for 
+ *  (lowest power last)
+ */
+typedef enum {
+   SLEEP_SPIN = 0, // active wait at the current perf
+   SLEEP_SPIN_LP = 1, // active wait at the lowest perf
+   SLEEP_WFI = 2, // WFI at the lowest perf, woken by the PCSM inttimer
+   SLEEP_TIMED_SHUTDOWN = 3, // timed shutdown (restarts from reset)
+   SLEEP_NUM_MECHANISMS = 4
+} SLEEP_MECHANISM_t;
+
 /** Enumerator for specifying the logger level
  */
 typedef enum {
@@ -228,6 +427,193 @@ typedef enum {
    ERROR = 3,
 } LOG_LEVEL_t;
 
+/** The minimum log level that is compiled in (0: DEBUG, 1: INFO, 2: WARN,
+ *  3: ERROR). Log calls below this level are removed at compile 
+ *  time, including the evaluation of their arguments. 
+ */
+#ifndef M0N0_LOG_MIN_LEVEL
+#define M0N0_LOG_MIN_LEVEL 0
+#endif
+
+/* printf with a compile-time level for C code (needs m0n0_printf.h). Only
+ * prints if DEVE is enabled. When disabled, the arguments are not evaluated
+ * (but still count as used). */
+#define M0N0_PRINTF_ENABLED(...) \
+        (M0N0_is_deve() ? (void)m0n0_printf(__VA_ARGS__) : (void)0)
+#define M0N0_PRINTF_DISABLED(...) ((void)sizeof(m0n0_printf(__VA_ARGS__)))
+#if M0N0_LOG_MIN_LEVEL <= 0
+#define M0N0_PRINTF_DEBUG(...) M0N0_PRINTF_ENABLED(__VA_ARGS__)
+#else
+#define M0N0_PRINTF_DEBUG(...) M0N0_PRINTF_DISABLED(__VA_ARGS__)
+#endif
+#if M0N0_LOG_MIN_LEVEL <= 1
+#define M0N0_PRINTF_INFO(...) M0N0_PRINTF_ENABLED(__VA_ARGS__)
+#else
+#define M0N0_PRINTF_INFO(...) M0N0_PRINTF_DISABLED(__VA_ARGS__)
+#endif
+
+/* Region profiler (M0N0_PROFILE)
+ *
+ * Each named region records the DWT cycle count, the RTC ticks and the DVFS
+ * level (at the end) into a static table (count, min, max and total):
+ *
+ *     M0N0_PROFILE_BEGIN(mfcc);
+ *     mfcc_compute(...);
+ *     M0N0_PROFILE_END(mfcc);
+ *
+ * (or M0N0_PROFILE_SCOPE(name) in C++, see sysutil.h). The table is sent 
+ * with M0N0_profile_send_via_adp (an ADP TX named "profile", decoded by 
+ * adpdev/silicon_libs/region_profile.py). Without M0N0_PROFILE, the macros
+ * compile to nothing. A region should only be used from one context (the 
+ * main code or one interrupt handler). 
+ */
+#ifdef M0N0_PROFILE
+#ifndef M0N0_PROFILE_REGIONS
+/** The number of regions in the profile table (each is 44 bytes of RAM)
+ */
+#define M0N0_PROFILE_REGIONS 16
+#endif
+
+/** The statistics of a profiled region
+ */
+typedef struct {
+    const char* name;
+    uint32_t count;
+    uint32_t cycles_min;
+    uint32_t cycles_max;
+    uint64_t cycles_total;
+    uint32_t rtc_min;
+    uint32_t rtc_max;
+    uint32_t rtc_total;
+    uint8_t perf_min;
+    uint8_t perf_max;
+} M0N0_Profile_Region;
+
+/** The start of a region (see M0N0_PROFILE_BEGIN)
+ */
+typedef struct {
+    uint32_t region;
+    uint32_t cycles;
+    uint32_t rtc;
+} M0N0_Profile_Mark;
+
+/** Slot value before a region is added to the table
+ */
+#define M0N0_PROFILE_UNREGISTERED 0xFFFFFFFF
+
+/** Starts a region (see M0N0_PROFILE_BEGIN)
+ *
+ * @param mark The start of the region (passed to M0N0_profile_end)
+ * @param slot The table index of the region (set on the first call)
+ * @param name The name of the region
+ */
+void M0N0_profile_begin(M0N0_Profile_Mark* mark, uint32_t* slot,
+        const char* name);
+/** Ends a region and updates its statistics
+ *
+ * @param mark The start of the region (from M0N0_profile_begin)
+ */
+void M0N0_profile_end(const M0N0_Profile_Mark* mark);
+/** Returns the statistics of a region (NULL if the index is not used)
+ *
+ * @param index The table index (0 to M0N0_PROFILE_REGIONS-1)
+ */
+const M0N0_Profile_Region* M0N0_profile_get_region(uint32_t index);
+/** Clears the statistics (the regions stay in the table)
+ */
+void M0N0_profile_reset(void);
+/** Prints one line per region ("name count cycles_min cycles_max 
+ *  cycles_total rtc_min rtc_max rtc_total perf_min perf_max")
+ */
+void M0N0_profile_print_rows(void);
+/** Sends the table as an ADP TX named "profile" (for C-only projects, see
+ *  also M0N0_System::send_profile_via_adp)
+ */
+void M0N0_profile_send_via_adp(void);
+
+#define M0N0_PROFILE_BEGIN(name) \
+    static uint32_t m0n0_profile_slot_##name = M0N0_PROFILE_UNREGISTERED; \
+    M0N0_Profile_Mark m0n0_profile_mark_##name; \
+    M0N0_profile_begin(&m0n0_profile_mark_##name, \
+            &m0n0_profile_slot_##name, #name)
+#define M0N0_PROFILE_END(name) M0N0_profile_end(&m0n0_profile_mark_##name)
+#else
+#define M0N0_PROFILE_BEGIN(name)
+#define M0N0_PROFILE_END(name)
+#endif
+
+/* PC sampling profiler (M0N0_PC_SAMPLE)
+ *
+ * With M0N0_PC_SAMPLE, the SysTick handler (interrupts.c) reads the PC 
+ * stacked by the exception entry and counts it in a histogram of 
+ * M0N0_PC_SAMPLE_BINS bins (2^shift bytes of code per bin) before calling 
+ * the SysTick callback (see M0N0_System::start_pc_sampling). The histogram is
+ * sent with M0N0_pc_sample_send_via_adp (an ADP TX named "pc_samples", 
+ * symbolised against the ELF file by adpdev/silicon_libs/pc_sample.py). 
+ *
+ * The time spent in M0N0_pc_sample is measured with the DWT cycle counter 
+ * and reported with the samples (the exception entry/exit, about 24 cycles, 
+ * and the chained SysTick callback are not included). In the host build, 
+ * there is no exception frame: the samples are counted as out of range. 
+ */
+#ifdef M0N0_PC_SAMPLE
+#ifndef M0N0_PC_SAMPLE_BINS
+/** The number of histogram bins (each is 2 bytes of RAM)
+ */
+#define M0N0_PC_SAMPLE_BINS 256
+#endif
+
+/** The state of the PC sampling profiler
+ */
+typedef struct {
+    uint32_t base; // address of the first bin
+    uint32_t shift; // each bin is (1 << shift) bytes
+    uint32_t samples; // including those out of range
+    uint32_t out_of_range;
+    uint32_t isr_cycles_max; // cycles spent in M0N0_pc_sample
+    uint64_t isr_cycles_total;
+    uint64_t elapsed_cycles; // between the first and last samples
+} M0N0_PC_Sample_Stats;
+
+/** Clears the histogram and starts counting the samples
+ *
+ * @param base The lowest code address to count
+ * @param size The size of the code to count (bytes). The bin size is the
+ *     smallest power of 2 that covers it with M0N0_PC_SAMPLE_BINS bins
+ */
+void M0N0_pc_sample_start(uint32_t base, uint32_t size);
+/** Stops counting the samples (the histogram is kept)
+ */
+void M0N0_pc_sample_stop(void);
+/** Returns whether the samples are being counted
+ */
+uint8_t M0N0_pc_sample_is_running(void);
+/** Counts a sample (called from the SysTick handler)
+ *
+ * @param pc The interrupted PC (0xFFFFFFFF if not known)
+ */
+void M0N0_pc_sample(uint32_t pc);
+/** Returns the state of the profiler (counts and overhead)
+ */
+const M0N0_PC_Sample_Stats* M0N0_pc_sample_get_stats(void);
+/** Returns the histogram (M0N0_PC_SAMPLE_BINS counts, saturating at 0xFFFF)
+ */
+const uint16_t* M0N0_pc_sample_get_bins(void);
+/** Returns the share of the sampled time spent in M0N0_pc_sample (ppm)
+ */
+uint32_t M0N0_pc_sample_overhead_ppm(void);
+/** Prints the parameters of the "pc_samples" ADP TX ("key : value" lines)
+ */
+void M0N0_pc_sample_print_params(void);
+/** Prints one "address count" line per non-empty bin
+ */
+void M0N0_pc_sample_print_rows(void);
+/** Sends the histogram as an ADP TX named "pc_samples" (for C-only 
+ *  projects, see also M0N0_System::send_pc_samples_via_adp)
+ */
+void M0N0_pc_sample_send_via_adp(void);
+#endif
+
 
 /* Auto-generated from registers_models */
 /*REGISTERS_MODELS_START*/
@@ -608,6 +994,17 @@ typedef enum {
 #define PCSM_INTTIMER0_REG                                0x000023
 /*REGISTERS_MODELS_END*/
 
+/** Whether a register supports the hardware set/clear alias addresses
+ *
+ * Writing a mask to the register address plus CONTROL_SET_OFFSET sets those
+ *     bits and writing to the address plus CONTROL_CLR_OFFSET clears them. 
+ *     Only the control registers support this (set_addr_offset and 
+ *     clr_addr_offset in the registers_models). 
+ */
+#define M0N0_HAS_SET_CLR_ALIAS(address) \
+    (((address) >= CONTROL_BASE_ADDR) && \
+     ((address) <= (CONTROL_BASE_ADDR + CONTROL_SIZE)))
+
 
 
 #endif // M0N0_DEFS_H
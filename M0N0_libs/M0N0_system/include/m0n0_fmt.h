@@ -0,0 +1,474 @@
+
+/*
+ * Copyright (c) 2020, Arm Limited
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+#ifndef M0N0_FMT_H
+#define M0N0_FMT_H
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+extern "C" {
+    #include "m0n0_printf.h"
+}
+
+/**
+@file
+@brief Compile-time parsed format strings (see M0N0_FMT_SINK_PRINTF)
+
+The format string literal is parsed at compile time (C++11 constexpr) into
+one 64-bit spec per conversion, and each call site is compiled into a 
+sequence of emitters for exactly those conversions: no format parsing and
+no va_arg at run-time. The supported syntax is the subset of m0n0_printf:
+'-' and '0' flags, a width, 'l'/'ll' and 'd' 'u' 'x' 'X' 'c' 's' '%'. 
+Other formats (e.g. '*', a precision or 'q') and more than 
+M0N0_FMT_MAX_CONVS conversions fall back to the run-time formatter. The 
+arguments are converted to the type of the conversion, and a wrong number of 
+arguments is a compile error.
+*/
+
+/** Maximum number of conversions handled at compile time (the specs are 
+ * listed in M0N0_FMT_SPECS) 
+ */
+#define M0N0_FMT_MAX_CONVS 8
+
+// conversion codes
+const uint32_t kFmtEnd = 0; // end of the format string (tail literal)
+const uint32_t kFmtRuntime = 1; // not supported: use the run-time formatter
+const uint32_t kFmtPercent = 2;
+const uint32_t kFmtDec = 3;
+const uint32_t kFmtUnsigned = 4;
+const uint32_t kFmtHex = 5;
+const uint32_t kFmtHexUpper = 6;
+const uint32_t kFmtChar = 7;
+const uint32_t kFmtString = 8;
+
+// flags (as m0n0_printf)
+const uint32_t kFmtPadZero = 1;
+const uint32_t kFmtPadRight = 2;
+
+// Spec layout: literal start [15:0], literal length [31:16], 
+// conversion [35:32], flags [37:36], 64-bit [38], width [47:40]
+constexpr uint64_t m0n0_fmt_make_spec(
+        uint32_t start, uint32_t len, uint32_t conv, uint32_t flags, 
+        uint32_t ll, uint32_t width) {
+    return ((start > 0xFFFF) || (len > 0xFFFF) || (width > 0xFF)) ? 
+            ((uint64_t)kFmtRuntime << 32) :
+            ((uint64_t)start | ((uint64_t)len << 16) | ((uint64_t)conv << 32) 
+            | ((uint64_t)flags << 36) | ((uint64_t)ll << 38) 
+            | ((uint64_t)width << 40));
+}
+constexpr uint32_t m0n0_fmt_start(uint64_t s) { return s & 0xFFFF; }
+constexpr uint32_t m0n0_fmt_len(uint64_t s) { return (s >> 16) & 0xFFFF; }
+constexpr uint32_t m0n0_fmt_conv(uint64_t s) { return (s >> 32) & 0xF; }
+constexpr uint32_t m0n0_fmt_flags(uint64_t s) { return (s >> 36) & 0x3; }
+constexpr uint32_t m0n0_fmt_ll(uint64_t s) { return (s >> 38) & 0x1; }
+constexpr uint32_t m0n0_fmt_width(uint64_t s) { return (s >> 40) & 0xFF; }
+
+// Parser (C++11 constexpr functions are a single return statement, so 
+// loops are written as recursion over the character index)
+constexpr bool m0n0_fmt_is_digit(char c) {
+    return (c >= '0') && (c <= '9');
+}
+/** Index of the next '%' (or of the terminator) from index i */
+constexpr uint32_t m0n0_fmt_next_pct(const char* f, uint32_t i) {
+    return ((f[i] == '\0') || (f[i] == '%')) ? i : m0n0_fmt_next_pct(f, i+1);
+}
+constexpr uint32_t m0n0_fmt_skip_zeros(const char* f, uint32_t i) {
+    return (f[i] == '0') ? m0n0_fmt_skip_zeros(f, i+1) : i;
+}
+constexpr uint32_t m0n0_fmt_skip_digits(const char* f, uint32_t i) {
+    return m0n0_fmt_is_digit(f[i]) ? m0n0_fmt_skip_digits(f, i+1) : i;
+}
+constexpr uint32_t m0n0_fmt_skip_l(const char* f, uint32_t i) {
+    return (f[i] == 'l') ? m0n0_fmt_skip_l(f, i+1) : i;
+}
+/** Index of the first digit of the width of the conversion at pct */
+constexpr uint32_t m0n0_fmt_width_pos(const char* f, uint32_t pct) {
+    return m0n0_fmt_skip_zeros(f, (f[pct+1] == '-') ? pct+2 : pct+1);
+}
+/** Index of the 'l's of the conversion at pct */
+constexpr uint32_t m0n0_fmt_l_pos(const char* f, uint32_t pct) {
+    return m0n0_fmt_skip_digits(f, m0n0_fmt_width_pos(f, pct));
+}
+/** Index of the conversion character of the conversion at pct */
+constexpr uint32_t m0n0_fmt_conv_pos(const char* f, uint32_t pct) {
+    return m0n0_fmt_skip_l(f, m0n0_fmt_l_pos(f, pct));
+}
+/** Index after the conversion at pct (pct is the terminator at the end) */
+constexpr uint32_t m0n0_fmt_conv_end(const char* f, uint32_t pct) {
+    return (f[pct] == '\0') ? pct : 
+            (f[m0n0_fmt_conv_pos(f, pct)] == '\0') ? 
+            m0n0_fmt_conv_pos(f, pct) : m0n0_fmt_conv_pos(f, pct) + 1;
+}
+/** Index of the literal text before conversion n */
+constexpr uint32_t m0n0_fmt_lit_start(const char* f, uint32_t n) {
+    return (n == 0) ? 0 : 
+            m0n0_fmt_conv_end(f, 
+                    m0n0_fmt_next_pct(f, m0n0_fmt_lit_start(f, n-1)));
+}
+constexpr uint32_t m0n0_fmt_parse_width(
+        const char* f, uint32_t i, uint32_t acc) {
+    return (!m0n0_fmt_is_digit(f[i]) || (acc > 0xFF)) ? acc : 
+            m0n0_fmt_parse_width(f, i+1, acc*10 + (f[i] - '0'));
+}
+constexpr uint32_t m0n0_fmt_parse_flags(const char* f, uint32_t pct) {
+    return ((f[pct+1] == '-') ? kFmtPadRight : 0) |
+            ((m0n0_fmt_width_pos(f, pct) > pct + 1 + (f[pct+1] == '-')) ? 
+            kFmtPadZero : 0);
+}
+/** Conversion code of the conversion at pct. 'l' is 64-bit if long is */
+constexpr uint32_t m0n0_fmt_parse_conv(const char* f, uint32_t pct) {
+    return (f[pct] == '\0') ? kFmtEnd :
+            ((m0n0_fmt_conv_pos(f, pct) - m0n0_fmt_l_pos(f, pct)) > 2) ? 
+            kFmtRuntime :
+            (f[m0n0_fmt_conv_pos(f, pct)] == 'd') ? kFmtDec :
+            (f[m0n0_fmt_conv_pos(f, pct)] == 'u') ? kFmtUnsigned :
+            (f[m0n0_fmt_conv_pos(f, pct)] == 'x') ? kFmtHex :
+            (f[m0n0_fmt_conv_pos(f, pct)] == 'X') ? kFmtHexUpper :
+            (f[m0n0_fmt_conv_pos(f, pct)] == 'c') ? kFmtChar :
+            (f[m0n0_fmt_conv_pos(f, pct)] == 's') ? kFmtString :
+            ((f[m0n0_fmt_conv_pos(f, pct)] == '%') && 
+                    (m0n0_fmt_conv_pos(f, pct) == pct + 1)) ? kFmtPercent :
+            kFmtRuntime;
+}
+constexpr uint32_t m0n0_fmt_parse_ll(const char* f, uint32_t pct) {
+    return ((m0n0_fmt_conv_pos(f, pct) - m0n0_fmt_l_pos(f, pct)) == 2) ||
+            (((m0n0_fmt_conv_pos(f, pct) - m0n0_fmt_l_pos(f, pct)) == 1) && 
+            (sizeof(long) == sizeof(long long)));
+}
+constexpr uint64_t m0n0_fmt_spec_at(
+        const char* f, uint32_t start, uint32_t pct) {
+    return m0n0_fmt_make_spec(start, pct - start, 
+            m0n0_fmt_parse_conv(f, pct), 
+            (f[pct] == '\0') ? 0 : m0n0_fmt_parse_flags(f, pct), 
+            (f[pct] == '\0') ? 0 : m0n0_fmt_parse_ll(f, pct), 
+            (f[pct] == '\0') ? 0 : 
+            m0n0_fmt_parse_width(f, m0n0_fmt_width_pos(f, pct), 0));
+}
+/** The spec of conversion n of the format string f (kFmtEnd after the 
+ * last conversion). f must be a string literal. 
+ */
+constexpr uint64_t m0n0_fmt_spec(const char* f, uint32_t n) {
+    return m0n0_fmt_spec_at(f, m0n0_fmt_lit_start(f, n),
+            m0n0_fmt_next_pct(f, m0n0_fmt_lit_start(f, n)));
+}
+
+/** The specs of a format string literal (the last one must be kFmtEnd) */
+#define M0N0_FMT_SPECS(fmt) \
+        m0n0_fmt_spec(fmt, 0), m0n0_fmt_spec(fmt, 1), \
+        m0n0_fmt_spec(fmt, 2), m0n0_fmt_spec(fmt, 3), \
+        m0n0_fmt_spec(fmt, 4), m0n0_fmt_spec(fmt, 5), \
+        m0n0_fmt_spec(fmt, 6), m0n0_fmt_spec(fmt, 7), \
+        m0n0_fmt_spec(fmt, 8)
+
+/** Whether all of the specs (up to the first kFmtEnd) are supported */
+template <uint64_t... Specs>
+struct M0N0_Fmt_Supported {
+    static const bool value = false; // no kFmtEnd
+};
+template <uint64_t S, uint64_t... Rest>
+struct M0N0_Fmt_Supported<S, Rest...> {
+    static const bool value = (m0n0_fmt_conv(S) == kFmtEnd) || 
+            ((m0n0_fmt_conv(S) != kFmtRuntime) && 
+            M0N0_Fmt_Supported<Rest...>::value);
+};
+
+/** Output of the emitters: characters are passed to the sink in batches
+ * (as m0n0_printf) 
+ */
+struct M0N0_Fmt_Out {
+    m0n0_sink_t* sink;
+    uint32_t len;
+    int count;
+    char buf[SINK_BATCH_LEN];
+
+    explicit M0N0_Fmt_Out(m0n0_sink_t* s) : sink(s), len(0), count(0) {}
+    void put(char c) {
+        if (this->len == SINK_BATCH_LEN) {
+            this->flush();
+        }
+        this->buf[this->len++] = c;
+        this->count++;
+    }
+    void put(const char* s, uint32_t n) {
+        while (n--) {
+            this->put(*s++);
+        }
+    }
+    void fill(char c, uint32_t n) {
+        while (n--) {
+            this->put(c);
+        }
+    }
+    void flush(void) {
+        if (this->len) {
+            this->sink->write(this->sink, this->buf, this->len);
+        }
+        this->len = 0;
+    }
+};
+
+// Emitters (the width and flags are constants, so the padding code is 
+// removed when not used)
+
+/** Outputs s padded to width (as prints in m0n0_printf.c) */
+inline void m0n0_fmt_put_field(M0N0_Fmt_Out& out, const char* s, 
+        uint32_t len, uint32_t width, uint32_t flags) {
+    const char pad = (flags & kFmtPadZero) ? '0' : ' ';
+    const uint32_t fill = (width > len) ? (width - len) : 0;
+    if (!(flags & kFmtPadRight)) {
+        out.fill(pad, fill);
+    }
+    out.put(s, len);
+    if (flags & kFmtPadRight) {
+        out.fill(pad, fill);
+    }
+}
+
+/** Writes the decimal digits of u backwards from end, returns the start */
+inline char* m0n0_fmt_dec_digits(char* end, uint32_t u) {
+    do {
+        *--end = '0' + (u % 10);
+        u /= 10;
+    } while (u);
+    return end;
+}
+inline char* m0n0_fmt_dec_digits(char* end, uint64_t u) {
+    // 9 digit chunks, as m0n0_printf
+    while (u >> 32) {
+        uint32_t chunk = (uint32_t)(u % 1000000000U);
+        u /= 1000000000U;
+        for (int i = 0; i < 9; i++) {
+            *--end = '0' + (chunk % 10);
+            chunk /= 10;
+        }
+    }
+    return m0n0_fmt_dec_digits(end, (uint32_t)u);
+}
+template <typename U>
+inline char* m0n0_fmt_hex_digits(char* end, U u, char letbase) {
+    do {
+        const uint32_t t = (uint32_t)(u & 0xF);
+        *--end = (t < 10) ? ('0' + t) : (letbase + t - 10);
+        u >>= 4;
+    } while (u);
+    return end;
+}
+
+template <typename U>
+inline void m0n0_fmt_put_dec(M0N0_Fmt_Out& out, U u, bool neg, 
+        uint32_t width, uint32_t flags) {
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* s = m0n0_fmt_dec_digits(end, u);
+    if (neg) {
+        if (width && (flags & kFmtPadZero)) {
+            out.put('-');
+            width--;
+        } else {
+            *--s = '-';
+        }
+    }
+    m0n0_fmt_put_field(out, s, end - s, width, flags);
+}
+
+template <typename U>
+inline void m0n0_fmt_put_hex(M0N0_Fmt_Out& out, U u, char letbase, 
+        uint32_t width, uint32_t flags) {
+    char buf[16];
+    char* end = buf + sizeof(buf);
+    char* s = m0n0_fmt_hex_digits(end, u, letbase);
+    m0n0_fmt_put_field(out, s, end - s, width, flags);
+}
+
+/** Integer arguments (pointers are printed as their address) */
+template <typename U, typename T>
+inline U m0n0_fmt_uint(T value) {
+    return (U)value;
+}
+template <typename U, typename T>
+inline U m0n0_fmt_uint(T* value) {
+    return (U)(uintptr_t)value;
+}
+
+/** Emits the argument of one conversion (specialised by conversion code 
+ * and size) 
+ */
+template <uint32_t Conv, uint32_t LL>
+struct M0N0_Fmt_Arg;
+template <uint32_t LL>
+struct M0N0_Fmt_Arg<kFmtDec, LL> {
+    typedef typename std::conditional<LL, uint64_t, uint32_t>::type U;
+    template <typename T>
+    static void put(M0N0_Fmt_Out& out, T arg, uint32_t w, uint32_t fl) {
+        const U u = m0n0_fmt_uint<U>(arg);
+        const bool neg = (u >> (sizeof(U)*8 - 1)) != 0;
+        m0n0_fmt_put_dec(out, neg ? (U)(0U - u) : u, neg, w, fl);
+    }
+};
+template <uint32_t LL>
+struct M0N0_Fmt_Arg<kFmtUnsigned, LL> {
+    typedef typename std::conditional<LL, uint64_t, uint32_t>::type U;
+    template <typename T>
+    static void put(M0N0_Fmt_Out& out, T arg, uint32_t w, uint32_t fl) {
+        m0n0_fmt_put_dec(out, m0n0_fmt_uint<U>(arg), false, w, fl);
+    }
+};
+template <uint32_t LL>
+struct M0N0_Fmt_Arg<kFmtHex, LL> {
+    typedef typename std::conditional<LL, uint64_t, uint32_t>::type U;
+    template <typename T>
+    static void put(M0N0_Fmt_Out& out, T arg, uint32_t w, uint32_t fl) {
+        m0n0_fmt_put_hex(out, m0n0_fmt_uint<U>(arg), 'a', w, fl);
+    }
+};
+template <uint32_t LL>
+struct M0N0_Fmt_Arg<kFmtHexUpper, LL> {
+    typedef typename std::conditional<LL, uint64_t, uint32_t>::type U;
+    template <typename T>
+    static void put(M0N0_Fmt_Out& out, T arg, uint32_t w, uint32_t fl) {
+        m0n0_fmt_put_hex(out, m0n0_fmt_uint<U>(arg), 'A', w, fl);
+    }
+};
+template <uint32_t LL>
+struct M0N0_Fmt_Arg<kFmtChar, LL> {
+    template <typename T>
+    static void put(M0N0_Fmt_Out& out, T arg, uint32_t w, uint32_t fl) {
+        const char c = (char)arg;
+        m0n0_fmt_put_field(out, &c, 1, w, fl);
+    }
+};
+template <uint32_t LL>
+struct M0N0_Fmt_Arg<kFmtString, LL> {
+    static void put(M0N0_Fmt_Out& out, const char* s, uint32_t w, 
+            uint32_t fl) {
+        if (!s) {
+            s = "(null)";
+        }
+        uint32_t len = 0;
+        while (s[len]) {
+            len++;
+        }
+        m0n0_fmt_put_field(out, s, len, w, fl);
+    }
+};
+
+/** Emits the literal text and conversion of each spec in turn */
+template <uint64_t... Specs>
+struct M0N0_Fmt_Emit {
+    template <typename... Args>
+    static void run(M0N0_Fmt_Out&, const char*, Args...) {
+        // only reached if not M0N0_Fmt_Supported
+    }
+};
+template <uint64_t S, uint64_t... Rest>
+struct M0N0_Fmt_Emit<S, Rest...> {
+    static const uint32_t conv = m0n0_fmt_conv(S);
+    static void lit(M0N0_Fmt_Out& out, const char* fmt) {
+        out.put(fmt + m0n0_fmt_start(S), m0n0_fmt_len(S));
+    }
+    // end of the format string
+    template <uint32_t C = conv, typename... Args>
+    static typename std::enable_if<C == kFmtEnd>::type 
+    run(M0N0_Fmt_Out& out, const char* fmt, Args...) {
+        static_assert(sizeof...(Args) == 0, 
+                "Too many arguments for the format string");
+        lit(out, fmt);
+    }
+    // "%%"
+    template <uint32_t C = conv, typename... Args>
+    static typename std::enable_if<C == kFmtPercent>::type 
+    run(M0N0_Fmt_Out& out, const char* fmt, Args... args) {
+        lit(out, fmt);
+        out.put('%');
+        M0N0_Fmt_Emit<Rest...>::run(out, fmt, args...);
+    }
+    // a conversion with an argument
+    template <uint32_t C = conv, typename... Args>
+    static typename std::enable_if<(C > kFmtPercent)>::type 
+    run(M0N0_Fmt_Out& out, const char* fmt, Args... args) {
+        static_assert(sizeof...(Args) > 0, 
+                "Too few arguments for the format string");
+        lit(out, fmt);
+        put_first(out, fmt, args...);
+    }
+    template <typename T, typename... Args>
+    static void put_first(M0N0_Fmt_Out& out, const char* fmt, 
+            T arg, Args... args) {
+        M0N0_Fmt_Arg<conv, m0n0_fmt_ll(S)>::put(
+                out, arg, m0n0_fmt_width(S), m0n0_fmt_flags(S));
+        M0N0_Fmt_Emit<Rest...>::run(out, fmt, args...);
+    }
+    static void put_first(M0N0_Fmt_Out&, const char*) {}
+    // not supported (handled by the caller)
+    template <uint32_t C = conv, typename... Args>
+    static typename std::enable_if<C == kFmtRuntime>::type 
+    run(M0N0_Fmt_Out&, const char*, Args...) {}
+};
+
+/** Formats to a sink (see M0N0_FMT_SINK_PRINTF) */
+template <uint64_t... Specs, typename... Args>
+inline int m0n0_fmt_printf(m0n0_sink_t* sink, const char* fmt, 
+        Args... args) {
+    if (!M0N0_Fmt_Supported<Specs...>::value) {
+        return m0n0_sink_printf(sink, fmt, args...);
+    }
+    M0N0_Fmt_Out out(sink);
+    M0N0_Fmt_Emit<Specs...>::run(out, fmt, args...);
+    out.flush();
+    return out.count;
+}
+
+/** Formats prefix, the message and a newline to a sink as one output (see
+ * M0N0_System::log_*) 
+ */
+template <uint64_t... Specs, typename... Args>
+inline int m0n0_fmt_print_line(m0n0_sink_t* sink, const char* prefix, 
+        const char* fmt, Args... args) {
+    if (!M0N0_Fmt_Supported<Specs...>::value) {
+        int r = m0n0_sink_printf(sink, "%s", prefix);
+        r += m0n0_sink_printf(sink, fmt, args...);
+        return r + m0n0_sink_printf(sink, "\n");
+    }
+    M0N0_Fmt_Out out(sink);
+    while (*prefix) {
+        out.put(*prefix++);
+    }
+    M0N0_Fmt_Emit<Specs...>::run(out, fmt, args...);
+    out.put('\n');
+    out.flush();
+    return out.count;
+}
+
+/** printf to a sink with the format string (which must be a string 
+ * literal) parsed at compile time, e.g. 
+ * M0N0_FMT_SINK_PRINTF(&m0n0_stdout_sink, "val: %d\n", val) 
+ */
+#define M0N0_FMT_SINK_PRINTF(sink, fmt, ...) \
+        m0n0_fmt_printf<M0N0_FMT_SPECS(fmt)>(sink, fmt, ##__VA_ARGS__)
+
+#endif // M0N0_FMT_H
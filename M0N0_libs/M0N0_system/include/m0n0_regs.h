@@ -0,0 +1,219 @@
+
+/*
+ * Copyright (c) 2020, Arm Limited
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+#ifndef M0N0_REGS_H
+#define M0N0_REGS_H
+#include <cstdint>
+
+extern "C" {
+    #include "m0n0_defs.h"
+}
+
+/**
+@file
+@brief Compile-time register and bit-group descriptors
+
+The Reg and BitField templates resolve the address, mask, shift and access 
+permission of a register (or bit-group) at compile time, so that each access
+compiles to a single volatile load or store (plus the masking/shifting 
+instructions). They take the auto-generated register definitions in 
+m0n0_defs.h directly, e.g.:
+
+    uint32_t perf = BitField<STATUS_STATUS_7_REG, STATUS_R07_PERF_BIT_MASK, R>::read();
+
+The RegClass functions (and M0N0_read_bit_group/M0N0_write_bit_group) remain
+available for run-time addresses and masks. 
+*/
+
+/** Calculates the bit-shift distance from a mask at compile time
+ *
+ * Compile-time equivalent of mask_to_shift (defined in m0n0_defs.c).
+ *
+ * @param mask The bit-mask
+ * @return The shift amount for the mask (0 for a zero mask)
+ */
+constexpr uint32_t m0n0_mask_shift(uint32_t mask) {
+    return ((mask == 0) || (mask & 0x1)) ? 0 : 1 + m0n0_mask_shift(mask >> 1);
+}
+
+/**
+ * Compile-time descriptor of a whole register
+ *
+ * @tparam Addr The absolute (memory map) address of the register
+ * @tparam Access Whether the register is read-only (R), write-only (W) or
+ *     read/write (RW). Reading a write-only register (or writing a read-only
+ *     register) is a compile-time error.
+ */
+template <uint32_t Addr, MEM_RD_WR_t Access = RW>
+class Reg {
+    public:
+        /** The absolute address of the register
+         */
+        static const uint32_t kAddress = Addr;
+        /** Reads the whole register (single volatile load)
+         *
+         * @return The register value
+         */
+        __STATIC_FORCEINLINE uint32_t read(void) {
+            static_assert(Access != W, "Cannot read a write-only register");
+            return M0N0_read_direct(Addr);
+        }
+        /** Writes the whole register (single volatile store)
+         *
+         * @param data The value to write
+         */
+        __STATIC_FORCEINLINE void write(uint32_t data) {
+            static_assert(Access != R, "Cannot write a read-only register");
+            M0N0_write_direct(Addr, data);
+        }
+        /** Sets the bits in the mask (to 1). A single store to the set alias
+         * address if the register supports it (see M0N0_HAS_SET_CLR_ALIAS),
+         * otherwise a read-modify-write. 
+         *
+         * @param mask The bits to set
+         */
+        __STATIC_FORCEINLINE void set_bits(uint32_t mask) {
+            static_assert(Access == RW, "Register must be read/write");
+            if (M0N0_HAS_SET_CLR_ALIAS(Addr)) {
+                M0N0_write_direct(Addr + CONTROL_SET_OFFSET, mask);
+            } else {
+                M0N0_write_direct(Addr, M0N0_read_direct(Addr) | mask);
+            }
+        }
+        /** Clears the bits in the mask (to 0). A single store to the clear 
+         * alias address if the register supports it, otherwise a 
+         * read-modify-write. 
+         *
+         * @param mask The bits to clear
+         */
+        __STATIC_FORCEINLINE void clear_bits(uint32_t mask) {
+            static_assert(Access == RW, "Register must be read/write");
+            if (M0N0_HAS_SET_CLR_ALIAS(Addr)) {
+                M0N0_write_direct(Addr + CONTROL_CLR_OFFSET, mask);
+            } else {
+                M0N0_write_direct(Addr, M0N0_read_direct(Addr) & ~mask);
+            }
+        }
+};
+
+/**
+ * Compile-time descriptor of a register bit-group
+ *
+ * @tparam Addr The absolute (memory map) address of the register
+ * @tparam Mask The bit-group mask (e.g. one of the auto-generated _BIT_MASK
+ *     definitions in m0n0_defs.h)
+ * @tparam Access Whether the register is read-only (R), write-only (W) or
+ *     read/write (RW). 
+ */
+template <uint32_t Addr, uint32_t Mask, MEM_RD_WR_t Access = RW>
+class BitField {
+    static_assert(Mask != 0, "Bit-group mask cannot be zero");
+    public:
+        /** The absolute address of the register
+         */
+        static const uint32_t kAddress = Addr;
+        /** The bit-group mask
+         */
+        static const uint32_t kMask = Mask;
+        /** The bit-group shift distance (calculated at compile time)
+         */
+        static const uint32_t kShift = m0n0_mask_shift(Mask);
+        /** Whether the bit-group is a single bit
+         */
+        static const bool kSingleBit = ((Mask & (Mask - 1)) == 0);
+        /** Extracts the bit-group from a (previously read) register value
+         *
+         * @param reg_val The full register value
+         * @return The bit-group value
+         */
+        static constexpr uint32_t extract(uint32_t reg_val) {
+            return (reg_val & Mask) >> kShift;
+        }
+        /** Inserts a bit-group value into a register value
+         *
+         * @param reg_val The full register value
+         * @param data The value of the bit-group
+         * @return The register value with the bit-group replaced
+         */
+        static constexpr uint32_t insert(uint32_t reg_val, uint32_t data) {
+            return (reg_val & ~Mask) | ((data << kShift) & Mask);
+        }
+        /** Reads the bit-group (single volatile load)
+         *
+         * @return The bit-group value
+         */
+        __STATIC_FORCEINLINE uint32_t read(void) {
+            static_assert(Access != W, "Cannot read a write-only register");
+            return extract(M0N0_read_direct(Addr));
+        }
+        /** Writes the bit-group
+         *
+         * A read-modify-write (one load and one store) unless the mask
+         * covers the whole register, or is a single bit of a register 
+         * with set/clear aliases (see M0N0_HAS_SET_CLR_ALIAS), in which 
+         * case it is a single store. 
+         *
+         * @param data The value to write into the bit-group
+         */
+        __STATIC_FORCEINLINE void write(uint32_t data) {
+            static_assert(Access != R, "Cannot write a read-only register");
+            if (Mask == 0xFFFFFFFF) {
+                M0N0_write_direct(Addr, data);
+            } else if (kSingleBit && M0N0_HAS_SET_CLR_ALIAS(Addr)) {
+                // single store to the set/clear alias
+                if (data & 0x1) {
+                    M0N0_write_direct(Addr + CONTROL_SET_OFFSET, Mask);
+                } else {
+                    M0N0_write_direct(Addr + CONTROL_CLR_OFFSET, Mask);
+                }
+            } else {
+                M0N0_write_direct(Addr, insert(M0N0_read_direct(Addr), data));
+            }
+        }
+};
+
+// Descriptors for the frequently accessed (read-only) status bit-groups
+/** RTC most significant bits */
+typedef BitField<STATUS_STATUS_4_REG, STATUS_R04_RTC_MSBS_BIT_MASK, R>
+        StatusRtcMsbs;
+/** RTC least significant bits */
+typedef BitField<STATUS_STATUS_2_REG, STATUS_R02_RTC_LSBS_BIT_MASK, R>
+        StatusRtcLsbs;
+/** Current (raw) performance level */
+typedef BitField<STATUS_STATUS_7_REG, STATUS_R07_PERF_BIT_MASK, R>
+        StatusPerf;
+/** Device-enable (DEVE) flag */
+typedef BitField<STATUS_STATUS_7_REG, STATUS_R07_DEVE_CORE_BIT_MASK, R>
+        StatusDeve;
+/** RTC real-time flag */
+typedef BitField<STATUS_STATUS_7_REG, STATUS_R07_REAL_TIME_FLAG_BIT_MASK, R>
+        StatusRealTime;
+/** External wake-up flag */
+typedef BitField<STATUS_STATUS_7_REG, STATUS_R07_EXT_WAKE_BIT_MASK, R>
+        StatusExtWake;
+
+#endif // M0N0_REGS_H
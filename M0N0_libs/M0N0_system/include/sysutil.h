@@ -40,8 +40,6 @@ extern "C" {
 @brief Defines components of the M0N0_System and system utilities
 */
 
-typedef uint32_t (*Read_Driver_Func)(uint32_t);
-typedef void (*Write_Driver_Func)(uint32_t, uint32_t);
 typedef uint32_t (*Read_BG_Driver_Func)(uint32_t, uint32_t);
 typedef void (*Write_BG_Driver_Func)(uint32_t, uint32_t, uint32_t);
 typedef void (*Log_Func)(const char*);
@@ -57,8 +55,8 @@ static const MEM_RD_WR_t REG_MEM_READ_WRITE = RW;
  * to system registers and memories. Read and write "drivers" are passed as
  * function pointers. Performs extra checking (i.e. whether provided address
  * is in the register/memory address range) if EXTRA_CHECKS is defined. 
- * It also forms the base class for other classes, such as AESClass and 
- * SPIClass. 
+ * The peripheral classes (AESClass, SPIClass and GPIOClass) instead derive 
+ * from DriverRegClass, which selects the driver at compile time. 
  */
 class RegClass {
     private:
@@ -194,12 +192,619 @@ class RegClass {
                 uint32_t address,
                 uint32_t mask,
                 uint32_t data);
+        /**
+         * Sets the bits in the mask (to 1)
+         *
+         * Uses a single store to the set alias address if the register
+         * supports it (see M0N0_HAS_SET_CLR_ALIAS), otherwise a 
+         * read-modify-write. 
+         *
+         * @param address The register or memory address. Whether this is the
+         *     the absolute address or an offset depends on the value of 
+         *     add_offset passed to the constructor.  
+         * @param mask The bits to set
+         */
+        void set_bits(uint32_t address, uint32_t mask);
+        /**
+         * Clears the bits in the mask (to 0)
+         *
+         * Uses a single store to the clear alias address if the register
+         * supports it (see M0N0_HAS_SET_CLR_ALIAS), otherwise a 
+         * read-modify-write. 
+         *
+         * @param address The register or memory address. Whether this is the
+         *     the absolute address or an offset depends on the value of 
+         *     add_offset passed to the constructor.  
+         * @param mask The bits to clear
+         */
+        void clear_bits(uint32_t address, uint32_t mask);
+        Log_Func _debug_f;
+        Log_Func _error_f;
+};
+
+/**
+ * Register access driver for the M0N0 memory map
+ *
+ * Accesses the memory map directly with volatile loads and stores (see
+ * M0N0_read_direct and M0N0_write_direct in m0n0_defs.h), so that the 
+ * accesses are inlined into the caller. Used by DriverRegClass in the 
+ * production build. 
+ */
+struct M0N0_Bus_Driver {
+    /** Reads a word from the memory map
+     *
+     * @param address The absolute address
+     * @return The word read
+     */
+    __STATIC_FORCEINLINE uint32_t read(uint32_t address) {
+        return M0N0_read_direct(address);
+    }
+    /** Writes a word to the memory map
+     *
+     * @param address The absolute address
+     * @param data The word to write
+     */
+    __STATIC_FORCEINLINE void write(uint32_t address, uint32_t data) {
+        M0N0_write_direct(address, data);
+    }
+};
+
+/**
+ * Register access driver that calls through (replaceable) function pointers
+ *
+ * Equivalent to the RegClass drivers: the function pointers default to 
+ * M0N0_read and M0N0_write but can be replaced at run-time (e.g. with mock
+ * or recording drivers for host builds). Select it for the peripheral 
+ * classes by defining M0N0_PERIPH_DRIVER=Pluggable_Bus_Driver. 
+ */
+struct Pluggable_Bus_Driver {
+    /** The function used to read a word (defaults to M0N0_read)
+     */
+    static Read_Driver_Func read_f;
+    /** The function used to write a word (defaults to M0N0_write)
+     */
+    static Write_Driver_Func write_f;
+    /** Reads a word using read_f
+     *
+     * @param address The absolute address
+     * @return The word read
+     */
+    static inline uint32_t read(uint32_t address) {
+        return read_f(address);
+    }
+    /** Writes a word using write_f
+     *
+     * @param address The absolute address
+     * @param data The word to write
+     */
+    static inline void write(uint32_t address, uint32_t data) {
+        write_f(address, data);
+    }
+};
+
+#ifdef M0N0_REG_TRACE
+#ifndef M0N0_REG_TRACE_DEPTH
+/** The number of register accesses held by the trace ring buffer (each 
+ * entry is 12 bytes of RAM)
+ */
+#define M0N0_REG_TRACE_DEPTH 128
+#endif
+
+/** A register access recorded by M0N0_Reg_Trace
+ */
+typedef struct {
+    /** The RTC tick (LSBs) of the access
+     */
+    uint32_t rtc;
+    /** The register address, with bit 0 set for a write (registers are 
+     * word aligned)
+     */
+    uint32_t address;
+    /** The value read or written
+     */
+    uint32_t value;
+} M0N0_Reg_Trace_Entry;
+
+/**
+ * Register access trace recorder (M0N0_REG_TRACE)
+ *
+ * Records the register accesses made through the tracing drivers 
+ * (M0N0_Trace_Bus_Driver and the M0N0_trace_* RegClass drivers) into a 
+ * fixed RAM ring buffer, overwriting the oldest entries when full. With 
+ * M0N0_REG_TRACE defined, the M0N0_System registers, SHRAM and the 
+ * peripheral classes use the tracing drivers, so the bus traffic of an API 
+ * call can be inspected (e.g. with the REG_TRACE_TC testcase and 
+ * adpdev/silicon_libs/reg_trace.py). The accesses made by the C functions
+ * in m0n0_defs.c (e.g. STDOUT) are not recorded. Recording is enabled at
+ * start-up. 
+ */
+class M0N0_Reg_Trace {
+    public:
+        /** Flag set in M0N0_Reg_Trace_Entry::address for a write
+         */
+        static const uint32_t kWriteFlag = 0x1;
+        /** Records an access (if recording is enabled)
+         *
+         * @param address The absolute address
+         * @param value The value read or written
+         * @param is_write True for a write, false for a read
+         */
+        static inline void record(
+                uint32_t address, 
+                uint32_t value, 
+                bool is_write) {
+            if (!_enabled) {
+                return;
+            }
+            // (masked: accesses from interrupt handlers are also recorded)
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            M0N0_Reg_Trace_Entry* entry = 
+                    &_entries[_total % M0N0_REG_TRACE_DEPTH];
+            // read directly (not traced)
+            entry->rtc = M0N0_read_direct(STATUS_STATUS_2_REG);
+            entry->address = is_write ? (address | kWriteFlag) : address;
+            entry->value = value;
+            _total++;
+            __set_PRIMASK(primask);
+        }
+        /** Starts (or resumes) recording
+         */
+        static void start(void);
+        /** Stops recording (the recorded entries are kept)
+         */
+        static void stop(void);
+        /** Removes all recorded entries
+         */
+        static void clear(void);
+        /** Returns the number of entries held in the ring buffer
+         *
+         * @return The number of entries (at most M0N0_REG_TRACE_DEPTH)
+         */
+        static uint32_t get_count(void);
+        /** Returns the number of accesses recorded since the last clear
+         *     (including those overwritten)
+         *
+         * @return The total number of accesses recorded
+         */
+        static uint32_t get_total(void);
+        /** Returns an entry from the ring buffer
+         *
+         * @param index The index of the entry, where 0 is the oldest held
+         * @return A pointer to the entry (NULL if index >= get_count())
+         */
+        static const M0N0_Reg_Trace_Entry* get_entry(uint32_t index);
+        /** Sends the entries (oldest first) as the payload of an ADP 
+         *     transaction, one "rtc address value" line per entry
+         */
+        static void send_via_adp(void);
+    private:
+        static M0N0_Reg_Trace_Entry _entries[M0N0_REG_TRACE_DEPTH];
+        static uint32_t _total;
+        static bool _enabled;
+};
+
+/**
+ * Register access driver that records each access in M0N0_Reg_Trace
+ *
+ * As M0N0_Bus_Driver, but each access is also recorded. Used by the 
+ * peripheral classes when M0N0_REG_TRACE is defined. 
+ */
+struct M0N0_Trace_Bus_Driver {
+    /** Reads a word from the memory map and records the access
+     *
+     * @param address The absolute address
+     * @return The word read
+     */
+    static inline uint32_t read(uint32_t address) {
+        uint32_t data = M0N0_read_direct(address);
+        M0N0_Reg_Trace::record(address, data, false);
+        return data;
+    }
+    /** Writes a word to the memory map and records the access
+     *
+     * @param address The absolute address
+     * @param data The word to write
+     */
+    static inline void write(uint32_t address, uint32_t data) {
+        M0N0_write_direct(address, data);
+        M0N0_Reg_Trace::record(address, data, true);
+    }
+};
+
+/** Tracing RegClass read driver (as M0N0_read)
+ */
+uint32_t M0N0_trace_read(uint32_t address);
+/** Tracing RegClass write driver (as M0N0_write)
+ */
+void M0N0_trace_write(uint32_t address, uint32_t data);
+/** Tracing RegClass bit group read driver (as M0N0_read_bit_group)
+ */
+uint32_t M0N0_trace_read_bit_group(uint32_t address, uint32_t mask);
+/** Tracing RegClass bit group write driver (as M0N0_write_bit_group)
+ *
+ * Recorded as a single write of the shifted bit-group (the read-modify-write
+ * or set/clear alias access of M0N0_write_mask_and_shift is not recorded)
+ */
+void M0N0_trace_write_bit_group(
+        uint32_t address, 
+        uint32_t mask, 
+        uint32_t data);
+#endif
+
+#ifdef M0N0_PROFILE
+/**
+ * Profiles the enclosing scope as a named region (see M0N0_PROFILE_BEGIN in
+ * m0n0_defs.h). Use with the M0N0_PROFILE_SCOPE macro:
+ *
+ *     void run_nn() {
+ *         M0N0_PROFILE_SCOPE(run_nn);
+ *         ...
+ *     }
+ */
+class M0N0_Profile_Scope {
+    public:
+        /** Starts the region
+         *
+         * @param slot The table index of the region (set on the first call)
+         * @param name The name of the region
+         */
+        M0N0_Profile_Scope(uint32_t* slot, const char* name) {
+            M0N0_profile_begin(&this->_mark, slot, name);
+        }
+        /** Ends the region
+         */
+        ~M0N0_Profile_Scope() {
+            M0N0_profile_end(&this->_mark);
+        }
+    private:
+        M0N0_Profile_Mark _mark;
+};
+
+#define M0N0_PROFILE_SCOPE(name) \
+    static uint32_t m0n0_profile_slot_##name = M0N0_PROFILE_UNREGISTERED; \
+    M0N0_Profile_Scope m0n0_profile_scope_##name( \
+            &m0n0_profile_slot_##name, #name)
+#else
+#define M0N0_PROFILE_SCOPE(name)
+#endif
+
+#ifndef M0N0_PERIPH_DRIVER
+/** The register access driver used by the peripheral classes (AESClass,
+ * SPIClass and GPIOClass). Override (e.g. -DM0N0_PERIPH_DRIVER=
+ * Pluggable_Bus_Driver) to use mock or recording drivers. Defaults to
+ * M0N0_Trace_Bus_Driver with M0N0_REG_TRACE. 
+ */
+#ifdef M0N0_REG_TRACE
+#define M0N0_PERIPH_DRIVER M0N0_Trace_Bus_Driver
+#else
+#define M0N0_PERIPH_DRIVER M0N0_Bus_Driver
+#endif
+#endif
+
+/** Returns the shift of a bit-group mask (the position of its lowest set
+ * bit), or 0 for an empty mask (for which __builtin_ctz is undefined)
+ *
+ * @param mask The bit-group mask
+ * @return The shift
+ */
+static inline uint32_t M0N0_mask_shift(uint32_t mask) {
+    return (mask != 0) ? (uint32_t)__builtin_ctz(mask) : 0;
+}
+
+/**
+ * Register access class with a compile-time driver
+ *
+ * Provides the same read/write interface as RegClass, but the driver is 
+ * a template parameter (a class with static read and write functions, 
+ * e.g. M0N0_Bus_Driver) rather than function pointers, and there are no 
+ * virtual functions. With M0N0_Bus_Driver, each access compiles to an 
+ * inlined volatile load/store (the mask/shift is calculated inline). 
+ * Addresses are always absolute (i.e. add_offset is always false). 
+ * Performs address range checks if EXTRA_CHECKS is defined. 
+ *
+ * @tparam Driver The register access driver
+ */
+template <class Driver>
+class DriverRegClass {
+    private:
+        /** The base address of the register
+         */
+        uint32_t _base;
+        /** The size of the register (in bytes)
+         */
+        uint32_t _size;
+        /** Whether the register is read only, write only or read/write
+         */
+        MEM_RD_WR_t _read_write;
+        /**
+         * A function for checking the passed address is in the valid address
+         * range.
+         */
+        inline void _addr_check(uint32_t address) {
+            if (address < this->_base || address > (this->_base + this->_size)) {
+                this->_error_f("Address is out of register range");
+            }
+        }
+    public:
+        /** 
+         * Constructor for DriverRegClass
+         *
+         * @param base_address Base address of the register in the memory map
+         * @param size The size of the register (in bytes)
+         * @param read_or_write Specify whether the register is read-only, 
+         *     write-only, or read-and-write, using the MEM_RD_WR_t enum. 
+         * @param error_function A pointer to a function for logging an 
+         *     logging an error message and halting execution
+         * @param debug_function A pointer to a function for displaying debug
+         *     text output
+         */
+        DriverRegClass(
+                uint32_t base_address,
+                uint32_t size,
+                MEM_RD_WR_t read_or_write,
+                Log_Func error_function,
+                Log_Func debug_function
+        ) : 
+                _base(base_address),
+                _size(size),
+                _read_write(read_or_write),
+                _debug_f(debug_function),
+                _error_f(error_function) {}
+        /**
+         * A function for reading a whole register
+         *
+         * @param address The absolute register address
+         * @return the data read from the specified location. 
+         */
+        inline uint32_t read(uint32_t address) {
+#ifdef EXTRA_CHECKS
+            if (this->_read_write == W) {
+                this->_error_f("Cannot read - is this register write only?");
+            }
+            this->_addr_check(address);
+#endif
+            return Driver::read(address);
+        }
+        /**
+         * A function for reading a bit group of a register
+         *
+         * @param address The absolute register address
+         * @param mask The bit-group mask to read from. 
+         * @return the data read from the specified bit group of the location.
+         */
+        inline uint32_t read(uint32_t address, uint32_t mask) {
+#ifdef EXTRA_CHECKS
+            if (mask == 0) {
+                this->_error_f("Empty bit-group mask");
+            }
+#endif
+            return (this->read(address) & mask) >> M0N0_mask_shift(mask);
+        }
+        /**
+         * A function for writing a whole register
+         *
+         * @param address The absolute register address
+         * @param data The data to be written to the address
+         */
+        inline void write(uint32_t address, uint32_t data) {
+#ifdef EXTRA_CHECKS
+            if (this->_read_write == R) {
+                this->_error_f("Cannot write - is this register read only?");
+            }
+            this->_addr_check(address);
+#endif
+            Driver::write(address, data);
+        }
+        /**
+         * A function for writing a bit-group of a register (read-modify-write)
+         * 
+         * Masking and shifting is applied automatically. 
+         *
+         * @param address The absolute register address
+         * @param mask The bit-group mask
+         * @param data The data to be written to the address
+         */
+        inline void write(uint32_t address, uint32_t mask, uint32_t data) {
+#ifdef EXTRA_CHECKS
+            if (mask == 0) {
+                this->_error_f("Empty bit-group mask");
+            }
+#endif
+            uint32_t reg = this->read(address) & ~mask;
+            this->write(address, 
+                    reg | ((data << M0N0_mask_shift(mask)) & mask));
+        }
+        /**
+         * Sets the bits in the mask (to 1), using the set alias address if 
+         * the register supports it (see M0N0_HAS_SET_CLR_ALIAS)
+         *
+         * @param address The absolute register address
+         * @param mask The bits to set
+         */
+        inline void set_bits(uint32_t address, uint32_t mask) {
+            if (M0N0_HAS_SET_CLR_ALIAS(address)) {
+#ifdef EXTRA_CHECKS
+                this->_addr_check(address);
+#endif
+                Driver::write(address + CONTROL_SET_OFFSET, mask);
+            } else {
+                this->write(address, this->read(address) | mask);
+            }
+        }
+        /**
+         * Clears the bits in the mask (to 0), using the clear alias address
+         * if the register supports it (see M0N0_HAS_SET_CLR_ALIAS)
+         *
+         * @param address The absolute register address
+         * @param mask The bits to clear
+         */
+        inline void clear_bits(uint32_t address, uint32_t mask) {
+            if (M0N0_HAS_SET_CLR_ALIAS(address)) {
+#ifdef EXTRA_CHECKS
+                this->_addr_check(address);
+#endif
+                Driver::write(address + CONTROL_CLR_OFFSET, mask);
+            } else {
+                this->write(address, this->read(address) & ~mask);
+            }
+        }
         Log_Func _debug_f;
         Log_Func _error_f;
 };
 
-class SPIClass : public RegClass {
-    using RegClass::RegClass;
+/** The register class used by the peripheral classes
+ */
+typedef DriverRegClass<M0N0_PERIPH_DRIVER> PeriphRegClass;
+
+#ifdef M0N0_SHADOW_REGS
+/**
+ * Shadow (cached) copy of a software-owned register
+ *
+ * Keeps the last value read from or written to a register that only
+ * software modifies (e.g. configuration registers), so that reads do not
+ * access the bus and several bit-group updates (set) are merged into a
+ * single store (flush). Only enabled if M0N0_SHADOW_REGS is defined.
+ *
+ * The cache must be invalidated (invalidate) if the register is modified 
+ * other than through this object (e.g. after a reset).  
+ *
+ * Instrumentation counts the number of bus accesses that would have been
+ * made without the shadow (each bit-group update being a read-modify-write)
+ * and the number actually made, see get_accesses_saved. 
+ *
+ * @tparam Driver The register access driver (e.g. M0N0_Bus_Driver)
+ */
+template <class Driver>
+class ShadowReg {
+    private:
+        /** The absolute address of the register
+         */
+        uint32_t _address;
+        /** The cached register value
+         */
+        uint32_t _value;
+        /** Whether _value holds the current register value
+         */
+        bool _valid;
+        /** Whether _value has updates that are not yet written (flushed)
+         */
+        bool _dirty;
+        /** Number of bus accesses that would be made without the shadow
+         */
+        uint32_t _nominal_accesses;
+        /** Number of bus accesses made
+         */
+        uint32_t _actual_accesses;
+        /** Reads the register into the cache if not valid
+         */
+        inline void _load(void) {
+            if (!this->_valid) {
+                this->_value = Driver::read(this->_address);
+                this->_valid = true;
+                this->_actual_accesses++;
+            }
+        }
+    public:
+        /** Constructor for ShadowReg (the cache is initially invalid)
+         *
+         * @param address The absolute address of the register
+         */
+        ShadowReg(uint32_t address) : 
+                _address(address),
+                _value(0),
+                _valid(false),
+                _dirty(false),
+                _nominal_accesses(0),
+                _actual_accesses(0) {}
+        /** Reads the register (from the cache if valid)
+         *
+         * @return The register value (including any updates not yet flushed)
+         */
+        inline uint32_t read(void) {
+            this->_nominal_accesses++;
+            this->_load();
+            return this->_value;
+        }
+        /** Reads a bit-group of the register (from the cache if valid)
+         *
+         * @param mask The bit-group mask
+         * @return The bit-group value
+         */
+        inline uint32_t read(uint32_t mask) {
+            return (this->read() & mask) >> M0N0_mask_shift(mask);
+        }
+        /** Updates a bit-group in the cache (not written until flush)
+         *
+         * @param mask The bit-group mask
+         * @param data The value of the bit-group
+         */
+        inline void set(uint32_t mask, uint32_t data) {
+            this->_nominal_accesses += 2; // read-modify-write
+            this->_load();
+            this->_value = (this->_value & ~mask) | 
+                    ((data << M0N0_mask_shift(mask)) & mask);
+            this->_dirty = true;
+        }
+        /** Writes any pending updates to the register (in a single store)
+         */
+        inline void flush(void) {
+            if (this->_dirty) {
+                Driver::write(this->_address, this->_value);
+                this->_actual_accesses++;
+                this->_dirty = false;
+            }
+        }
+        /** Updates a bit-group and writes the register (write-through)
+         *
+         * @param mask The bit-group mask
+         * @param data The value of the bit-group
+         */
+        inline void write(uint32_t mask, uint32_t data) {
+            this->set(mask, data);
+            this->flush();
+        }
+        /** Writes the whole register (write-through)
+         *
+         * @param data The register value
+         */
+        inline void write(uint32_t data) {
+            this->_nominal_accesses++;
+            this->_value = data;
+            this->_valid = true;
+            this->_dirty = true;
+            this->flush();
+        }
+        /** Discards the cached value (and any updates not yet flushed), the
+         * next access reads the register
+         */
+        inline void invalidate(void) {
+            this->_valid = false;
+            this->_dirty = false;
+        }
+        /** Returns the number of bus accesses saved by the shadow
+         *
+         * @return The accesses that would have been made without the shadow,
+         *     minus the accesses made, since the last reset_counters
+         */
+        inline uint32_t get_accesses_saved(void) {
+            return this->_nominal_accesses - this->_actual_accesses;
+        }
+        /** Resets the access counters
+         */
+        inline void reset_counters(void) {
+            this->_nominal_accesses = 0;
+            this->_actual_accesses = 0;
+        }
+};
+
+/** The shadow register class used by the peripheral classes
+ */
+typedef ShadowReg<M0N0_PERIPH_DRIVER> PeriphShadowReg;
+#endif // M0N0_SHADOW_REGS
+
+class SPIClass : public PeriphRegClass {
+    using PeriphRegClass::PeriphRegClass;
     private:
         /** PCSM slave select
          */
@@ -207,6 +812,12 @@ class SPIClass : public RegClass {
         /** Software flag to remember whether auto-sampling enabled
          */
         bool _is_autosampling = false;
+#ifdef M0N0_SHADOW_REGS
+        /** Shadow of the SPI control register (mode and slave select). All
+         * accesses to SPI_CONTROL_REG go through it. 
+         */
+        PeriphShadowReg _ctrl_shadow = PeriphShadowReg(SPI_CONTROL_REG);
+#endif
     public:
         /**
          * Sets the SPI clock divider (divides the TCRO frequency). 
@@ -254,6 +865,18 @@ class SPIClass : public RegClass {
          *
          */
         uint8_t write_byte(uint8_t data);
+        /** Starts sending a byte to the currently selected slave (does not
+         * wait: see is_busy and get_read_byte)
+         *
+         * @param data The byte to send over SPI
+         */
+        void start_byte(uint8_t data);
+        /** Returns whether an SPI transfer is in progress
+         */
+        bool is_busy();
+        /** Returns the byte received by the last transfer (once not busy)
+         */
+        uint8_t get_read_byte();
         /**
          * Writes data to a specified PCSM register via SPI
          *
@@ -262,15 +885,25 @@ class SPIClass : public RegClass {
          *     (only the 24 LSBs are written)
          */
         void pcsm_write(uint8_t address, uint32_t data);
+#ifdef M0N0_SHADOW_REGS
+        /** Reads the SPI registers, see the DriverRegClass read functions
+         * (SPI_CONTROL_REG is read from the shadow)
+         */
+        uint32_t read(uint32_t address);
+        /** Reads the SPI registers, see the DriverRegClass read functions
+         * (SPI_CONTROL_REG is read from the shadow)
+         */
+        uint32_t read(uint32_t address, uint32_t mask);
+#endif
         /** Writes to the VREG SPI registers, see the M0N0Reg write functions
          */
-        void write(uint32_t address, uint32_t data) override;
+        void write(uint32_t address, uint32_t data);
         /** Writes to the VREG SPI registers, see the M0N0Reg write functions
          */
         void write(
                 uint32_t address,
                 uint32_t mask,
-                uint32_t data) override;
+                uint32_t data);
         /**
          * Is autosampling feature enabled
          *
@@ -287,60 +920,41 @@ class SPIClass : public RegClass {
          *
          */
         void disable_autosampling(void);
-        
+#ifdef M0N0_SHADOW_REGS
+        /**
+         * Returns the shadow of the SPI control register (e.g. for reading 
+         * the saved access counters, or to invalidate it)
+         *
+         * @return pointer to the control register shadow
+         */
+        PeriphShadowReg* get_ctrl_shadow(void);
+#endif
 };
 
-class GPIOClass : public RegClass {
+class GPIOClass : public PeriphRegClass {
     public:
         /** 
-         * Constructor for GPIOClass (calls RegClass constructor)
+         * Constructor for GPIOClass (calls DriverRegClass constructor)
          *
-         * @param base_address Base address of the register/memory in the 
-         *     memory map
-         * @param add_offset whether the addresses passed to the read/write 
-         *     functions is the absolute address (add_offset=False) or 
-         *     whether it needs to be added to the base_address 
-         *     (add_offset=True). Typically, for a register
-         *     this value is False (and the absolute address passed) and 
-         *     for memories it is True. 
-         * @param size The size of the register or memory (in bytes)
-         * @param read_or_write Specify whether the register or memory is
-         *     read-only write-only, or read-and-write, using the 
-         *     MEM_RD_WR_t enum. 
-         * @param read_driver A pointer to a function for reading a whole 
-         *     register 
-         *     or memory location. 
-         * @param write_driver A pointer to a function for writing a whole
-         *     register or memory location.
-         * @param read_bg_driver A pointer to a function for reading from a
-         *     specific bit-group (or "bit range") of a register using a 
-         *     supplied mask. 
-         * @param write_bg_driver A pointer to a function for writing to a 
-         *     specific bit-group of a register using a specified mask.  
+         * @param base_address Base address of the register in the memory map
+         * @param size The size of the register (in bytes)
+         * @param read_or_write Specify whether the register is read-only, 
+         *     write-only, or read-and-write, using the MEM_RD_WR_t enum. 
          * @param error_function A pointer to a function for logging an 
          *     logging an error message and halting execution
-         * @param debug_function A pointer to a function for displaying debug text output
+         * @param debug_function A pointer to a function for displaying debug
+         *     text output
          */
         GPIOClass(
                 uint32_t base_address,
-                bool add_offset,
                 uint32_t size,
                 MEM_RD_WR_t read_or_write,
-                Read_Driver_Func read_driver,
-                Write_Driver_Func write_driver,
-                Read_BG_Driver_Func read_bg_driver,
-                Write_BG_Driver_Func write_bg_driver,
                 Log_Func error_function,
                 Log_Func debug_function
-            ): RegClass(
+            ): PeriphRegClass(
                     base_address,
-                    add_offset,
                     size,
                     read_or_write,
-                    read_driver,
-                    write_driver,
-                    read_bg_driver,
-                    write_bg_driver,
                     error_function,
                     debug_function
             ) {
@@ -386,8 +1000,21 @@ class GPIOClass : public RegClass {
          * (not expected to be used with a chip)
          */
         void protocol_event(gpio_evt_id_t evt_id);
+#ifdef M0N0_SHADOW_REGS
+        /**
+         * Returns the shadow of the GPIO direction register
+         *
+         * @return pointer to the direction register shadow
+         */
+        PeriphShadowReg* get_direction_shadow(void);
+#endif
     private:
         bool _gpio_protocol;
+#ifdef M0N0_SHADOW_REGS
+        /** Shadow of the GPIO direction register
+         */
+        PeriphShadowReg _direction_shadow = PeriphShadowReg(GPIO_DIRECTION_REG);
+#endif
         void _protocol_send_raw(gpio_sig_id_t id, uint8_t payload);
 };
 
@@ -405,6 +1032,11 @@ class RTCTimer {
          * @return RTC cycles since last reset
          */
         uint64_t get_cycles(); // sets the RTC cycles since reset()
+        /** Returns the RTC value at the last reset
+         *
+         * @return The _start_ticks
+         */
+        uint64_t get_start();
         /** Returns microseconds elapsed since the _start_ticks
          *
          * Note that this function is inefficient and provided solely for 
@@ -414,6 +1046,14 @@ class RTCTimer {
          *
          */
         float get_us(); // same as get_cycles() but converts to microseconds
+        /** Returns microseconds elapsed since the _start_ticks
+         *
+         * Integer (fixed-point) conversion with the RTC calibration (see 
+         * M0N0_System::rtc_to_us)
+         *
+         * @return Microseconds elapsed since the last reset
+         */
+        uint64_t get_elapsed_us();
         /** Sets the software timer interval
          * 
          * @param interval_cycles The number of RTC cycle periods that make
@@ -428,6 +1068,10 @@ class RTCTimer {
         /**
          * Checks whether the interval has elapsed. 
          *
+         * Intervals of up to M0N0_System::kRtcElapsedMax ticks are checked
+         * with the 32-bit RTC LSBs (see M0N0_System::rtc_elapsed), and so 
+         * must be checked at least once every kRtcElapsedMax ticks. 
+         *
          * @return Returns true if the interval has elapsed, false otherwise
          */
         bool check_interval(); // returns true if time has elapsed 
@@ -439,18 +1083,196 @@ class RTCTimer {
          * Lowers the current DVFS level to the minimum value and waits
          * in a loop for the specified time period, before restoring
          * the DVFS level on exit
+         *
+         * With the DVFS governor enabled (see 
+         * M0N0_System::enable_dvfs_governor), the code run since the last 
+         * wait is a job: the wait ends it, and the exit begins the next 
+         * job at the governor's level. 
          */
         void wait_lp();
         /**
          * In addition to reducing the DVFS level, it uses the PCSM interrupt
          *  timer ("loop timer") to wait for the specified time (putting the
-         * CPU into a lower-power WFI state). 
+         * CPU into a lower-power WFI state). The DVFS governor is used as
+         * for wait_lp. While SoftTimers are active (they own INTTIMER0), 
+         * it falls back to wait_lp. 
          */
         void wait_lp_inttimer();
 };
 
-class AESClass : public RegClass {
-    using RegClass::RegClass;
+/** One-shot and periodic software timers, multiplexed onto the PCSM 
+ *  interrupt timer (INTTIMER0)
+ *
+ * Any number of timers can be started (they are not allocated: the objects
+ * must stay in scope while active). The active timers are kept in a list 
+ * ordered by deadline and INTTIMER0 is only programmed for the earliest 
+ * one (tickless). Callbacks run in the interrupt, and so main loops can 
+ * __WFI between deadlines instead of polling RTCTimer::check_interval. 
+ *
+ * INTTIMER0 is reloaded by the hardware, so it is not reprogrammed when 
+ * the next deadline is one interval later (e.g. a single periodic timer). 
+ *
+ * @note While timers are active, INTTIMER0 cannot be used for anything 
+ *     else (enable_pcsm_interrupt_timer_* and disable_pcsm_interrupt_timer 
+ *     error with EXTRA_CHECKS, and autosampling must not be enabled), 
+ *     RTCTimer::wait_lp_inttimer falls back to wait_lp and sleep_for does 
+ *     not use WFI or timed shutdown. 
+ * @note INTTIMER0 is written over the SPI from the interrupt: disable 
+ *     Interrupt5_IRQn around other SPI transactions. 
+ */
+class SoftTimer {
+    private:
+        /** The active timers, earliest deadline first
+         */
+        static SoftTimer* _head;
+        /** When INTTIMER0 fires next (RTC ticks)
+         */
+        static uint64_t _hw_next;
+        /** The INTTIMER0 interval (0 when disabled)
+         */
+        static uint32_t _hw_interval;
+        /** Set while the interrupt is dispatching callbacks (it re-arms 
+         * INTTIMER0 once they have run)
+         */
+        static bool _dispatching;
+        SoftTimer* _next;
+        uint64_t _deadline;
+        uint64_t _period; // 0 for one-shot
+        Handler_Func _callback;
+        volatile uint32_t _expiries;
+        volatile bool _active;
+        void _insert();
+        void _remove();
+        /** Programs INTTIMER0 for the earliest deadline (if needed)
+         */
+        static void _rearm(uint64_t now);
+        /** The INTTIMER0 interrupt handler: runs the expired timers
+         */
+        static void _dispatch(void);
+    public:
+        SoftTimer();
+        /** Starts (or restarts) the timer
+         *
+         * @param rtc_ticks The interval in RTC ticks
+         * @param callback Function called from the interrupt when the 
+         *     timer expires (NULL for none: see take_expiries)
+         * @param periodic Whether the timer restarts after expiring 
+         *     (periodic) or stops (one-shot)
+         */
+        void start(uint64_t rtc_ticks, Handler_Func callback, bool periodic);
+        /** Starts (or restarts) the timer with an interval in milliseconds
+         *
+         * @param interval_ms The interval in milliseconds
+         * @param callback Function called from the interrupt when the 
+         *     timer expires (NULL for none)
+         * @param periodic Whether the timer restarts after expiring
+         */
+        void start_ms(uint32_t interval_ms, Handler_Func callback, 
+                bool periodic);
+        /** Stops the timer (INTTIMER0 is disabled when no timers are active)
+         */
+        void stop();
+        /** Returns whether the timer is active (one-shot timers stop when 
+         * they expire)
+         */
+        bool is_active();
+        /** Returns the number of times the timer has expired since the last
+         * call (and clears it)
+         */
+        uint32_t take_expiries();
+        /** Returns whether any timers are active (and so own INTTIMER0)
+         */
+        static bool is_running();
+};
+
+/** A run-to-completion event loop with priorities
+ *
+ * Up to 32 events are added with a handler. An event's ID (0-31) is also 
+ * its priority: when several are pending, the highest ID runs first. Each
+ * post (from the main code or an interrupt) runs the handler once, to 
+ * completion (handlers are not pre-empted by other events). 
+ *
+ * Posting is lock-free (atomic read-modify-writes, LDREX/STREX on the 
+ * Cortex-M33), so interrupts are never masked to post. 
+ *
+ * When no events are pending, run() calls the idle hook: it lowers the 
+ * perf (see set_idle_perf) and WFIs until an interrupt posts an event. 
+ * The time spent in WFI is counted (get_idle_ticks). 
+ */
+class EventQueue {
+    private:
+        /** One bit per event with posts not yet run
+         */
+        volatile uint32_t _pending;
+        /** The number of posts not yet run (per event)
+         */
+        volatile uint32_t _counts[32];
+        Handler_Func _handlers[32];
+        uint8_t _idle_perf;
+        uint8_t _active_perf;
+        uint64_t _idle_ticks;
+        uint64_t _stats_start;
+        uint32_t _wakeups;
+        /** Waits (WFI) until an event is pending
+         */
+        void _idle();
+    public:
+        /** Value for set_idle_perf to leave the perf unchanged when idle
+         */
+        static const uint8_t kIdlePerfUnchanged = 0xFF;
+        EventQueue();
+        /** Adds an event
+         *
+         * @param id The event ID (0-31), which is also its priority 
+         *     (the highest pending ID runs first)
+         * @param handler The function run (from run or dispatch_one) for 
+         *     each post
+         */
+        void add_event(uint32_t id, Handler_Func handler);
+        /** Posts an event (safe from interrupts)
+         *
+         * @param id The event ID
+         */
+        void post(uint32_t id);
+        /** Returns whether any events are pending
+         */
+        bool is_pending();
+        /** Runs the handler of the highest priority pending event
+         *
+         * @return Whether an event was run
+         */
+        bool dispatch_one();
+        /** Runs the event loop (does not return)
+         *
+         * Dispatches events in priority order, calling the idle hook when 
+         * none are pending. The perf when run is called is restored when 
+         * leaving the idle hook. 
+         */
+        void run();
+        /** Sets the perf used while idle (default 0)
+         *
+         * The perf is not changed while SPI autosampling is enabled (the 
+         * PCSM is written over the SPI). 
+         *
+         * @param perf The perf (0-15) or kIdlePerfUnchanged
+         */
+        void set_idle_perf(uint8_t perf);
+        /** Resets the idle time and wake up counts
+         */
+        void reset_stats();
+        /** Returns the RTC ticks spent in WFI since reset_stats
+         */
+        uint64_t get_idle_ticks();
+        /** Returns the RTC ticks elapsed since reset_stats
+         */
+        uint64_t get_stats_ticks();
+        /** Returns the number of WFI wake ups since reset_stats
+         */
+        uint32_t get_wakeups();
+};
+
+class AESClass : public PeriphRegClass {
+    using PeriphRegClass::PeriphRegClass;
     public:
         /**
          * Set the encryption/decryption key
@@ -485,6 +1307,24 @@ class AESClass : public RegClass {
         // Interrupt-driven AES not supported by these libs:
         //void encrypt_irq(const uint32_t* data, const uint32_t data_size);
         //void decrypt_irq(const uint32_t* data, const uint32_t data_size);
+        /**
+         * Starts encrypting/decrypting a 4-word block (does not wait: see 
+         * is_complete and read_block)
+         *
+         * @param data pointer to the 4-word block
+         * @param decrypt Whether to decrypt (true) or encrypt (false)
+         */
+        void start_block(const uint32_t* data, bool decrypt);
+        /**
+         * Returns whether the block has been encrypted/decrypted
+         */
+        bool is_complete();
+        /**
+         * Reads the encrypted/decrypted block
+         *
+         * @param result pointer to a 4-word array for the result
+         */
+        void read_block(uint32_t* result);
     private:
         void _write_data(const uint32_t* data);
         void _read_data(uint32_t* res);
@@ -683,6 +1523,232 @@ class CircBuffer {
         uint32_t get_sample_count(uint32_t position);
 };
 
+/*
+ * Stackless coroutines (CoTask) 
+ *
+ * A task's run() function is resumed by a CoScheduler from where it last 
+ * waited (a switch on the line number, as protothreads). Waits return to 
+ * the scheduler, which WFIs while every task is sleeping or waiting for a
+ * flag set by an interrupt. 
+ *
+ * - Values needed after a wait must be members of the task (the locals of
+ *   run() are lost when it waits)
+ * - run() must not contain a switch statement, or more than one wait on a
+ *   line
+ */
+
+// (the resume points are case labels reached from the code before them)
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#define M0N0_CO_FALLTHROUGH __attribute__((fallthrough))
+#else
+#define M0N0_CO_FALLTHROUGH
+#endif
+
+/** Starts the body of CoTask::run (must be first)
+ */
+#define M0N0_CO_BEGIN() switch (this->_co_line) { case 0:
+/** Ends the body of CoTask::run (must be last): the task is done
+ */
+#define M0N0_CO_END() } this->_co_done(); return
+/** Lets the other tasks run
+ */
+#define M0N0_CO_YIELD() \
+    do { this->_co_wait(CoTask::CO_READY, __LINE__); return; \
+        case __LINE__:; } while (0)
+/** Sleeps for a number of RTC ticks (the core WFIs if nothing else runs)
+ */
+#define M0N0_CO_SLEEP_RTC(rtc_ticks) \
+    do { this->_co_sleep((rtc_ticks), __LINE__); return; \
+        case __LINE__:; } while (0)
+/** Sleeps for a number of milliseconds
+ */
+#define M0N0_CO_SLEEP_MS(time_ms) \
+    M0N0_CO_SLEEP_RTC(M0N0_System::ms_to_rtc(time_ms))
+/** Waits until a (volatile bool) flag set by an interrupt has a value 
+ * (the core WFIs if nothing else runs)
+ */
+#define M0N0_CO_WAIT_FLAG(flag, value) \
+    do { M0N0_CO_FALLTHROUGH; case __LINE__: if ((flag) != (value)) { \
+        this->_co_wait_flag(&(flag), (value), __LINE__); return; } \
+    } while (0)
+/** Waits for an operation (an object with bool poll(), e.g. SPITransfer or
+ * AESOperation) to complete. The operation is polled on every scheduler 
+ * pass, so the core does not WFI while waiting. 
+ */
+#define M0N0_CO_AWAIT(op) \
+    do { M0N0_CO_FALLTHROUGH; case __LINE__: if (!(op).poll()) { \
+        this->_co_wait(CoTask::CO_POLL, __LINE__); return; } \
+    } while (0)
+
+/** A stackless coroutine, run by a CoScheduler
+ *
+ * Derive from it and implement run() with the M0N0_CO_ macros, e.g.: 
+ *
+ *     void run() {
+ *         M0N0_CO_BEGIN();
+ *         for (this->_count = 0; this->_count < 10; this->_count++) {
+ *             M0N0_CO_SLEEP_MS(100);
+ *             this->_xfer.start(sys->spi, SS0, NULL, this->_rx, 2);
+ *             M0N0_CO_AWAIT(this->_xfer);
+ *         }
+ *         M0N0_CO_END();
+ *     }
+ */
+class CoTask {
+    friend class CoScheduler;
+    public:
+        /** What the task is waiting for
+         */
+        enum CoState {
+            CO_READY = 0, // runs on the next pass
+            CO_POLL, // runs on every pass (polling an operation)
+            CO_SLEEP, // runs once the RTC reaches _co_deadline
+            CO_FLAG, // runs once *_co_flag == _co_flag_value
+            CO_DONE // finished (M0N0_CO_END)
+        };
+        CoTask();
+        virtual ~CoTask() {}
+        /** The task body (resumed by the scheduler)
+         */
+        virtual void run() = 0;
+        /** Returns whether the task has finished
+         */
+        bool is_done();
+        /** Restarts the task from the beginning of run()
+         */
+        void restart();
+    protected:
+        uint32_t _co_line;
+        void _co_wait(CoState state, uint32_t line);
+        void _co_sleep(uint64_t rtc_ticks, uint32_t line);
+        void _co_wait_flag(volatile bool* flag, bool value, uint32_t line);
+        void _co_done();
+    private:
+        CoState _co_state;
+        uint64_t _co_deadline;
+        volatile bool* _co_flag;
+        bool _co_flag_value;
+};
+
+/** Runs CoTasks (statically allocated, up to kMaxTasks)
+ */
+class CoScheduler {
+    public:
+        static const uint32_t kMaxTasks = 8;
+    private:
+        CoTask* _tasks[kMaxTasks];
+        uint32_t _num_tasks;
+        /** Wakes the core (WFI) at the earliest sleep deadline
+         */
+        SoftTimer _wake_timer;
+        uint32_t _wakeups;
+        /** Returns whether a waiting task can run (with interrupts masked)
+         */
+        bool _is_runnable(CoTask* task, uint64_t now);
+    public:
+        CoScheduler();
+        /** Adds a task (not owned: it must stay in scope)
+         *
+         * @return Whether the task was added (false if kMaxTasks are added)
+         */
+        bool add(CoTask* task);
+        /** Runs every task that can run once
+         *
+         * @return Whether any tasks have not finished
+         */
+        bool step();
+        /** Runs the tasks until they have all finished
+         *
+         * When no task can run and none is polling an operation, the 
+         * core WFIs (woken by the interrupts that set flags, or by a 
+         * SoftTimer at the earliest sleep deadline). 
+         */
+        void run();
+        /** Returns the number of WFI wake ups in run()
+         */
+        uint32_t get_wakeups();
+};
+
+/** An SPI transfer that completes without blocking (see M0N0_CO_AWAIT)
+ *
+ * The PCSM interrupt timer interrupt (used by the SoftTimers, including 
+ * the CoScheduler wake up) is masked from start until the transfer 
+ * completes: its handler writes the PCSM over the SPI, which would 
+ * deselect the slave or write the data register mid-transfer. 
+ *
+ * @note As for SPIClass::write_byte, SPI autosampling must be disabled 
+ *     and other tasks must not access the PCSM (e.g. set_perf or 
+ *     SoftTimer::start) until the transfer completes
+ */
+class SPITransfer {
+    private:
+        SPIClass* _spi;
+        const uint8_t* _tx;
+        uint8_t* _rx;
+        uint32_t _len;
+        uint32_t _pos;
+        bool _in_byte;
+        bool _done;
+        bool _unmask_inttimer; // (the interrupt was enabled at start)
+    public:
+        SPITransfer();
+        /** Selects the slave and starts the transfer
+         *
+         * @param spi The SPI (e.g. sys->spi)
+         * @param slave The slave to select (deselected when complete)
+         * @param tx The bytes to send (NULL to send zeros)
+         * @param rx Array for the received bytes (NULL to ignore them)
+         * @param len The number of bytes
+         */
+        void start(SPIClass* spi, SPI_SS_t slave, const uint8_t* tx, 
+                uint8_t* rx, uint32_t len);
+        /** Advances the transfer
+         *
+         * @return Whether the transfer has completed
+         */
+        bool poll();
+};
+
+/** An AES encryption or decryption that completes without blocking (see 
+ *  M0N0_CO_AWAIT)
+ */
+class AESOperation {
+    private:
+        AESClass* _aes;
+        const uint32_t* _data;
+        uint32_t _size;
+        uint32_t* _result;
+        uint32_t _pos;
+        bool _decrypt;
+        void _start(AESClass* aes, const uint32_t* data, uint32_t size,
+                uint32_t* result, bool decrypt);
+    public:
+        AESOperation();
+        /** Starts encrypting (see AESClass::encrypt_blocking)
+         *
+         * @param aes The AES (e.g. sys->aes)
+         * @param data pointer to data array
+         * @param size length of the data array (a multiple of 4)
+         * @param result pointer to array in which to store the result
+         */
+        void start_encrypt(AESClass* aes, const uint32_t* data, 
+                uint32_t size, uint32_t* result);
+        /** Starts decrypting (see AESClass::decrypt_blocking)
+         *
+         * @param aes The AES (e.g. sys->aes)
+         * @param data pointer to data array
+         * @param size length of the data array (a multiple of 4)
+         * @param result pointer to array in which to store the result
+         */
+        void start_decrypt(AESClass* aes, const uint32_t* data, 
+                uint32_t size, uint32_t* result);
+        /** Advances the operation
+         *
+         * @return Whether all the blocks have been processed
+         */
+        bool poll();
+};
+
 
 #endif // SYSUTIL_H
 
@@ -33,11 +33,16 @@
 // Handlers
 ////////////////////////
 
-// Implemented in M0N0.cpp:
-void hand_extwake();
-void hand_systick();
-void hand_pcsm_timer();
-void hand_autosample();
+// (set by M0N0_System when the callbacks are registered)
+void (*m0n0_irq_callbacks[M0N0_IRQ_CALLBACKS])(void) = {
+    &m0n0_irq_unhandled_callback, // M0N0_IRQ_SYSTICK
+    &m0n0_irq_unhandled_callback, // M0N0_IRQ_AUTOSAMPLE
+    &m0n0_irq_unhandled_callback, // M0N0_IRQ_PCSM_TIMER
+    &m0n0_irq_unhandled_callback}; // M0N0_IRQ_EXTWAKE
+
+void m0n0_irq_unhandled_callback(void) {
+    m0n0_irq_unhandled += 1;
+}
 
 void HardFault_Handler(void) {
     if (M0N0_is_deve()) { // if DEVE mode enabled
@@ -81,48 +86,61 @@ void UsageFault_Handler(void) {
     while(1);
 }
 
+// The handlers below call the callbacks through m0n0_irq_callbacks and do 
+// not print (see the interruptN_flag counters)
+
+#ifdef M0N0_PC_SAMPLE
+// Counts the interrupted PC (frame[6]), then calls the SysTick callback 
+void SysTick_Handler_Sampled(const unsigned int* frame) {
+    M0N0_pc_sample((frame != NULL) ? frame[6] : 0xFFFFFFFF);
+    systick_flag += 1;
+    m0n0_irq_callbacks[M0N0_IRQ_SYSTICK]();
+}
+
+#ifdef M0N0_HOST
+void SysTick_Handler(void) {
+    SysTick_Handler_Sampled(NULL); // (no exception frame)
+}
+#else
+// Passes the stack the exception frame was pushed to (EXC_RETURN bit 2: 
+// MSP or PSP) to SysTick_Handler_Sampled, which returns from the exception
+__attribute__((naked)) void SysTick_Handler(void) {
+    __asm volatile(
+        "tst lr, #4\n"
+        "ite eq\n"
+        "mrseq r0, msp\n"
+        "mrsne r0, psp\n"
+        "b SysTick_Handler_Sampled\n");
+}
+#endif
+#else
 void SysTick_Handler(void) {
     systick_flag += 1;
-    hand_systick();
-    if (M0N0_is_deve()) { // if DEVE mode enabled
-        m0n0_printf("SysTick_Handler()\n");
-    }
+    m0n0_irq_callbacks[M0N0_IRQ_SYSTICK]();
 }
+#endif
 
 // GPIO Interrupt
 void Interrupt0_Handler(void) {
     interrupt0_flag +=1;
-    // This is GPIO0 interrupt
-    if (M0N0_is_deve()) {
-        m0n0_printf("IRQGPIO\n");
-    }
 }
 
 // Autosample Interrupt
 void Interrupt1_Handler(void) {
     interrupt1_flag +=1;
-    hand_autosample(); // NOTE: must be before printf due to PCSM timing
-    //if (M0N0_is_deve()) {
-    //    m0n0_printf("Autosample\n");
-    //}
+    m0n0_irq_callbacks[M0N0_IRQ_AUTOSAMPLE]();
 }
 
 // PCSM IntTimer Interrupt
 void Interrupt5_Handler(void) {
     interrupt5_flag += 1;
-    hand_pcsm_timer();
-    if (M0N0_is_deve()) {
-        m0n0_printf("PCSMINTTIMERIRQ");
-    }
+    m0n0_irq_callbacks[M0N0_IRQ_PCSM_TIMER]();
 }
 
 // EXTAKE Interrupt
 void Interrupt6_Handler(void) {
     interrupt6_flag += 1;
-    hand_extwake();
-    if (M0N0_is_deve()) {
-        m0n0_printf("IRQEXTWAKE\n");
-    }
+    m0n0_irq_callbacks[M0N0_IRQ_EXTWAKE]();
 }
 
 
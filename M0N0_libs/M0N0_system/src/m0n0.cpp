@@ -27,6 +27,7 @@
  */
 
 #include "m0n0.h"
+#include "m0n0_regs.h"
 #include <cstdarg>
 
 extern "C" {
@@ -35,7 +36,18 @@ extern "C" {
     #include "interrupts.h"
 }
 
-#define ADP_COMMAND_ID "3d7db2ae"
+// drivers for the control/status registers and SHRAM
+#ifdef M0N0_REG_TRACE
+#define SYS_READ_DRIVER &M0N0_trace_read
+#define SYS_WRITE_DRIVER &M0N0_trace_write
+#define SYS_READ_BG_DRIVER &M0N0_trace_read_bit_group
+#define SYS_WRITE_BG_DRIVER &M0N0_trace_write_bit_group
+#else
+#define SYS_READ_DRIVER &M0N0_read
+#define SYS_WRITE_DRIVER &M0N0_write
+#define SYS_READ_BG_DRIVER &M0N0_read_bit_group
+#define SYS_WRITE_BG_DRIVER &M0N0_write_bit_group
+#endif
 
 // ---------- M0N0 System ---------- //
 #ifdef M0N0_HEAP
@@ -49,10 +61,10 @@ M0N0_System::M0N0_System()
                 false,
                 CONTROL_SIZE,
                 REG_MEM_READ_WRITE,
-                &M0N0_read,
-                &M0N0_write,
-                &M0N0_read_bit_group,
-                &M0N0_write_bit_group,
+                SYS_READ_DRIVER,
+                SYS_WRITE_DRIVER,
+                SYS_READ_BG_DRIVER,
+                SYS_WRITE_BG_DRIVER,
                 &M0N0_System::error,
                 &M0N0_System::debug),
         _status(
@@ -60,43 +72,28 @@ M0N0_System::M0N0_System()
                 false,
                 STATUS_SIZE,
                 REG_MEM_READ,
-                &M0N0_read,
+                SYS_READ_DRIVER,
                 NULL,
-                &M0N0_read_bit_group,
+                SYS_READ_BG_DRIVER,
                 NULL,
                 &M0N0_System::error,
                 &M0N0_System::debug),
         _aes(
                 AES_BASE_ADDR, // base address
-                false,
                 AES_SIZE,
                 REG_MEM_READ_WRITE,
-                &M0N0_read,
-                &M0N0_write,
-                &M0N0_read_bit_group,
-                &M0N0_write_bit_group,
                 &M0N0_System::error,
                 &M0N0_System::debug),
         _spi(
                 SPI_BASE_ADDR, // base address
-                false,
                 SPI_SIZE,
                 REG_MEM_READ_WRITE,
-                &M0N0_read,
-                &M0N0_write,
-                &M0N0_read_bit_group,
-                &M0N0_write_bit_group,
                 &M0N0_System::error,
                 &M0N0_System::debug),
         _gpio(
                 GPIO_BASE_ADDR, // base address
-                false,
                 GPIO_SIZE,
                 REG_MEM_READ_WRITE,
-                &M0N0_read,
-                &M0N0_write,
-                &M0N0_read_bit_group,
-                &M0N0_write_bit_group,
                 &M0N0_System::error,
                 &M0N0_System::debug),
         _shram(
@@ -104,10 +101,10 @@ M0N0_System::M0N0_System()
                 true,
                 MEM_MAP_SHRAM_SIZE,
                 REG_MEM_READ_WRITE,
-                &M0N0_read,
-                &M0N0_write,
-                &M0N0_read_bit_group,
-                &M0N0_write_bit_group,
+                SYS_READ_DRIVER,
+                SYS_WRITE_DRIVER,
+                SYS_READ_BG_DRIVER,
+                SYS_WRITE_BG_DRIVER,
                 &M0N0_System::error,
                 &M0N0_System::debug)
 {
@@ -147,6 +144,16 @@ M0N0_System::M0N0_System()
             STATUS_R07_MEMORY_REMAP_BIT_MASK);
     temp_code_ctrl |= (5 << 3);
     this->spi->pcsm_write(PCSM_CODE_CTRL_REG, temp_code_ctrl);
+    M0N0_System::load_rtc_calibration();
+    this->_load_sleep_costs();
+    this->_load_perf_freqs();
+    this->_update_core_clock(this->get_perf());
+    this->_tcro_tracking = false;
+    this->_bind_irq_callbacks();
+    this->reset_tcro_tracking();
+    this->_dvfs_governed = false;
+    this->_dvfs_in_job = false;
+    this->reset_dvfs_stats();
 }
 
 #ifdef M0N0_HEAP
@@ -162,110 +169,203 @@ void M0N0_System::set_log_level(LOG_LEVEL_t log_level) {
     this->_log_level = log_level;
 }
 
+LOG_LEVEL_t M0N0_System::get_log_level(void) {
+    return this->_log_level;
+}
+
 void M0N0_System::_shutdown_cleanup(void) {
     if (this->spi->get_is_autosampling()) {
         this->disable_autosampling(); 
     }
 }
 
-int M0N0_System::log_debug(const char *fmt, ...) {
-#ifdef SUPPRESS_STDOUT
-    return -1;
-#endif
-    LOG_LEVEL_t temp = DEBUG;
-    if (temp < this->_log_level) {
-        return -1;
-    }
-    if (!M0N0_System::_is_deve()) {
-        return -1;
-    }
-    std::string fmt_str(fmt);
-    fmt_str = "DEBUG: "+fmt_str+"\n";
-    char const *new_fmt = &(fmt_str[0]);
+// Sends all buffered output before the system shuts down
+static void flush_output(void) {
+    M0N0_System::log_flush();
+    M0N0_flush_stdout();
+}
+
+// indexed by LOG_LEVEL_t
+static const char* const kLogPrefixes[] = {
+    "DEBUG: ",
+    "INFO:  ",
+    "WARN:  ",
+    "ERROR: "
+};
+
+const char* M0N0_System::_log_prefix(LOG_LEVEL_t level) {
+    return kLogPrefixes[level];
+}
+
+int M0N0_System::_log(LOG_LEVEL_t level, const char *fmt, ...) {
     va_list ap;
     int r;
     va_start(ap, fmt);
-    r = simple_vsprintf(NULL, new_fmt, ap);
+    r = this->_vlog(level, fmt, ap);
     va_end(ap);
     return r;
 }
 
-int M0N0_System::log_info(const char *fmt, ...) {
+int M0N0_System::_vlog(LOG_LEVEL_t level, const char *fmt, va_list ap) {
 #ifdef SUPPRESS_STDOUT
     return -1;
 #endif
-    LOG_LEVEL_t temp = INFO;
-    if (temp < this->_log_level) {
+    if (level < this->_log_level) {
         return -1;
     }
     if (!M0N0_System::_is_deve()) {
         return -1;
     }
-    std::string fmt_str(fmt);
-    fmt_str = "INFO:  "+fmt_str+"\n";
-    char const *new_fmt = &(fmt_str[0]);
+    M0N0_System::log_flush();
+    int r = m0n0_print_string(kLogPrefixes[level]);
+    r += simple_vsprintf(NULL, fmt, ap);
+    r += m0n0_print_string("\n");
+    return r;
+}
+
+// the names are in brackets so that the (M0N0_LOG_TOKENIZED) log_* macros
+// are not expanded
+int (M0N0_System::log_debug)(const char *fmt, ...) {
     va_list ap;
     int r;
     va_start(ap, fmt);
-    r = simple_vsprintf(NULL, new_fmt, ap);
+    r = this->_vlog(DEBUG, fmt, ap);
     va_end(ap);
     return r;
 }
 
-int M0N0_System::log_warn(const char *fmt, ...) {
-#ifdef SUPPRESS_STDOUT
-    return -1;
-#endif
-    LOG_LEVEL_t temp = WARN;
-    if (temp < this->_log_level) {
-        return -1;
-    }
-    if (!M0N0_System::_is_deve()) {
-        return -1;
-    }
-    std::string fmt_str(fmt);
-    fmt_str = "WARN:  "+fmt_str+"\n";
-    char const *new_fmt = &(fmt_str[0]);
+int (M0N0_System::log_info)(const char *fmt, ...) {
+    va_list ap;
+    int r;
+    va_start(ap, fmt);
+    r = this->_vlog(INFO, fmt, ap);
+    va_end(ap);
+    return r;
+}
+
+int (M0N0_System::log_warn)(const char *fmt, ...) {
     va_list ap;
     int r;
     va_start(ap, fmt);
-    r = simple_vsprintf(NULL, new_fmt, ap);
+    r = this->_vlog(WARN, fmt, ap);
     va_end(ap);
     return r;
 }
 
-int M0N0_System::log_error(const char *fmt, ...) {
+int (M0N0_System::log_error)(const char *fmt, ...) {
+    va_list ap;
+    int r;
+    va_start(ap, fmt);
+    r = this->_vlog(ERROR, fmt, ap);
+    va_end(ap);
+    return r;
+}
+
+#ifdef M0N0_LOG_TOKENIZED
+uint32_t M0N0_System::_log_ring[M0N0_LOG_RING_WORDS];
+volatile uint32_t M0N0_System::_log_ring_head = 0;
+volatile uint32_t M0N0_System::_log_ring_tail = 0;
+
+int M0N0_System::_log_token_write(
+        LOG_LEVEL_t level,
+        uint32_t id,
+        const uint32_t* args,
+        uint32_t nargs) {
 #ifdef SUPPRESS_STDOUT
     return -1;
 #endif
-    LOG_LEVEL_t temp = ERROR;
-    if (temp < this->_log_level) {
+    if (nargs + 1 > M0N0_LOG_RING_WORDS) {
         return -1;
     }
-    if (!M0N0_System::_is_deve()) {
-        return -1;
+    if ((M0N0_LOG_RING_WORDS - (M0N0_System::_log_ring_head - 
+            M0N0_System::_log_ring_tail)) < (nargs + 1)) {
+        M0N0_System::log_flush();
     }
-    std::string fmt_str(fmt);
-    fmt_str = "ERROR: "+fmt_str+"\n";
-    char const *new_fmt = &(fmt_str[0]);
-    va_list ap;
-    int r;
-    va_start(ap, fmt);
-    r = simple_vsprintf(NULL, new_fmt, ap);
-    va_end(ap);
-    return r;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t head = M0N0_System::_log_ring_head;
+    M0N0_System::_log_ring[head % M0N0_LOG_RING_WORDS] = (id & 0xFFFFF) | 
+            (nargs << 20) | ((uint32_t)level << 24);
+    head++;
+    for (uint32_t i = 0; i < nargs; i++) {
+        M0N0_System::_log_ring[head % M0N0_LOG_RING_WORDS] = args[i];
+        head++;
+    }
+    M0N0_System::_log_ring_head = head;
+    __set_PRIMASK(primask);
+    return 0;
+}
+
+static const char kBase64Chars[] = 
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// sends 1-3 bytes as base64 (with padding if less than 3)
+static void log_write_base64(const uint8_t* bytes, uint32_t len) {
+    uint32_t v = ((uint32_t)bytes[0] << 16) | 
+            ((len > 1 ? (uint32_t)bytes[1] : 0) << 8) | 
+            (len > 2 ? (uint32_t)bytes[2] : 0);
+    M0N0_write_stdout(kBase64Chars[(v >> 18) & 0x3F]);
+    M0N0_write_stdout(kBase64Chars[(v >> 12) & 0x3F]);
+    M0N0_write_stdout(len > 1 ? kBase64Chars[(v >> 6) & 0x3F] : '=');
+    M0N0_write_stdout(len > 2 ? kBase64Chars[v & 0x3F] : '=');
+}
+#endif
+
+void M0N0_System::log_flush(void) {
+#ifdef M0N0_LOG_TOKENIZED
+    if (M0N0_System::_log_ring_head == M0N0_System::_log_ring_tail) {
+        return;
+    }
+    bool send = M0N0_System::_is_deve();
+#ifdef SUPPRESS_STDOUT
+    send = false;
+#endif
+    if (send) {
+        const char* start = ADP_COMMAND_ID "_log:";
+        while (*start) {
+            M0N0_write_stdout(*start++);
+        }
+    }
+    // the words are sent little endian, as one base64 string
+    uint8_t bytes[3];
+    uint32_t nbytes = 0;
+    while (1) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uint32_t tail = M0N0_System::_log_ring_tail;
+        if (tail == M0N0_System::_log_ring_head) {
+            __set_PRIMASK(primask);
+            break;
+        }
+        uint32_t word = M0N0_System::_log_ring[tail % M0N0_LOG_RING_WORDS];
+        M0N0_System::_log_ring_tail = tail + 1;
+        __set_PRIMASK(primask);
+        if (!send) {
+            continue;
+        }
+        for (uint32_t i = 0; i < 4; i++) {
+            bytes[nbytes++] = (uint8_t)(word >> (8*i));
+            if (nbytes == 3) {
+                log_write_base64(bytes, 3);
+                nbytes = 0;
+            }
+        }
+    }
+    if (send) {
+        if (nbytes) {
+            log_write_base64(bytes, nbytes);
+        }
+        M0N0_write_stdout('\n');
+    }
+#endif
 }
 
 uint8_t M0N0_System::_get_raw_perf() {
-    return (uint8_t)this->status->read(
-            STATUS_STATUS_7_REG,
-            STATUS_R07_PERF_BIT_MASK);
+    return (uint8_t)StatusPerf::read();
 }
 
 uint8_t M0N0_System::get_perf() {
-    return this->_inv_perf_lookup[(uint8_t)this->status->read(
-            STATUS_STATUS_7_REG,
-            STATUS_R07_PERF_BIT_MASK)];
+    return M0N0_perf_level((uint8_t)StatusPerf::read());
 }
 
 void M0N0_System::_set_raw_perf(uint8_t raw_perf) {
@@ -284,6 +384,10 @@ void M0N0_System::set_perf(uint8_t perf) {
     }
 #endif
     this->_set_raw_perf(_perf_lookup[perf]);
+    this->_update_core_clock(perf);
+    if (this->_tcro_tracking) {
+        this->reset_tcro_tracking();
+    }
     // This makes the device wait until the perf has actually been updated:
     // while(this->_get_raw_perf()!=_perf_lookup[perf]);
     // note that the actual Voltage and frequency does not change immediately 
@@ -292,39 +396,128 @@ void M0N0_System::set_perf(uint8_t perf) {
 
 
 uint64_t M0N0_System::get_rtc() {
-    uint64_t rtc = this->status->read(
-            STATUS_STATUS_4_REG,
-            STATUS_R04_RTC_MSBS_BIT_MASK);
-    rtc = rtc << 32;
-    rtc |= this->status->read(
-            STATUS_STATUS_2_REG,
-            STATUS_R02_RTC_LSBS_BIT_MASK);
-    return rtc;
+    // the LSBs can roll over between the two reads (giving a value that is 
+    // 2^32 ticks out): re-read until the MSBs are the same either side
+    uint32_t msbs;
+    uint32_t lsbs;
+    do {
+        msbs = StatusRtcMsbs::read();
+        lsbs = StatusRtcLsbs::read();
+    } while (msbs != StatusRtcMsbs::read());
+    return ((uint64_t)msbs << 32) | lsbs;
 }
 
 float M0N0_System::get_rtc_us() {
-    return (this->get_rtc() * kRtcPeriodUs) ;
+    return (float)M0N0_System::rtc_to_us(this->get_rtc());
+}
+
+uint64_t M0N0_System::get_time_us() {
+    return M0N0_System::rtc_to_us(this->get_rtc());
+}
+
+uint64_t M0N0_System::get_time_ms() {
+    return M0N0_System::rtc_to_ms(this->get_rtc());
+}
+
+// RTC time conversions (fixed-point factors, derived from the nominal 
+// frequency until a calibration is set)
+uint32_t M0N0_System::_rtc_freq_millihz = M0N0_System::kRtcFreqMilliHz;
+uint32_t M0N0_System::_rtc_us_per_tick_q24 = (uint32_t)(
+        (1000000000ULL << 24) / M0N0_System::kRtcFreqMilliHz);
+uint32_t M0N0_System::_rtc_ms_per_tick_q32 = (uint32_t)(
+        (1000000ULL << 32) / M0N0_System::kRtcFreqMilliHz);
+uint32_t M0N0_System::_rtc_ticks_per_ms_q24 = (uint32_t)(
+        ((uint64_t)M0N0_System::kRtcFreqMilliHz << 24) / 1000000ULL);
+uint32_t M0N0_System::_rtc_ticks_per_us_q32 = (uint32_t)(
+        ((uint64_t)M0N0_System::kRtcFreqMilliHz << 32) / 1000000000ULL);
+
+// Rounded (value * factor) >> frac_bits (1 <= frac_bits <= 32), with 32x32
+// bit multiplies only (value can be up to 64 bits)
+static uint64_t scale_fixed(uint64_t value, uint32_t factor, 
+        uint32_t frac_bits) {
+    uint64_t hi = (value >> 32) * factor;
+    uint64_t lo = (value & 0xFFFFFFFF) * factor;
+    return (hi << (32 - frac_bits)) 
+            + ((lo + (1ULL << (frac_bits - 1))) >> frac_bits);
+}
+
+uint64_t M0N0_System::rtc_to_us(uint64_t rtc_ticks) {
+    return scale_fixed(rtc_ticks, _rtc_us_per_tick_q24, 24);
+}
+
+uint64_t M0N0_System::rtc_to_ms(uint64_t rtc_ticks) {
+    return scale_fixed(rtc_ticks, _rtc_ms_per_tick_q32, 32);
+}
+
+uint64_t M0N0_System::us_to_rtc(uint64_t time_us) {
+    return scale_fixed(time_us, _rtc_ticks_per_us_q32, 32);
+}
+
+uint64_t M0N0_System::ms_to_rtc(uint64_t time_ms) {
+    return scale_fixed(time_ms, _rtc_ticks_per_ms_q24, 24);
+}
+
+void M0N0_System::_set_rtc_factors(uint32_t rtc_freq_millihz) {
+    // (the only divisions)
+    _rtc_us_per_tick_q24 = (uint32_t)(((1000000000ULL << 24) 
+            + (rtc_freq_millihz / 2)) / rtc_freq_millihz);
+    _rtc_ms_per_tick_q32 = (uint32_t)(((1000000ULL << 32) 
+            + (rtc_freq_millihz / 2)) / rtc_freq_millihz);
+    _rtc_ticks_per_ms_q24 = (uint32_t)((((uint64_t)rtc_freq_millihz << 24) 
+            + 500000ULL) / 1000000ULL);
+    _rtc_ticks_per_us_q32 = (uint32_t)((((uint64_t)rtc_freq_millihz << 32) 
+            + 500000000ULL) / 1000000000ULL);
+    _rtc_freq_millihz = rtc_freq_millihz;
+}
+
+bool M0N0_System::set_rtc_calibration(uint32_t rtc_freq_millihz) {
+    if ((rtc_freq_millihz < kRtcCalMinMilliHz) || 
+            (rtc_freq_millihz > kRtcCalMaxMilliHz)) {
+        return false;
+    }
+    M0N0_System::_set_rtc_factors(rtc_freq_millihz);
+    // stored with its complement (SHRAM is not initialised at power-on)
+    M0N0_write(MEM_MAP_SHRAM_BASE + M0N0_RTC_CAL_SHRAM_ADDR, 
+            rtc_freq_millihz);
+    M0N0_write(MEM_MAP_SHRAM_BASE + M0N0_RTC_CAL_SHRAM_ADDR + 4, 
+            ~rtc_freq_millihz);
+    return true;
+}
+
+uint32_t M0N0_System::get_rtc_calibration(void) {
+    return _rtc_freq_millihz;
+}
+
+bool M0N0_System::load_rtc_calibration(void) {
+    uint32_t freq = M0N0_read_rtc_calibration();
+    if ((freq < kRtcCalMinMilliHz) || 
+            (freq > kRtcCalMaxMilliHz)) {
+        return false;
+    }
+    M0N0_System::_set_rtc_factors(freq);
+    return true;
 }
 
 bool M0N0_System::is_rtc_real_time() {
-    return this->status->read(
-            STATUS_STATUS_7_REG,
-            STATUS_R07_REAL_TIME_FLAG_BIT_MASK);
+    return StatusRealTime::read();
 }
 
 void M0N0_System::sleep_rtc(uint64_t rtc_ticks) {
-    uint64_t start = this->get_rtc();
-    while ((this->get_rtc() - start) < rtc_ticks) {
+    if (rtc_ticks > kRtcElapsedMax) {
+        uint64_t start = this->get_rtc();
+        while ((this->get_rtc() - start) < rtc_ticks) {
+            // wait
+        }
+        return;
+    }
+    uint32_t start = M0N0_System::get_rtc_lsbs();
+    while (M0N0_System::rtc_elapsed(start) < (uint32_t)rtc_ticks) {
         // wait
     }
 }
 
 void M0N0_System::sleep_ms(uint32_t time_ms) {
-    uint64_t time_raw = time_ms * kRtcOneMsTicks;
-    uint64_t start = this->get_rtc();
-    while ((this->get_rtc() - start) < time_raw) {
-        // wait
-    }
+    this->sleep_rtc(M0N0_System::ms_to_rtc(time_ms));
 }
 
 
@@ -334,9 +527,7 @@ void M0N0_System::sleep_ms(uint32_t time_ms) {
 
 // Does not use reg objects (req for printf before they are created)
 bool M0N0_System::_is_deve() {
-    return M0N0_read_bit_group(
-            STATUS_STATUS_7_REG,
-            STATUS_R07_DEVE_CORE_BIT_MASK);
+    return M0N0_is_deve(); // cached
 }
 
 int M0N0_System::print(const char *fmt, ...) {
@@ -346,6 +537,7 @@ int M0N0_System::print(const char *fmt, ...) {
     if (!M0N0_System::_is_deve()) {
         return -1;
     }
+    M0N0_System::log_flush();
     int r;
     va_list ap;
     va_start(ap, fmt);
@@ -356,13 +548,13 @@ int M0N0_System::print(const char *fmt, ...) {
 
 void M0N0_System::error(const char *message) {
     M0N0_System* sys = M0N0_System::get_sys();
-    sys->log_error(message);
+    sys->log_error("%s", message);
     throw message;
 }
 
 void M0N0_System::debug(const char *message) {
     M0N0_System* sys = M0N0_System::get_sys();
-    sys->log_debug(message);
+    sys->log_debug("%s", message);
 }
 
 
@@ -388,11 +580,11 @@ void M0N0_System::wait_for_adp(
    */
   // Initialise
     this->ctrl->write(CONTROL_CTRL_5_REG, 0);
-    uint64_t escape_timeout = timeout_ms * this->kRtcOneMsTicks;
-    uint64_t rtc_start = this->get_rtc();
+    RTCTimer escape_timer;
+    escape_timer.set_interval_ms(timeout_ms);
+    escape_timer.reset();
     uint8_t wait_for_rtc_flag = 1; // wait for RTC
-    this->log_debug("rtc start 0x%x%x\n",
-        (uint32_t)(rtc_start >> 32),(uint32_t)rtc_start);
+    this->log_debug("rtc start 0x%llx", escape_timer.get_start());
     // signal waiting for ADP for first time
     testcase_id_t wfa_tc = WAIT_FOR_ADP; // for gpio printing
     this->print("Waiting for ADP direction...\n");
@@ -407,8 +599,8 @@ void M0N0_System::wait_for_adp(
             testcase_id_t tc_id = (testcase_id_t)((ctrl5 >> 8) & 0xFF);
             uint64_t user_rtc_delay = (uint64_t)((ctrl5 & 0xFFFF0000) >> 16) ;
             user_rtc_delay = user_rtc_delay << 12; // multiply by 4096
-            this->print("Strobe. TCID: %d, Repeat Delay: 0x%x%x\n",
-            tc_id,(uint32_t)(user_rtc_delay >> 32),(uint32_t)user_rtc_delay);
+            this->print("Strobe. TCID: %d, Repeat Delay: 0x%llx\n",
+                    tc_id, user_rtc_delay);
             run_testcase(tc_id,verbose,user_rtc_delay);
             //IMPORTANT, now reset ctrl5 to 0
             this->ctrl->write(CONTROL_CTRL_5_REG, 0x00000000); // strobe is 0
@@ -418,8 +610,7 @@ void M0N0_System::wait_for_adp(
         }
         // check timeout
         if (wait_for_rtc_flag && timeout_ms > 0) {
-          uint64_t rtc_cur = this->get_rtc();
-          if ((rtc_cur - rtc_start) >= escape_timeout) {
+          if (escape_timer.check_interval()) {
             this->print("Exiting WFADP\n");
             break;
           }
@@ -468,9 +659,11 @@ void M0N0_System::timed_shutdown(uint64_t rtc_ticks) {
     }
 #endif
     this->_set_rtc_wakeup(rtc_ticks);
-    this->log_debug("T.Shtdwn (%d rtc tks)", rtc_ticks);
+    this->log_debug("T.Shtdwn (%llu rtc tks)", rtc_ticks);
+    flush_output();
     this->set_cpu_deepsleep();
     __WFI();
+    M0N0_refresh_deve(); // only reached if the shutdown did not happen
 }
 
 void M0N0_System::timed_shutdown_ms(const uint32_t time_ms) {
@@ -479,20 +672,24 @@ void M0N0_System::timed_shutdown_ms(const uint32_t time_ms) {
         M0N0_System::error("RTCWKP 0Err");
     }
 #endif
-    uint32_t time_raw = (uint32_t)time_ms * (uint32_t)kRtcOneMsTicks;
-    this->log_debug("T.Shtdwn (%d ms, %d rtc tks)",
+    uint64_t time_raw = M0N0_System::ms_to_rtc(time_ms);
+    this->log_debug("T.Shtdwn (%d ms, %llu rtc tks)",
             time_ms,
             time_raw);
+    flush_output();
     this->_set_rtc_wakeup(time_raw);
     this->set_cpu_deepsleep();
     __WFI();
+    M0N0_refresh_deve(); // only reached if the shutdown did not happen
 }
 
 void M0N0_System::deep_shutdown() {
     this->log_debug("D. Shtdwn");
+    flush_output();
     this->_clear_rtc_wakeup(); // ensure RTC wakeup is zero
     this->set_cpu_deepsleep();
     __WFI();
+    M0N0_refresh_deve(); // only reached if the shutdown did not happen
 }
 
 char M0N0_System::wait_read_stdin() {
@@ -503,62 +700,84 @@ void M0N0_System::set_recommended_settings() {
     this->log_debug("Recomm. sys settinngs");
     // enable RTC FBB
     this->spi->pcsm_write(PCSM_RTC_CTRL1_REG, 0x27 | (1<<3)); // PoR, but [3]=1
-    // set SHRAM delay to 1
-    this->ctrl->write(CONTROL_CTRL_4_REG, CONTROL_R04_SHRAM_DELAY_BIT_MASK, 1);
-    // set dataram delay to 1
-    this->ctrl->write(CONTROL_CTRL_4_REG, CONTROL_R04_DATARAM_DELAY_BIT_MASK, 1);
+    // set SHRAM and dataram delays to 1 (merged into a single store)
+    uint32_t ctrl4 = this->ctrl->read(CONTROL_CTRL_4_REG);
+    ctrl4 &= ~(CONTROL_R04_SHRAM_DELAY_BIT_MASK | 
+            CONTROL_R04_DATARAM_DELAY_BIT_MASK);
+    ctrl4 |= (1 << CONTROL_R04_SHRAM_DELAY_BIT_SHIFT) | 
+            (1 << CONTROL_R04_DATARAM_DELAY_BIT_SHIFT);
+    this->ctrl->write(CONTROL_CTRL_4_REG, ctrl4);
     // Note that the ROM poweron delay is set in the constructor
 }
 
 void M0N0_System::enable_extwake_interrupt(Handler_Func f) {
     this->_handler_extwake = f;
+    this->_bind_irq_callbacks();
     __NVIC_EnableIRQ(Interrupt6_IRQn);
 }
 
 void M0N0_System::disable_extwake_interrupt() {
     this->_handler_extwake = NULL;
+    this->_bind_irq_callbacks();
     __NVIC_DisableIRQ(Interrupt6_IRQn);
 }
 
-extern "C" void hand_extwake() {
-    M0N0_System* sys = M0N0_System::get_sys();
-    if (sys->_handler_extwake == NULL) {
-        M0N0_System::debug("ewake hndlr null");
-        return;
+Handler_Func M0N0_System::_irq_callback(Handler_Func f) {
+    return (f != NULL) ? f : &m0n0_irq_unhandled_callback;
+}
+
+void M0N0_System::_bind_irq_callbacks(void) {
+    Handler_Func systick = M0N0_System::_irq_callback(this->_handler_systick);
+    Handler_Func autosample = M0N0_System::_irq_callback(
+            this->_handler_autosample);
+    Handler_Func pcsm_timer = M0N0_System::_irq_callback(
+            this->_handler_pcsm_inttimer);
+    Handler_Func extwake = M0N0_System::_irq_callback(this->_handler_extwake);
+    if (this->_tcro_tracking) {
+        systick = &M0N0_System::_irq_systick_tracked;
+        autosample = &M0N0_System::_irq_autosample_tracked;
+        pcsm_timer = &M0N0_System::_irq_pcsm_timer_tracked;
+        extwake = &M0N0_System::_irq_extwake_tracked;
     }
-    return sys->_handler_extwake();
+    if (this->autosample_disable_flag) {
+        autosample = &M0N0_System::_irq_autosample_disable;
+    }
+    // (single word stores: an interrupt sees the old or the new callback)
+    m0n0_irq_callbacks[M0N0_IRQ_SYSTICK] = systick;
+    m0n0_irq_callbacks[M0N0_IRQ_AUTOSAMPLE] = autosample;
+    m0n0_irq_callbacks[M0N0_IRQ_PCSM_TIMER] = pcsm_timer;
+    m0n0_irq_callbacks[M0N0_IRQ_EXTWAKE] = extwake;
 }
 
-extern "C" void hand_systick() {
+void M0N0_System::_irq_systick_tracked(void) {
     M0N0_System* sys = M0N0_System::get_sys();
-    if (sys->_handler_systick == NULL) {
-        M0N0_System::debug("stick hndlr null");
-        return;
-    }
-    return sys->_handler_systick();
+    sys->sample_tcro();
+    M0N0_System::_irq_callback(sys->_handler_systick)();
 }
 
-extern "C" void hand_autosample() {
+void M0N0_System::_irq_autosample_tracked(void) {
     M0N0_System* sys = M0N0_System::get_sys();
-    if (sys->autosample_disable_flag) {
-        // DISABLE autosample
-        sys->spi->disable_autosampling();
-        return;
-    }
-    if (sys->_handler_autosample == NULL) {
-        M0N0_System::debug("asample hndlr null");
-        return;
-    }
-    return sys->_handler_autosample();
+    sys->sample_tcro();
+    M0N0_System::_irq_callback(sys->_handler_autosample)();
 }
 
-extern "C" void hand_pcsm_timer() {
+void M0N0_System::_irq_pcsm_timer_tracked(void) {
     M0N0_System* sys = M0N0_System::get_sys();
-    if (sys->_handler_pcsm_inttimer == NULL) {
-        M0N0_System::debug("inttimer hndlr null");
-        return;
-    }
-    return sys->_handler_pcsm_inttimer();
+    sys->sample_tcro();
+    M0N0_System::_irq_callback(sys->_handler_pcsm_inttimer)();
+}
+
+void M0N0_System::_irq_extwake_tracked(void) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    sys->sample_tcro();
+    M0N0_System::_irq_callback(sys->_handler_extwake)();
+}
+
+void M0N0_System::_irq_autosample_disable(void) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    sys->spi->disable_autosampling();
+    sys->autosample_disable_flag = false;
+    sys->_bind_irq_callbacks();
 }
 
 bool M0N0_System::is_vbat_por(void) {
@@ -566,9 +785,7 @@ bool M0N0_System::is_vbat_por(void) {
 }
 
 bool M0N0_System::is_extwake(void) {
-    return this->status->read(
-        STATUS_STATUS_7_REG,
-        STATUS_R07_EXT_WAKE_BIT_MASK); 
+    return StatusExtWake::read();
 }
 
 void M0N0_System::_enable_systick(uint32_t ticks) {
@@ -591,12 +808,11 @@ void M0N0_System::print_info(void) {
     this->log_info("is RTC real-time?: %d, VBAT PoR?: %d",
             this->is_rtc_real_time(), this->is_vbat_por());
     uint64_t rtc_cycles = this->get_rtc();
-    uint32_t rtc_us = (uint32_t)(rtc_cycles*kRtcPeriodUs); // Inefficient
-    this->log_info("RTC Cycles: 0x%X%X (%u us, %u seconds)",
-            (uint32_t)(rtc_cycles >> 32),
-            (uint32_t)(rtc_cycles),
+    uint64_t rtc_us = M0N0_System::rtc_to_us(rtc_cycles);
+    this->log_info("RTC Cycles: 0x%llX (%llu us, %u seconds)",
+            rtc_cycles,
             rtc_us,
-            (rtc_us/1000000));
+            (uint32_t)(rtc_us / 1000000));
     this->log_info("Memory Remap: %d", this->status->read(
             STATUS_STATUS_7_REG,
             STATUS_R07_MEMORY_REMAP_BIT_MASK));
@@ -614,6 +830,340 @@ void M0N0_System::print_info(void) {
 }
 
 
+// Sleep cost record (words): costs, check, wake up marker, wake up time
+static const uint32_t kSleepCheckWord = SLEEP_NUM_MECHANISMS;
+static const uint32_t kSleepMarkerWord = SLEEP_NUM_MECHANISMS + 1;
+static const uint32_t kSleepWakeWord = SLEEP_NUM_MECHANISMS + 2;
+
+static uint32_t sleep_record_read(uint32_t word) {
+    return M0N0_read(MEM_MAP_SHRAM_BASE + M0N0_SLEEP_COST_SHRAM_ADDR 
+            + (word * 4));
+}
+
+static void sleep_record_write(uint32_t word, uint32_t value) {
+    M0N0_write(MEM_MAP_SHRAM_BASE + M0N0_SLEEP_COST_SHRAM_ADDR 
+            + (word * 4), value);
+}
+
+void M0N0_System::_load_sleep_costs(void) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < SLEEP_NUM_MECHANISMS; i++) {
+        this->_sleep_costs[i] = sleep_record_read(i);
+        sum += this->_sleep_costs[i];
+    }
+    if (sleep_record_read(kSleepCheckWord) != ~sum) {
+        this->_sleep_costs[SLEEP_SPIN] = 0;
+        this->_sleep_costs[SLEEP_SPIN_LP] = kSleepCostSpinLp;
+        this->_sleep_costs[SLEEP_WFI] = kSleepCostWfi;
+        this->_sleep_costs[SLEEP_TIMED_SHUTDOWN] = kSleepCostShutdown;
+    }
+    // woken up from a sleep_for timed shutdown: measure its cost
+    uint32_t wake = sleep_record_read(kSleepWakeWord);
+    if (sleep_record_read(kSleepMarkerWord) == ~wake) {
+        sleep_record_write(kSleepMarkerWord, 0);
+        // (wake is when the RTC wake up was set for: the rest is boot)
+        uint32_t cost = M0N0_System::rtc_elapsed(wake);
+        if (cost <= kInttimerMaxTicks) {
+            this->_sleep_costs[SLEEP_TIMED_SHUTDOWN] = cost;
+            this->_store_sleep_costs();
+        }
+    }
+}
+
+void M0N0_System::_store_sleep_costs(void) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < SLEEP_NUM_MECHANISMS; i++) {
+        sleep_record_write(i, this->_sleep_costs[i]);
+        sum += this->_sleep_costs[i];
+    }
+    sleep_record_write(kSleepCheckWord, ~sum);
+}
+
+bool M0N0_System::_inttimer_in_use(void) {
+    return (this->spi->get_is_autosampling() || SoftTimer::is_running() || 
+            (this->_handler_pcsm_inttimer != NULL));
+}
+
+void M0N0_System::_check_inttimer_owner(Handler_Func f) {
+    // while the SoftTimers are armed, the callback is theirs (and only they 
+    // pass it): any other caller would leave their state stale
+    if (SoftTimer::is_running() && (this->_handler_pcsm_inttimer != NULL) && 
+            (this->_handler_pcsm_inttimer != f)) {
+        M0N0_System::error("Inttimer in use by SoftTimers");
+    }
+}
+
+uint32_t M0N0_System::get_sleep_cost(SLEEP_MECHANISM_t mechanism) {
+    return this->_sleep_costs[mechanism];
+}
+
+void M0N0_System::set_sleep_cost(SLEEP_MECHANISM_t mechanism, 
+        uint32_t rtc_ticks) {
+    this->_sleep_costs[mechanism] = rtc_ticks;
+    this->_store_sleep_costs();
+}
+
+void M0N0_System::characterise_sleep(void) {
+    if (this->spi->get_is_autosampling()) {
+        // (the perf is set over SPI)
+        this->log_warn("Sleep costs not measured while autosampling");
+        return;
+    }
+    const uint32_t timeout = (uint32_t)M0N0_System::ms_to_rtc(100);
+    const uint32_t wfi_ticks = (uint32_t)M0N0_System::ms_to_rtc(5);
+    uint8_t orig_perf = this->get_perf();
+    // low perf spin: the time for the perf to change there and back
+    uint32_t start = M0N0_System::get_rtc_lsbs();
+    this->set_perf(0);
+    while ((this->get_perf() != 0) && 
+            (M0N0_System::rtc_elapsed(start) < timeout)) {
+    }
+    this->set_perf(orig_perf);
+    while ((this->get_perf() != orig_perf) && 
+            (M0N0_System::rtc_elapsed(start) < timeout)) {
+    }
+    uint32_t lp_cost = M0N0_System::rtc_elapsed(start);
+    // WFI: the time beyond the inttimer interval (worst of 3)
+    uint32_t wfi_cost = 0;
+    bool inttimer_free = !this->_inttimer_in_use();
+    if (!inttimer_free) {
+        wfi_cost = this->_sleep_costs[SLEEP_WFI];
+        this->log_debug("Inttimer in use: WFI cost not measured");
+    }
+    for (uint32_t i = 0; inttimer_free && (i < 3); i++) {
+        start = M0N0_System::get_rtc_lsbs();
+        this->set_perf(0);
+        this->enable_pcsm_interrupt_timer_rtc_ticks(wfi_ticks, NULL);
+        this->clear_cpu_deepsleep();
+        __WFI();
+        M0N0_refresh_deve();
+        this->disable_pcsm_interrupt_timer();
+        this->set_perf(orig_perf);
+        while ((this->get_perf() != orig_perf) && 
+                (M0N0_System::rtc_elapsed(start) < timeout)) {
+        }
+        uint32_t elapsed = M0N0_System::rtc_elapsed(start);
+        if ((elapsed > wfi_ticks) && ((elapsed - wfi_ticks) > wfi_cost)) {
+            wfi_cost = elapsed - wfi_ticks;
+        }
+    }
+    this->_sleep_costs[SLEEP_SPIN] = 0;
+    this->_sleep_costs[SLEEP_SPIN_LP] = lp_cost;
+    this->_sleep_costs[SLEEP_WFI] = wfi_cost;
+    this->_store_sleep_costs();
+    this->log_debug("Sleep costs (rtc tks): lp %d, wfi %d, shtdwn %d",
+            lp_cost, wfi_cost, this->_sleep_costs[SLEEP_TIMED_SHUTDOWN]);
+}
+
+SLEEP_MECHANISM_t M0N0_System::plan_sleep(uint64_t rtc_ticks, 
+        SLEEP_RETENTION_t retention) {
+    if (this->spi->get_is_autosampling()) {
+        return SLEEP_SPIN; // (the perf is set over SPI)
+    }
+    int last = (retention == RETAIN_SHRAM) ? 
+            SLEEP_TIMED_SHUTDOWN : SLEEP_WFI;
+    if (this->_inttimer_in_use()) {
+        last = SLEEP_SPIN_LP; // (its owner needs INTTIMER0 and to survive)
+    }
+    for (int m = last; m > SLEEP_SPIN; m--) {
+        uint64_t cost = this->_sleep_costs[m];
+        // (the inttimer needs at least 2 ticks after the exit cost)
+        if ((rtc_ticks >= (cost * kSleepBreakEvenRatio)) && 
+                (rtc_ticks >= (cost + 2))) {
+            return (SLEEP_MECHANISM_t)m;
+        }
+    }
+    return SLEEP_SPIN;
+}
+
+SLEEP_MECHANISM_t M0N0_System::sleep_for(uint64_t rtc_ticks, 
+        SLEEP_RETENTION_t retention) {
+    uint64_t start = this->get_rtc();
+    SLEEP_MECHANISM_t mechanism = this->plan_sleep(rtc_ticks, retention);
+    // leave the exit cost to spin at the current perf
+    uint64_t deep_ticks = rtc_ticks - this->_sleep_costs[mechanism];
+    uint8_t orig_perf = this->get_perf();
+    switch (mechanism) {
+        case SLEEP_TIMED_SHUTDOWN: {
+            uint64_t wake = start + deep_ticks;
+            uint64_t now = this->get_rtc();
+            if (wake <= now) {
+                break;
+            }
+            sleep_record_write(kSleepWakeWord, (uint32_t)wake);
+            sleep_record_write(kSleepMarkerWord, ~(uint32_t)wake);
+            this->timed_shutdown(wake - now);
+            // only reached if the shutdown did not happen
+            sleep_record_write(kSleepMarkerWord, 0);
+            break;
+        }
+        case SLEEP_WFI: {
+            this->set_perf(0);
+            this->clear_cpu_deepsleep();
+            uint64_t elapsed = this->get_rtc() - start;
+            // other interrupts can wake it up early: re-arm until done
+            while ((elapsed + 2) <= deep_ticks) {
+                uint64_t interval = deep_ticks - elapsed;
+                if (interval > kInttimerMaxTicks) {
+                    interval = kInttimerMaxTicks;
+                }
+                this->enable_pcsm_interrupt_timer_rtc_ticks(
+                        (uint32_t)interval, NULL);
+                this->break_tcro_window();
+                __WFI();
+                M0N0_refresh_deve();
+                elapsed = this->get_rtc() - start;
+            }
+            this->disable_pcsm_interrupt_timer();
+            this->set_perf(orig_perf);
+            break;
+        }
+        case SLEEP_SPIN_LP: {
+            this->set_perf(0);
+            while ((this->get_rtc() - start) < deep_ticks) {
+                // wait
+            }
+            this->set_perf(orig_perf);
+            break;
+        }
+        default:
+            break;
+    }
+    while ((this->get_rtc() - start) < rtc_ticks) {
+        // wait
+    }
+    return mechanism;
+}
+
+SLEEP_MECHANISM_t M0N0_System::sleep_for_ms(uint32_t time_ms, 
+        SLEEP_RETENTION_t retention) {
+    return this->sleep_for(M0N0_System::ms_to_rtc(time_ms), retention);
+}
+
+void M0N0_System::enable_dvfs_governor(uint32_t deadline_rtc_ticks, 
+        uint32_t budget_rtc_ticks) {
+    if (budget_rtc_ticks > deadline_rtc_ticks) {
+        budget_rtc_ticks = deadline_rtc_ticks;
+    }
+    this->_dvfs_deadline = deadline_rtc_ticks;
+    this->_dvfs_budget = budget_rtc_ticks;
+    this->_dvfs_level = 15;
+    this->_dvfs_floor = 0;
+    this->_dvfs_floor_jobs = 0;
+    this->_dvfs_slack_jobs = 0;
+    this->_dvfs_in_job = false;
+    this->reset_dvfs_stats();
+    this->_dvfs_governed = true;
+}
+
+void M0N0_System::enable_dvfs_governor_ms(uint32_t deadline_ms, 
+        uint32_t budget_ms) {
+    this->enable_dvfs_governor(
+            (uint32_t)M0N0_System::ms_to_rtc(deadline_ms),
+            (uint32_t)M0N0_System::ms_to_rtc(budget_ms));
+}
+
+void M0N0_System::disable_dvfs_governor(void) {
+    this->_dvfs_governed = false;
+    this->_dvfs_in_job = false;
+}
+
+bool M0N0_System::is_dvfs_governed(void) {
+    return this->_dvfs_governed;
+}
+
+void M0N0_System::begin_dvfs_job(void) {
+    if (!this->spi->get_is_autosampling()) {
+        this->set_perf(this->_dvfs_level);
+    }
+    this->_dvfs_in_job = true;
+    this->_dvfs_job_start = M0N0_System::get_rtc_lsbs();
+}
+
+bool M0N0_System::end_dvfs_job(void) {
+    uint32_t elapsed = M0N0_System::rtc_elapsed(this->_dvfs_job_start);
+    if (!this->_dvfs_in_job) {
+        return true;
+    }
+    this->_dvfs_in_job = false;
+    // (the perf the job ran at: set_perf is not applied while autosampling)
+    uint8_t ran = this->get_perf();
+    bool missed = (elapsed > this->_dvfs_deadline);
+    this->_dvfs_jobs[ran]++;
+    if (missed) {
+        this->_dvfs_misses[ran]++;
+    } else if (elapsed > this->_dvfs_budget) {
+        this->_dvfs_overruns[ran]++;
+    }
+    if (this->spi->get_is_autosampling()) {
+        // the level cannot be applied: hold it
+        this->_dvfs_slack_jobs = 0;
+        return !missed;
+    }
+    uint8_t level = this->_dvfs_level;
+    if ((this->_dvfs_floor_jobs > 0) && (--this->_dvfs_floor_jobs == 0)) {
+        this->_dvfs_floor = 0;
+    }
+    if (missed) {
+        // missed: back to the maximum, and hold above the level that missed
+        if (level < 15) {
+            this->_dvfs_floor = level + 1;
+            this->_dvfs_floor_jobs = kDvfsHoldJobs;
+        }
+        this->_dvfs_level = 15;
+        this->_dvfs_slack_jobs = 0;
+        return false;
+    }
+    if (elapsed > this->_dvfs_budget) {
+        if (level < 15) {
+            this->_dvfs_level = level + 1;
+        }
+        this->_dvfs_slack_jobs = 0;
+    } else if (((uint64_t)elapsed * 100) < 
+            ((uint64_t)this->_dvfs_budget * kDvfsStepDownPct)) {
+        if ((++this->_dvfs_slack_jobs >= kDvfsStepDownJobs) && 
+                (level > this->_dvfs_floor)) {
+            this->_dvfs_level = level - 1;
+            this->_dvfs_slack_jobs = 0;
+        }
+    } else {
+        this->_dvfs_slack_jobs = 0;
+    }
+    return true;
+}
+
+uint8_t M0N0_System::get_dvfs_level(void) {
+    return this->_dvfs_level;
+}
+
+uint32_t M0N0_System::get_dvfs_jobs(uint8_t perf) {
+    return this->_dvfs_jobs[perf & 0xF];
+}
+
+uint32_t M0N0_System::get_dvfs_misses(uint8_t perf) {
+    return this->_dvfs_misses[perf & 0xF];
+}
+
+void M0N0_System::reset_dvfs_stats(void) {
+    for (uint32_t i = 0; i < 16; i++) {
+        this->_dvfs_jobs[i] = 0;
+        this->_dvfs_overruns[i] = 0;
+        this->_dvfs_misses[i] = 0;
+    }
+}
+
+void M0N0_System::print_dvfs_stats(void) {
+    this->log_info("DVFS governor (deadline %d, budget %d rtc tks), level %d",
+            this->_dvfs_deadline, this->_dvfs_budget, this->_dvfs_level);
+    for (uint32_t i = 0; i < 16; i++) {
+        if (this->_dvfs_jobs[i] > 0) {
+            this->log_info("Perf %d: jobs %d, over budget %d, missed %d", i,
+                    this->_dvfs_jobs[i], this->_dvfs_overruns[i], 
+                    this->_dvfs_misses[i]);
+        }
+    }
+}
+
 void M0N0_System::generate_hardfault(void) {
     this->log_debug("Generating hard fault");
     SCB->CCR |= 0x10;
@@ -624,16 +1174,16 @@ void M0N0_System::generate_hardfault(void) {
 
 uint32_t M0N0_System::estimate_tcro(void) {
     uint64_t ticks = 10000000;
-    uint64_t wait_rtcs = 10*kRtcOneMsTicks; // 10 ms
+    uint32_t wait_rtcs = (uint32_t)M0N0_System::ms_to_rtc(10); // 10 ms
     this->disable_systick();
     SysTick->CTRL = 0; 
     SysTick->VAL = ticks; /* Load the SysTick Counter Value */
     SysTick->LOAD = ticks; /* Load the SysTick Counter Value */
-    uint64_t rtc_start = this->get_rtc();
+    uint32_t rtc_start = M0N0_System::get_rtc_lsbs();
     SysTick->CTRL = (0   |  // no interrupt
                      SysTick_CTRL_ENABLE_Msk) |
                      SysTick_CTRL_CLKSOURCE_Msk;
-    while (this->get_rtc() < (rtc_start + wait_rtcs))  {
+    while (M0N0_System::rtc_elapsed(rtc_start) < wait_rtcs)  {
         // wait
     }
     uint64_t elapsed_ticks = ticks - SysTick->VAL;
@@ -642,8 +1192,165 @@ uint32_t M0N0_System::estimate_tcro(void) {
     return ((elapsed_ticks * 100)/1000);
 }
 
+static uint32_t perf_freq_read(uint32_t word) {
+    return M0N0_read(MEM_MAP_SHRAM_BASE + M0N0_PERF_FREQ_SHRAM_ADDR 
+            + (word * 4));
+}
+
+static void perf_freq_write(uint32_t word, uint32_t value) {
+    M0N0_write(MEM_MAP_SHRAM_BASE + M0N0_PERF_FREQ_SHRAM_ADDR 
+            + (word * 4), value);
+}
+
+void M0N0_System::_load_perf_freqs(void) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        this->_perf_freq_khz[i] = perf_freq_read(i);
+        sum += this->_perf_freq_khz[i];
+    }
+    if ((perf_freq_read(16) != (kPerfFreqTag ^ sum)) || (sum == 0)) {
+        for (uint32_t i = 0; i < 16; i++) {
+            this->_perf_freq_khz[i] = 0;
+        }
+    }
+}
+
+void M0N0_System::_update_core_clock(uint8_t perf) {
+    uint32_t freq_khz = this->_perf_freq_khz[perf & 0xF];
+    if (freq_khz != 0) {
+        SystemCoreClock = freq_khz * 1000;
+    }
+}
+
+void M0N0_System::characterise_perf_freqs(void) {
+    const uint32_t timeout = (uint32_t)M0N0_System::ms_to_rtc(100);
+    const uint32_t settle = (uint32_t)M0N0_System::ms_to_rtc(kPerfSettleMs);
+    uint8_t orig_perf = this->get_perf();
+    uint32_t sum = 0;
+    for (uint8_t perf = 0; perf < 16; perf++) {
+        this->set_perf(perf);
+        uint32_t start = M0N0_System::get_rtc_lsbs();
+        while ((this->get_perf() != perf) && 
+                (M0N0_System::rtc_elapsed(start) < timeout)) {
+        }
+        start = M0N0_System::get_rtc_lsbs();
+        while (M0N0_System::rtc_elapsed(start) < settle) {
+        }
+        uint32_t freq_khz = this->estimate_tcro();
+        this->_perf_freq_khz[perf] = freq_khz;
+        perf_freq_write(perf, freq_khz);
+        sum += freq_khz;
+        this->log_debug("Perf %d: %d kHz", perf, freq_khz);
+    }
+    perf_freq_write(16, kPerfFreqTag ^ sum);
+    this->set_perf(orig_perf);
+}
+
+bool M0N0_System::is_perf_freq_characterised(void) {
+    return (this->_perf_freq_khz[15] != 0);
+}
+
+uint32_t M0N0_System::get_perf_freq_khz(uint8_t perf) {
+    return this->_perf_freq_khz[perf & 0xF];
+}
+
+void M0N0_System::enable_tcro_tracking(void) {
+    M0N0_cyccnt_enable();
+    this->reset_tcro_tracking();
+    this->_tcro_tracking = true;
+    this->_bind_irq_callbacks();
+}
+
+void M0N0_System::disable_tcro_tracking(void) {
+    this->_tcro_tracking = false;
+    this->_bind_irq_callbacks();
+}
+
+void M0N0_System::reset_tcro_tracking(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    this->_tcro_anchored = false;
+    this->_tcro_segments = 0;
+    this->_tcro_total_rtc = 0;
+    this->_tcro_total_cycles = 0;
+    __set_PRIMASK(primask);
+}
+
+void M0N0_System::break_tcro_window(void) {
+    this->_tcro_anchored = false;
+}
+
+void M0N0_System::sample_tcro(void) {
+    if (!this->_tcro_tracking) {
+        return;
+    }
+    uint32_t cycles_now = DWT->CYCCNT;
+    uint32_t rtc_now = M0N0_System::get_rtc_lsbs();
+    if (!this->_tcro_anchored) {
+        this->_tcro_anchor_cycles = cycles_now;
+        this->_tcro_anchor_rtc = rtc_now;
+        this->_tcro_anchored = true;
+        this->_tcro_chained = false;
+        return;
+    }
+    uint32_t ticks = rtc_now - this->_tcro_anchor_rtc;
+    if (ticks < kTcroMinWindowTicks) {
+        return; // (extended to the next sample)
+    }
+    uint32_t cycles = cycles_now - this->_tcro_anchor_cycles;
+    this->_tcro_anchor_cycles = cycles_now;
+    this->_tcro_anchor_rtc = rtc_now;
+    if ((ticks > kTcroMaxWindowTicks) || 
+            (cycles > ((uint64_t)ticks * kTcroMaxCyclesPerTick)) || 
+            ((this->_tcro_total_rtc >= kTcroMinWindowTicks) && 
+            (((uint64_t)cycles * this->_tcro_total_rtc * 100) < 
+            (this->_tcro_total_cycles * ticks * kTcroRejectPct)))) {
+        this->_tcro_chained = false; // (the core slept in the window)
+        return;
+    }
+    if (!this->_tcro_chained) {
+        this->_tcro_segments++;
+        this->_tcro_chained = true;
+    }
+    this->_tcro_total_cycles += cycles;
+    this->_tcro_total_rtc += ticks;
+    while (this->_tcro_total_rtc > kTcroHistoryTicks) {
+        this->_tcro_total_cycles >>= 1;
+        this->_tcro_total_rtc >>= 1;
+        this->_tcro_segments = (this->_tcro_segments + 1) >> 1;
+    }
+}
+
+uint32_t M0N0_System::get_tcro_khz(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t total_cycles = this->_tcro_total_cycles;
+    uint32_t total_rtc = this->_tcro_total_rtc;
+    __set_PRIMASK(primask);
+    if (total_rtc == 0) {
+        return 0;
+    }
+    // cycles per RTC tick * RTC frequency (mHz) / 1000000
+    return (uint32_t)((total_cycles * M0N0_System::get_rtc_calibration()) 
+            / ((uint64_t)total_rtc * 1000000));
+}
+
+uint32_t M0N0_System::get_tcro_error_ppm(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t segments = this->_tcro_segments;
+    uint32_t total_rtc = this->_tcro_total_rtc;
+    __set_PRIMASK(primask);
+    if ((total_rtc == 0) || (segments >= total_rtc)) {
+        return 1000000;
+    }
+    // each unbroken run of windows is +/- 1 RTC tick
+    return (uint32_t)(((uint64_t)segments * 1000000) / total_rtc);
+}
+
 void M0N0_System::enable_systick(uint32_t ticks, Handler_Func f) {
     this->_handler_systick = f;
+    this->_bind_irq_callbacks();
     __NVIC_EnableIRQ(SysTick_IRQn);
     this->_enable_systick(ticks);
 }
@@ -652,8 +1359,53 @@ void M0N0_System::disable_systick(void) {
     SysTick->CTRL = 0; 
     __NVIC_DisableIRQ(SysTick_IRQn);
     this->_handler_systick = NULL;
+    this->_bind_irq_callbacks();
+}
+
+#ifdef M0N0_PC_SAMPLE
+#ifndef M0N0_HOST
+extern "C" uint32_t __etext; // (linker script) end of the code
+#endif
+
+void M0N0_System::start_pc_sampling(uint32_t period_cycles) {
+#ifdef M0N0_HOST
+    uint32_t code_size = 0x20000; // (FLASH)
+#else
+    uint32_t code_size = (uint32_t)(uintptr_t)&__etext;
+#endif
+    M0N0_pc_sample_start(0, code_size);
+    if (!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk)) {
+        if (period_cycles < kPcSampleMinCycles) {
+            period_cycles = kPcSampleMinCycles;
+        } else if (period_cycles > (SysTick_LOAD_RELOAD_Msk + 1)) {
+            period_cycles = SysTick_LOAD_RELOAD_Msk + 1; // (24-bit)
+        }
+        this->enable_systick(period_cycles - 1, 
+                &M0N0_System::_pc_sample_tick);
+        this->_pc_sample_owns_systick = true;
+    }
+    this->log_debug("PC sampling: %d cycles", SysTick->LOAD + 1);
 }
 
+void M0N0_System::stop_pc_sampling(void) {
+    M0N0_pc_sample_stop();
+    // (unless enable_systick has since set another callback)
+    if (this->_pc_sample_owns_systick && 
+            (this->_handler_systick == &M0N0_System::_pc_sample_tick)) {
+        this->disable_systick();
+    }
+    this->_pc_sample_owns_systick = false;
+}
+
+void M0N0_System::send_pc_samples_via_adp(void) {
+    this->adp_tx_start("pc_samples");
+    M0N0_pc_sample_print_params();
+    this->adp_tx_end_of_params();
+    M0N0_pc_sample_print_rows();
+    this->adp_tx_end();
+}
+#endif
+
 void M0N0_System::_set_inttimer(uint32_t rtc_ticks) {
     if (rtc_ticks == 0) {
         this->spi->pcsm_write(PCSM_INTTIMER0_REG, 0);
@@ -665,31 +1417,46 @@ void M0N0_System::_set_inttimer(uint32_t rtc_ticks) {
 }
 
 void M0N0_System::enable_pcsm_interrupt_timer_ms(uint32_t interval_ms, Handler_Func f) {
+#ifdef EXTRA_CHECKS
+    this->_check_inttimer_owner(f);
+#endif
     this->_handler_pcsm_inttimer = f;
-    this->_set_inttimer(interval_ms * kRtcOneMsTicks);
+    this->_bind_irq_callbacks();
+    this->_set_inttimer((uint32_t)M0N0_System::ms_to_rtc(interval_ms));
     __NVIC_EnableIRQ(Interrupt5_IRQn);
 }
 
 void M0N0_System::enable_pcsm_interrupt_timer_rtc_ticks(uint32_t rtc_ticks, Handler_Func f) {
+#ifdef EXTRA_CHECKS
+    this->_check_inttimer_owner(f);
+#endif
     this->_handler_pcsm_inttimer = f;
+    this->_bind_irq_callbacks();
     this->_set_inttimer(rtc_ticks);
     __NVIC_EnableIRQ(Interrupt5_IRQn);
 }
 
 void M0N0_System::disable_pcsm_interrupt_timer(void) {
+#ifdef EXTRA_CHECKS
+    this->_check_inttimer_owner(NULL);
+#endif
     __NVIC_DisableIRQ(Interrupt5_IRQn);
     this->_set_inttimer(0);
+    this->_handler_pcsm_inttimer = NULL;
+    this->_bind_irq_callbacks();
 }
 
 void M0N0_System::enable_autosampling_ms(uint32_t interval_ms, Handler_Func f) {
     this->_handler_autosample = f;
-    this->_set_inttimer(interval_ms * kRtcOneMsTicks);
+    this->_bind_irq_callbacks();
+    this->_set_inttimer((uint32_t)M0N0_System::ms_to_rtc(interval_ms));
     this->spi->enable_autosampling();
     __NVIC_EnableIRQ(Interrupt1_IRQn);
 }
 
 void M0N0_System::enable_autosampling_rtc_ticks(uint32_t rtc_ticks, Handler_Func f) {
     this->_handler_autosample = f;
+    this->_bind_irq_callbacks();
     if (rtc_ticks < 2) {
         M0N0_System::error("inttimer0 RTC ticks bust be >= 2");    
     }
@@ -700,6 +1467,7 @@ void M0N0_System::enable_autosampling_rtc_ticks(uint32_t rtc_ticks, Handler_Func
 
 void M0N0_System::disable_autosampling_wait(void) {
     this->autosample_disable_flag = true;
+    this->_bind_irq_callbacks();
     this->log_debug("Disabling autosampling, waiting for next IQR...");
     while (this->autosample_disable_flag) {
         //__WFI;
@@ -740,5 +1508,23 @@ void M0N0_System::adp_tx_end(void) {
     this->print(this->_adp_tx_name);
     this->print(">>\n");
     this->log_info("Ended transaction");
+    M0N0_flush_stdout(); // (the transaction is complete when it is sent)
+}
+
+void M0N0_System::send_profile_via_adp(void) {
+    uint32_t regions = 0;
+#ifdef M0N0_PROFILE
+    while (M0N0_profile_get_region(regions) != NULL) {
+        regions++;
+    }
+#endif
+    this->adp_tx_start("profile");
+    this->print("\nregions : %d", regions);
+    this->print("\nrtc_freq_millihz : %d", this->get_rtc_calibration());
+    this->adp_tx_end_of_params();
+#ifdef M0N0_PROFILE
+    M0N0_profile_print_rows();
+#endif
+    this->adp_tx_end();
 }
 
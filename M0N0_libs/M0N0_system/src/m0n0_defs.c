@@ -26,12 +26,32 @@
  * 
  */
 #include "m0n0_defs.h"
+#if defined(M0N0_PROFILE) || defined(M0N0_PC_SAMPLE)
+#include <string.h>
+#include "m0n0_printf.h"
+#endif
+
+#ifdef M0N0_HOST
+static Read_Driver_Func host_read_driver = 0;
+static Write_Driver_Func host_write_driver = 0;
+
+void M0N0_set_host_drivers(
+        Read_Driver_Func read_driver,
+        Write_Driver_Func write_driver) {
+    host_read_driver = read_driver;
+    host_write_driver = write_driver;
+}
+#endif
 
 uint32_t M0N0_read(uint32_t address) {
+#ifdef M0N0_HOST
+    return host_read_driver(address);
+#else
     volatile uint32_t val = 0;
     volatile uint32_t *a = (uint32_t*) address;
     val = *a;
     return val;
+#endif
 }
 
 uint32_t M0N0_read_bit_group(
@@ -54,7 +74,11 @@ uint32_t M0N0_read_mask_and_shift(
 }
 
 void M0N0_write(uint32_t address, uint32_t data) {
+#ifdef M0N0_HOST
+    host_write_driver(address, data);
+#else
     *((__IO uint32_t *)(address)) = data;
+#endif
 }
 
 void M0N0_write_bit_group(
@@ -75,10 +99,35 @@ void M0N0_write_mask_and_shift(
         uint32_t shift,
         uint32_t mask,
         uint32_t data) {
+    // single-bit writes use the set/clear aliases (single store) if supported
+    if (M0N0_HAS_SET_CLR_ALIAS(address) && ((mask & (mask - 1)) == 0)) {
+        if ((data << shift) & mask) {
+            M0N0_write(address + CONTROL_SET_OFFSET, mask);
+        } else {
+            M0N0_write(address + CONTROL_CLR_OFFSET, mask);
+        }
+        return;
+    }
     uint32_t reg = M0N0_read(address) & ~(mask);
     M0N0_write(address,reg | ((data << shift) & mask));
 }
 
+void M0N0_set_bits(uint32_t address, uint32_t mask) {
+    if (M0N0_HAS_SET_CLR_ALIAS(address)) {
+        M0N0_write(address + CONTROL_SET_OFFSET, mask);
+    } else {
+        M0N0_write(address, M0N0_read(address) | mask);
+    }
+}
+
+void M0N0_clear_bits(uint32_t address, uint32_t mask) {
+    if (M0N0_HAS_SET_CLR_ALIAS(address)) {
+        M0N0_write(address + CONTROL_CLR_OFFSET, mask);
+    } else {
+        M0N0_write(address, M0N0_read(address) & ~mask);
+    }
+}
+
 uint8_t mask_to_shift(uint32_t mask) {
     static const uint32_t lookup[] = {
       32, 0, 1, 26, 2, 23, 27, 0, 3, 16, 24, 30, 28, 11, 0, 13, 4,
@@ -96,29 +145,150 @@ char M0N0_read_stdin(void) {
     return c; // read char
 }
 
+// cached DEVE state (-1: not read since reset)
+static volatile int8_t deve_state = -1;
+
 uint8_t M0N0_is_deve(void) {
-    return M0N0_read_bit_group(
-            STATUS_STATUS_7_REG,
-            STATUS_R07_DEVE_CORE_BIT_MASK);
+    if (deve_state < 0) {
+        return M0N0_refresh_deve();
+    }
+    return (uint8_t)deve_state;
+}
+
+uint8_t M0N0_refresh_deve(void) {
+    // shift is known at compile time (avoids mask_to_shift)
+    uint8_t deve = (M0N0_read_direct(STATUS_STATUS_7_REG) 
+            & STATUS_R07_DEVE_CORE_BIT_MASK) >> STATUS_R07_DEVE_CORE_BIT_SHIFT;
+    deve_state = (int8_t)deve;
+    return deve;
+}
+
+#ifdef M0N0_STDOUT_BUFFERED
+#if (M0N0_STDOUT_QUEUE_SIZE & (M0N0_STDOUT_QUEUE_SIZE - 1)) != 0
+#error "M0N0_STDOUT_QUEUE_SIZE must be a power of 2"
+#endif
+// STDOUT queue (drained into the STDOUT FIFO by the STDOUT interrupt)
+static volatile uint8_t stdout_queue[M0N0_STDOUT_QUEUE_SIZE];
+static volatile uint32_t stdout_head = 0; // total characters queued
+static volatile uint32_t stdout_tail = 0; // total characters sent
+// set once the STDOUT interrupt handler has run: until then, waits poll the
+// FIFO rather than WFI (in case M0N0_STDOUT_IRQ_NUM is not the STDOUT line)
+static volatile uint8_t stdout_irq_seen = 0;
+
+// Moves characters from the queue to the FIFO until either is full/empty.
+// The interrupt is only enabled while there are characters left to send.
+// Must be called with interrupts masked (or from the handler).
+static void stdout_fill_fifo(void) {
+    uint32_t tail = stdout_tail;
+    while ((tail != stdout_head) && 
+            !(M0N0_read_direct(STDOUT_STATUS_REG) & STDOUT_R02_TXF_BIT_MASK)) {
+        M0N0_write_direct(
+                STDOUT_WDATA_REG, 
+                stdout_queue[tail % M0N0_STDOUT_QUEUE_SIZE]);
+        tail++;
+    }
+    stdout_tail = tail;
+    M0N0_write_direct(STDOUT_INT_CTRL_REG, (tail != stdout_head) ? 
+            STDOUT_R03_INTERRUPT_ENABLE_BIT_MASK : 0);
+}
+
+void M0N0_stdout_irq_handler(void) {
+    stdout_irq_seen = 1;
+    stdout_fill_fifo();
+}
+
+// Waits for the handler to send characters (interrupts are masked on entry
+// and exit). Polls if the handler cannot run (interrupts are masked or 
+// called from a handler) or has not yet been seen to run.
+static void stdout_wait(uint32_t primask) {
+    if (primask || __get_IPSR()) {
+        stdout_fill_fifo();
+    } else if (!stdout_irq_seen) {
+        stdout_fill_fifo();
+        __enable_irq(); // (lets the handler run, if it is the STDOUT line)
+        __disable_irq();
+    } else {
+        __WFI(); // wakes on the (pending) STDOUT interrupt
+        __enable_irq(); // handler runs here
+        __disable_irq();
+    }
+}
+
+// the STDOUT interrupt handler (e.g. Interrupt2_Handler)
+#define STDOUT_HANDLER_NAME_(num) Interrupt ## num ## _Handler
+#define STDOUT_HANDLER_NAME(num) STDOUT_HANDLER_NAME_(num)
+void STDOUT_HANDLER_NAME(M0N0_STDOUT_IRQ_NUM)(void) {
+    M0N0_stdout_irq_handler();
 }
 
 void M0N0_write_stdout(uint8_t data) {
-    //exectb_mcu_char_write(data);
-    //return;
-    while (M0N0_read_mask_and_shift(
-            STDOUT_STATUS_REG,
-            STDOUT_R02_TXF_BIT_SHIFT,
-            STDOUT_R02_TXF_BIT_MASK) != 0);
-    while ((STDOUT->STAT & 0x2) != 0); // wait until space in fifo
-    M0N0_write_mask_and_shift(
-            STDOUT_WDATA_REG,
-            STDOUT_WRITE_CHAR_BIT_SHIFT,
-            STDOUT_WRITE_CHAR_BIT_MASK,
-             data); // Write char
-    return;
+    M0N0_write_stdout_buf((const char*)&data, 1);
 }
 
+void M0N0_write_stdout_buf(const char *data, uint32_t len) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    while (len) {
+        uint32_t head = stdout_head;
+        uint32_t space = M0N0_STDOUT_QUEUE_SIZE - (head - stdout_tail);
+        if (space == 0) {
+            stdout_wait(primask);
+            continue;
+        }
+        uint32_t was_empty = (head == stdout_tail);
+        if (space > len) {
+            space = len;
+        }
+        len -= space;
+        while (space--) {
+            stdout_queue[head % M0N0_STDOUT_QUEUE_SIZE] = *data++;
+            head++;
+        }
+        stdout_head = head;
+        if (was_empty) {
+            // queue was empty (interrupt disabled): start sending
+            __NVIC_EnableIRQ((IRQn_Type)M0N0_STDOUT_IRQ_NUM);
+            stdout_fill_fifo();
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+void M0N0_flush_stdout(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    while (stdout_head != stdout_tail) {
+        stdout_wait(primask);
+    }
+    __set_PRIMASK(primask);
+}
+#else
+void M0N0_write_stdout(uint8_t data) {
+    while (M0N0_read_direct(STDOUT_STATUS_REG) & STDOUT_R02_TXF_BIT_MASK) {
+        // wait until space in fifo
+    }
+    M0N0_write_direct(STDOUT_WDATA_REG, data); // upper bits are WAZ
+}
+
+void M0N0_write_stdout_buf(const char *data, uint32_t len) {
+    // one loop for the whole buffer (WDATA takes a single character and the
+    // FIFO only flags full, so the status is still read per character)
+    while (len) {
+        if (M0N0_read_direct(STDOUT_STATUS_REG) & STDOUT_R02_TXF_BIT_MASK) {
+            continue; // wait until space in fifo
+        }
+        M0N0_write_direct(STDOUT_WDATA_REG, (uint8_t)*data++);
+        len--;
+    }
+}
+
+void M0N0_flush_stdout(void) {
+    // nothing buffered
+}
+#endif
+
 
+#ifndef M0N0_HOST
 // Routine to write a char - specific to ADP STDOUT FIFO
 void exectb_mcu_char_write(int ch)
 {
@@ -133,6 +303,280 @@ int exectb_mcu_char_read(void)
     while ((STDIN->STAT & 0x1) != 0); // wait until fifo non-empty
     return (int)(STDIN->RDATA); // read char
 }
+#endif
+
+// raw perf HW ID (16-31) to DVFS level (0-15)
+static const uint8_t perf_level_lookup[32] = {
+    128, 128, 128, 128, // 0-3
+    128, 128, 128, 128, // 4-7
+    128, 128, 128, 128, // 8-11
+    128, 128, 128, 128, // 12-15
+    7  , 12 , 14 , 15 , // 16-19
+    3  , 9  , 11 , 13 , // 20-23
+    1  , 5  , 8  , 10 , // 24-27
+    0  , 2  , 4  , 6  };// 28-31
+
+uint8_t M0N0_perf_level(uint8_t raw_perf) {
+    return perf_level_lookup[raw_perf & 0x1F];
+}
+
+uint32_t M0N0_read_rtc_calibration(void) {
+    uint32_t freq = M0N0_read(MEM_MAP_SHRAM_BASE + M0N0_RTC_CAL_SHRAM_ADDR);
+    uint32_t check = M0N0_read(
+            MEM_MAP_SHRAM_BASE + M0N0_RTC_CAL_SHRAM_ADDR + 4);
+    // (stored with its complement: SHRAM is not initialised at power-on)
+    return (freq == ~check) ? freq : 0;
+}
+
+void M0N0_cyccnt_enable(void) {
+#ifndef M0N0_HOST
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+#ifdef M0N0_PROFILE
+static M0N0_Profile_Region profile_regions[M0N0_PROFILE_REGIONS];
+static uint32_t profile_num_regions = 0;
+
+static inline uint32_t profile_cycles(void) {
+#ifdef M0N0_HOST
+    return m0n0_host_cyccnt_read();
+#else
+    return DWT->CYCCNT;
+#endif
+}
+
+static uint32_t profile_add_region(const char* name) {
+    for (uint32_t i = 0; i < profile_num_regions; i++) {
+        if (strcmp(profile_regions[i].name, name) == 0) {
+            return i; // (the same name used in another function)
+        }
+    }
+    if (profile_num_regions == 0) {
+        M0N0_cyccnt_enable();
+    }
+    if (profile_num_regions >= M0N0_PROFILE_REGIONS) {
+        return M0N0_PROFILE_UNREGISTERED; // table full: not recorded
+    }
+    profile_regions[profile_num_regions].name = name;
+    return profile_num_regions++;
+}
+
+static void profile_clear_region(M0N0_Profile_Region* region) {
+    region->count = 0;
+    region->cycles_min = 0xFFFFFFFF;
+    region->cycles_max = 0;
+    region->cycles_total = 0;
+    region->rtc_min = 0xFFFFFFFF;
+    region->rtc_max = 0;
+    region->rtc_total = 0;
+    region->perf_min = 0xFF;
+    region->perf_max = 0;
+}
+
+void M0N0_profile_begin(M0N0_Profile_Mark* mark, uint32_t* slot,
+        const char* name) {
+    if (*slot == M0N0_PROFILE_UNREGISTERED) {
+        *slot = profile_add_region(name);
+        if (*slot != M0N0_PROFILE_UNREGISTERED) {
+            profile_clear_region(&profile_regions[*slot]);
+        }
+    }
+    mark->region = *slot;
+    // (read last, so the overhead above is not counted)
+    mark->rtc = M0N0_read_direct(STATUS_STATUS_2_REG);
+    mark->cycles = profile_cycles();
+}
+
+void M0N0_profile_end(const M0N0_Profile_Mark* mark) {
+    // (read first)
+    uint32_t cycles = profile_cycles() - mark->cycles;
+    uint32_t rtc = M0N0_read_direct(STATUS_STATUS_2_REG) - mark->rtc;
+    if (mark->region == M0N0_PROFILE_UNREGISTERED) {
+        return;
+    }
+    uint8_t perf = M0N0_perf_level((uint8_t)(
+            (M0N0_read_direct(STATUS_STATUS_7_REG) & STATUS_R07_PERF_BIT_MASK)
+            >> STATUS_R07_PERF_BIT_SHIFT));
+    M0N0_Profile_Region* region = &profile_regions[mark->region];
+    region->count++;
+    if (cycles < region->cycles_min) {
+        region->cycles_min = cycles;
+    }
+    if (cycles > region->cycles_max) {
+        region->cycles_max = cycles;
+    }
+    region->cycles_total += cycles;
+    if (rtc < region->rtc_min) {
+        region->rtc_min = rtc;
+    }
+    if (rtc > region->rtc_max) {
+        region->rtc_max = rtc;
+    }
+    region->rtc_total += rtc;
+    if (perf < region->perf_min) {
+        region->perf_min = perf;
+    }
+    if (perf > region->perf_max) {
+        region->perf_max = perf;
+    }
+}
+
+const M0N0_Profile_Region* M0N0_profile_get_region(uint32_t index) {
+    if (index >= profile_num_regions) {
+        return NULL;
+    }
+    return &profile_regions[index];
+}
+
+void M0N0_profile_reset(void) {
+    for (uint32_t i = 0; i < profile_num_regions; i++) {
+        profile_clear_region(&profile_regions[i]);
+    }
+}
+
+void M0N0_profile_print_rows(void) {
+    for (uint32_t i = 0; i < profile_num_regions; i++) {
+        const M0N0_Profile_Region* r = &profile_regions[i];
+        if (r->count == 0) {
+            continue;
+        }
+        M0N0_PRINTF_ENABLED("\n%s %u %u %u %llu %u %u %u %u %u", r->name,
+                r->count, r->cycles_min, r->cycles_max, r->cycles_total,
+                r->rtc_min, r->rtc_max, r->rtc_total, 
+                r->perf_min, r->perf_max);
+    }
+}
+
+void M0N0_profile_send_via_adp(void) {
+    M0N0_PRINTF_ENABLED("\n" ADP_COMMAND_ID "_tx_start<<profile>>");
+    uint32_t rtc_freq_millihz = M0N0_read_rtc_calibration();
+    M0N0_PRINTF_ENABLED("\nregions : %u", profile_num_regions);
+    M0N0_PRINTF_ENABLED("\nrtc_freq_millihz : %u", 
+            rtc_freq_millihz ? rtc_freq_millihz : M0N0_RTC_FREQ_MILLIHZ);
+    M0N0_PRINTF_ENABLED("\n" ADP_COMMAND_ID "_params_end");
+    M0N0_profile_print_rows();
+    M0N0_PRINTF_ENABLED("\n" ADP_COMMAND_ID "_tx_end<<profile>>\n");
+    M0N0_flush_stdout();
+}
+#endif // M0N0_PROFILE
+
+#ifdef M0N0_PC_SAMPLE
+static uint16_t pc_sample_bins[M0N0_PC_SAMPLE_BINS];
+static M0N0_PC_Sample_Stats pc_sample_stats;
+static volatile uint8_t pc_sample_running = 0;
+static uint32_t pc_sample_last_cycles;
+
+static inline uint32_t pc_sample_cycles(void) {
+#ifdef M0N0_HOST
+    return m0n0_host_cyccnt_read();
+#else
+    return DWT->CYCCNT;
+#endif
+}
+
+void M0N0_pc_sample_start(uint32_t base, uint32_t size) {
+    pc_sample_running = 0;
+    memset(pc_sample_bins, 0, sizeof(pc_sample_bins));
+    memset(&pc_sample_stats, 0, sizeof(pc_sample_stats));
+    pc_sample_stats.base = base;
+    while ((pc_sample_stats.shift < 31) && 
+            (((size - 1) >> pc_sample_stats.shift) >= M0N0_PC_SAMPLE_BINS)) {
+        pc_sample_stats.shift++;
+    }
+    pc_sample_stats.shift = (pc_sample_stats.shift < 1) ? 
+            1 : pc_sample_stats.shift; // (Thumb: 2-byte aligned)
+    M0N0_cyccnt_enable();
+    pc_sample_running = 1;
+}
+
+void M0N0_pc_sample_stop(void) {
+    pc_sample_running = 0;
+}
+
+uint8_t M0N0_pc_sample_is_running(void) {
+    return pc_sample_running;
+}
+
+void M0N0_pc_sample(uint32_t pc) {
+    uint32_t start = pc_sample_cycles();
+    if (!pc_sample_running) {
+        pc_sample_last_cycles = start; // (the paused time is not counted)
+        return;
+    }
+    M0N0_PC_Sample_Stats* stats = &pc_sample_stats;
+    if (stats->samples != 0) {
+        stats->elapsed_cycles += start - pc_sample_last_cycles;
+    }
+    pc_sample_last_cycles = start;
+    stats->samples++;
+    uint32_t bin = (pc - stats->base) >> stats->shift; // (wraps if < base)
+    if (bin < M0N0_PC_SAMPLE_BINS) {
+        if (pc_sample_bins[bin] != 0xFFFF) {
+            pc_sample_bins[bin]++;
+        }
+    } else {
+        stats->out_of_range++;
+    }
+    uint32_t cycles = pc_sample_cycles() - start;
+    if (cycles > stats->isr_cycles_max) {
+        stats->isr_cycles_max = cycles;
+    }
+    stats->isr_cycles_total += cycles;
+}
+
+const M0N0_PC_Sample_Stats* M0N0_pc_sample_get_stats(void) {
+    return &pc_sample_stats;
+}
+
+const uint16_t* M0N0_pc_sample_get_bins(void) {
+    return pc_sample_bins;
+}
+
+uint32_t M0N0_pc_sample_overhead_ppm(void) {
+    if (pc_sample_stats.elapsed_cycles == 0) {
+        return 0;
+    }
+    return (uint32_t)((pc_sample_stats.isr_cycles_total * 1000000) / 
+            pc_sample_stats.elapsed_cycles);
+}
+
+void M0N0_pc_sample_print_params(void) {
+    const M0N0_PC_Sample_Stats* s = &pc_sample_stats;
+    M0N0_PRINTF_ENABLED("\nbase : 0x%08X", s->base);
+    M0N0_PRINTF_ENABLED("\nbin_size : %u", 1u << s->shift);
+    M0N0_PRINTF_ENABLED("\nperiod_cycles : %u", SysTick->LOAD + 1);
+    M0N0_PRINTF_ENABLED("\nsamples : %u", s->samples);
+    M0N0_PRINTF_ENABLED("\nout_of_range : %u", s->out_of_range);
+    M0N0_PRINTF_ENABLED("\nisr_cycles_max : %u", s->isr_cycles_max);
+    M0N0_PRINTF_ENABLED("\nisr_cycles_total : %llu", s->isr_cycles_total);
+    M0N0_PRINTF_ENABLED("\nelapsed_cycles : %llu", s->elapsed_cycles);
+    M0N0_PRINTF_ENABLED("\noverhead_ppm : %u", M0N0_pc_sample_overhead_ppm());
+}
+
+void M0N0_pc_sample_print_rows(void) {
+    for (uint32_t i = 0; i < M0N0_PC_SAMPLE_BINS; i++) {
+        if (pc_sample_bins[i] != 0) {
+            M0N0_PRINTF_ENABLED("\n0x%08X %u", 
+                    pc_sample_stats.base + (i << pc_sample_stats.shift),
+                    pc_sample_bins[i]);
+        }
+    }
+}
+
+void M0N0_pc_sample_send_via_adp(void) {
+    uint8_t running = pc_sample_running;
+    pc_sample_running = 0; // (consistent counts)
+    M0N0_PRINTF_ENABLED("\n" ADP_COMMAND_ID "_tx_start<<pc_samples>>");
+    M0N0_pc_sample_print_params();
+    M0N0_PRINTF_ENABLED("\n" ADP_COMMAND_ID "_params_end");
+    M0N0_pc_sample_print_rows();
+    M0N0_PRINTF_ENABLED("\n" ADP_COMMAND_ID "_tx_end<<pc_samples>>\n");
+    M0N0_flush_stdout();
+    pc_sample_running = running;
+}
+#endif // M0N0_PC_SAMPLE
 
 uint8_t M0N0_spi_write(uint8_t data) {
     M0N0_write(SPI_DATA_WRITE_REG, data);
@@ -125,6 +125,117 @@ void RegClass::write(
     return this->_write_bg_driver_f(address,mask,data);
 }
 
+void RegClass::set_bits(uint32_t address, uint32_t mask) {
+    if (this->_add_offset) {
+        address += this->_base;
+    }
+#ifdef EXTRA_CHECKS
+    if (this->_write_driver_f == NULL) {
+        this->_error_f("No write driver - is this register read only?");
+    }
+    this->_addr_check(address);
+#endif
+    if (M0N0_HAS_SET_CLR_ALIAS(address)) {
+        this->_write_driver_f(address + CONTROL_SET_OFFSET, mask);
+    } else {
+        this->_write_driver_f(address, this->_read_driver_f(address) | mask);
+    }
+}
+
+void RegClass::clear_bits(uint32_t address, uint32_t mask) {
+    if (this->_add_offset) {
+        address += this->_base;
+    }
+#ifdef EXTRA_CHECKS
+    if (this->_write_driver_f == NULL) {
+        this->_error_f("No write driver - is this register read only?");
+    }
+    this->_addr_check(address);
+#endif
+    if (M0N0_HAS_SET_CLR_ALIAS(address)) {
+        this->_write_driver_f(address + CONTROL_CLR_OFFSET, mask);
+    } else {
+        this->_write_driver_f(address, this->_read_driver_f(address) & ~mask);
+    }
+}
+
+Read_Driver_Func Pluggable_Bus_Driver::read_f = &M0N0_read;
+Write_Driver_Func Pluggable_Bus_Driver::write_f = &M0N0_write;
+
+#ifdef M0N0_REG_TRACE
+// ---------- M0N0 Register Trace ---------- //
+
+M0N0_Reg_Trace_Entry M0N0_Reg_Trace::_entries[M0N0_REG_TRACE_DEPTH];
+uint32_t M0N0_Reg_Trace::_total = 0;
+bool M0N0_Reg_Trace::_enabled = true;
+
+void M0N0_Reg_Trace::start(void) {
+    M0N0_Reg_Trace::_enabled = true;
+}
+
+void M0N0_Reg_Trace::stop(void) {
+    M0N0_Reg_Trace::_enabled = false;
+}
+
+void M0N0_Reg_Trace::clear(void) {
+    M0N0_Reg_Trace::_total = 0;
+}
+
+uint32_t M0N0_Reg_Trace::get_count(void) {
+    if (M0N0_Reg_Trace::_total < M0N0_REG_TRACE_DEPTH) {
+        return M0N0_Reg_Trace::_total;
+    }
+    return M0N0_REG_TRACE_DEPTH;
+}
+
+uint32_t M0N0_Reg_Trace::get_total(void) {
+    return M0N0_Reg_Trace::_total;
+}
+
+const M0N0_Reg_Trace_Entry* M0N0_Reg_Trace::get_entry(uint32_t index) {
+    uint32_t count = M0N0_Reg_Trace::get_count();
+    if (index >= count) {
+        return NULL;
+    }
+    // the oldest entry is overwritten next
+    uint32_t oldest = M0N0_Reg_Trace::_total - count;
+    return &M0N0_Reg_Trace::_entries[(oldest + index) % M0N0_REG_TRACE_DEPTH];
+}
+
+void M0N0_Reg_Trace::send_via_adp(void) {
+    M0N0_System* sys = M0N0_System::get_sys(); 
+    for (uint32_t i = 0; i < M0N0_Reg_Trace::get_count(); i++) {
+        const M0N0_Reg_Trace_Entry* entry = M0N0_Reg_Trace::get_entry(i);
+        sys->print("\n0x%08X 0x%08X 0x%08X", 
+                entry->rtc, entry->address, entry->value);
+    }
+}
+
+uint32_t M0N0_trace_read(uint32_t address) {
+    uint32_t data = M0N0_read(address);
+    M0N0_Reg_Trace::record(address, data, false);
+    return data;
+}
+
+void M0N0_trace_write(uint32_t address, uint32_t data) {
+    M0N0_write(address, data);
+    M0N0_Reg_Trace::record(address, data, true);
+}
+
+uint32_t M0N0_trace_read_bit_group(uint32_t address, uint32_t mask) {
+    return (M0N0_trace_read(address) & mask) >> mask_to_shift(mask);
+}
+
+void M0N0_trace_write_bit_group(
+        uint32_t address, 
+        uint32_t mask, 
+        uint32_t data) {
+    uint8_t shift = mask_to_shift(mask);
+    M0N0_Reg_Trace::record(address, (data << shift) & mask, true);
+    M0N0_write_mask_and_shift(address, shift, mask, data);
+}
+#endif
+
 // ---------- M0N0 AES    ---------- //
 
 void AESClass::set_key(uint32_t key[8]) {
@@ -212,6 +323,25 @@ void AESClass::decrypt_blocking(
     }
 }
 
+void AESClass::start_block(const uint32_t* data, bool decrypt) {
+    this->_clear_irq();
+    if (decrypt) {
+        this->_en_decryption();
+    } else {
+        this->_en_encryption();
+    }
+    this->_write_data(data);
+    this->_start();
+}
+
+bool AESClass::is_complete() {
+    return (this->read(AES_STATUS_REG) == 1);
+}
+
+void AESClass::read_block(uint32_t* result) {
+    this->_read_data(result);
+}
+
 void AESClass::_start() {
     this->write(AES_CONTROL_REG, AES_R12_START_BIT_MASK, 1);
 }
@@ -292,7 +422,11 @@ void GPIOClass::set_direction(uint8_t direction) {
         this->_error_f("Value passed to GPIO set_direction too large");
     }
 #endif
+#ifdef M0N0_SHADOW_REGS
+    this->_direction_shadow.write(direction);
+#else
     this->write(GPIO_DIRECTION_REG,direction);
+#endif
 }
 
 void GPIOClass::set_interrupt_mask(uint8_t mask) {
@@ -300,8 +434,18 @@ void GPIOClass::set_interrupt_mask(uint8_t mask) {
 }
 
 uint8_t GPIOClass::get_direction() {
+#ifdef M0N0_SHADOW_REGS
+    return this->_direction_shadow.read();
+#else
     return this->read(GPIO_DIRECTION_REG);
+#endif
+}
+
+#ifdef M0N0_SHADOW_REGS
+PeriphShadowReg* GPIOClass::get_direction_shadow(void) {
+    return &(this->_direction_shadow);
 }
+#endif
 
 void GPIOClass::enable_gpio_protocol() {
     this->_debug_f("Enabling GPIO protocol");
@@ -390,6 +534,17 @@ void SPIClass::set_slave(SPI_SS_t slave_id) {
     if (slave_id == DESELECT) {
         en = 0;
     }
+#ifdef M0N0_SHADOW_REGS
+#ifdef EXTRA_CHECKS
+    if (this->_is_autosampling) {
+        M0N0_System::error("Cannot use SPI with autosampling enabled");     
+    }
+#endif
+    // both bit-groups are merged into a single store
+    this->_ctrl_shadow.set(SPI_R05_ENABLE_MASK_BIT_MASK, en);
+    this->_ctrl_shadow.set(SPI_R05_CHIP_SELECT_BIT_MASK, (uint32_t)slave_id);
+    this->_ctrl_shadow.flush();
+#else
 	this->write(
         SPI_CONTROL_REG,
         SPI_R05_ENABLE_MASK_BIT_MASK,
@@ -398,6 +553,7 @@ void SPIClass::set_slave(SPI_SS_t slave_id) {
             SPI_CONTROL_REG,
             SPI_R05_CHIP_SELECT_BIT_MASK,
             (uint32_t)slave_id);
+#endif
 }
 
 SPI_SS_t SPIClass::get_slave() {
@@ -409,13 +565,35 @@ SPI_SS_t SPIClass::get_slave() {
             SPI_R05_CHIP_SELECT_BIT_MASK);
 }
 
+#ifdef M0N0_SHADOW_REGS
+uint32_t SPIClass::read(uint32_t address) {
+    if (address == SPI_CONTROL_REG) {
+        return this->_ctrl_shadow.read();
+    }
+    return PeriphRegClass::read(address);
+}
+
+uint32_t SPIClass::read(uint32_t address, uint32_t mask) {
+    if (address == SPI_CONTROL_REG) {
+        return this->_ctrl_shadow.read(mask);
+    }
+    return PeriphRegClass::read(address, mask);
+}
+#endif
+
 void SPIClass::write(uint32_t address, uint32_t data)  {
 #ifdef EXTRA_CHECKS
     if (this->_is_autosampling) {
         M0N0_System::error("Cannot use SPI with autosampling enabled");     
     }
 #endif
-    RegClass::write(address, data);
+#ifdef M0N0_SHADOW_REGS
+    if (address == SPI_CONTROL_REG) {
+        this->_ctrl_shadow.write(data);
+        return;
+    }
+#endif
+    PeriphRegClass::write(address, data);
 }
 
 void SPIClass::write(
@@ -427,11 +605,17 @@ void SPIClass::write(
         M0N0_System::error("Cannot use SPI with autosampling enabled");     
     }
 #endif
-    RegClass::write(address, mask, data);
+#ifdef M0N0_SHADOW_REGS
+    if (address == SPI_CONTROL_REG) {
+        this->_ctrl_shadow.write(mask, data);
+        return;
+    }
+#endif
+    PeriphRegClass::write(address, mask, data);
 }
 
 
-uint8_t SPIClass::write_byte(uint8_t data) {
+void SPIClass::start_byte(uint8_t data) {
     /*takes care of the behavior of the HW block*/
     this->write(
             SPI_DATA_WRITE_REG,
@@ -441,6 +625,18 @@ uint8_t SPIClass::write_byte(uint8_t data) {
             1);
 	__NOP();
 	__NOP();
+}
+
+bool SPIClass::is_busy() {
+    return (this->read(SPI_STATUS_REG) != 0);
+}
+
+uint8_t SPIClass::get_read_byte() {
+    return (uint8_t)this->read(SPI_DATA_READ_REG);
+}
+
+uint8_t SPIClass::write_byte(uint8_t data) {
+    this->start_byte(data);
     while (this->read(SPI_STATUS_REG));
     uint8_t temp = (uint8_t)this->read(SPI_DATA_READ_REG);
     // next while added to block execution until PCSM updated
@@ -462,17 +658,34 @@ void SPIClass::pcsm_write(uint8_t address, uint32_t data) {
 #endif
     // set mode about
     uint8_t orig_mode = this->get_mode();
+#ifdef M0N0_SHADOW_REGS
+    // mode and slave select updates merged into one store each side
+    this->_ctrl_shadow.set(SPI_R05_CLK_POLARITY_PHASE_BIT_MASK, 0);
+    this->set_slave(kPcsmSS);
+#else
     this->set_mode(0);
     this->set_slave(kPcsmSS);
+#endif
     this->write_byte(address);
     this->write_byte(data >> 16);
     this->write_byte(data >> 8);
     this->write_byte(data);
     SPI_SS_t ss_deselect = DESELECT;
+#ifdef M0N0_SHADOW_REGS
+    this->_ctrl_shadow.set(SPI_R05_CLK_POLARITY_PHASE_BIT_MASK, orig_mode);
+    this->set_slave(ss_deselect);
+#else
     this->set_slave(ss_deselect);
     this->set_mode(orig_mode);
+#endif
 }
 
+#ifdef M0N0_SHADOW_REGS
+PeriphShadowReg* SPIClass::get_ctrl_shadow(void) {
+    return &(this->_ctrl_shadow);
+}
+#endif
+
 RTCTimer::RTCTimer() {
     this->_start_ticks = 0;
     this->_interval = 0;
@@ -489,7 +702,11 @@ uint64_t RTCTimer::get_cycles() {
 }
 
 float RTCTimer::get_us() {
-    return (this->get_cycles() * M0N0_System::kRtcPeriodUs);
+    return (float)M0N0_System::rtc_to_us(this->get_cycles());
+}
+
+uint64_t RTCTimer::get_elapsed_us() {
+    return M0N0_System::rtc_to_us(this->get_cycles());
 }
 
 void RTCTimer::set_interval(uint64_t interval_cycles) {
@@ -497,15 +714,21 @@ void RTCTimer::set_interval(uint64_t interval_cycles) {
 }
 
 void RTCTimer::set_interval_ms(uint32_t interval_ms) {
-    this->_interval = interval_ms * M0N0_System::kRtcOneMsTicks;
+    this->_interval = M0N0_System::ms_to_rtc(interval_ms);
+}
+
+uint64_t RTCTimer::get_start() {
+    return this->_start_ticks;
 }
 
 bool RTCTimer::check_interval() {
-    M0N0_System* temp_sys = M0N0_System::get_sys();
-    if ((temp_sys->get_rtc() - this->_start_ticks) >= this->_interval) {
-        return true;
+    if (this->_interval > M0N0_System::kRtcElapsedMax) {
+        M0N0_System* temp_sys = M0N0_System::get_sys();
+        return (temp_sys->get_rtc() - this->_start_ticks) >= this->_interval;
     }
-    return false;
+    // 32-bit (the interval is short enough for the LSBs)
+    return M0N0_System::rtc_elapsed((uint32_t)this->_start_ticks) 
+            >= (uint32_t)this->_interval;
 }
 
 void RTCTimer::wait() {
@@ -519,28 +742,546 @@ void RTCTimer::wait() {
 
 // Reduces the DVFS to the minimum level and returns at exit
 // note that the level changes after a predefined amount of time
+// (with the DVFS governor, the wait ends the job and the next one begins at
+// the governor's level)
 void RTCTimer::wait_lp() {
     this->reset(); // reset before, to take into account time for next code
     M0N0_System* sys = M0N0_System::get_sys();
+    bool governed = sys->is_dvfs_governed();
+    if (governed) {
+        sys->end_dvfs_job();
+    }
     uint8_t orig_perf = sys->get_perf();
     sys->set_perf(0);
     while (1) {
         if (this->check_interval()) {
-            sys->set_perf(orig_perf);
+            if (governed) {
+                sys->begin_dvfs_job();
+            } else {
+                sys->set_perf(orig_perf);
+            }
             return; 
         }
     }
 }
 
 void RTCTimer::wait_lp_inttimer() {
+    if (SoftTimer::is_running()) {
+        // INTTIMER0 belongs to the SoftTimers: wait without it
+        this->wait_lp();
+        return;
+    }
     M0N0_System* sys = M0N0_System::get_sys();
+    bool governed = sys->is_dvfs_governed();
+    if (governed) {
+        sys->end_dvfs_job();
+    }
     sys->enable_pcsm_interrupt_timer_rtc_ticks(this->_interval, NULL);
     uint8_t orig_perf = sys->get_perf();
     sys->set_perf(0);
     sys->clear_cpu_deepsleep(); // just in case it is set before
+    sys->break_tcro_window();
     __WFI();
+    M0N0_refresh_deve();
     sys->disable_pcsm_interrupt_timer();
-    sys->set_perf(orig_perf);
+    if (governed) {
+        sys->begin_dvfs_job();
+    } else {
+        sys->set_perf(orig_perf);
+    }
+}
+
+SoftTimer* SoftTimer::_head = NULL;
+uint64_t SoftTimer::_hw_next = 0;
+uint32_t SoftTimer::_hw_interval = 0;
+bool SoftTimer::_dispatching = false;
+
+SoftTimer::SoftTimer() {
+    this->_next = NULL;
+    this->_deadline = 0;
+    this->_period = 0;
+    this->_callback = NULL;
+    this->_expiries = 0;
+    this->_active = false;
+}
+
+void SoftTimer::_insert() {
+    SoftTimer** link = &_head;
+    while ((*link != NULL) && ((*link)->_deadline <= this->_deadline)) {
+        link = &((*link)->_next);
+    }
+    this->_next = *link;
+    *link = this;
+}
+
+void SoftTimer::_remove() {
+    SoftTimer** link = &_head;
+    while (*link != NULL) {
+        if (*link == this) {
+            *link = this->_next;
+            return;
+        }
+        link = &((*link)->_next);
+    }
+}
+
+void SoftTimer::_rearm(uint64_t now) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (_head == NULL) {
+        if (_hw_interval) {
+            sys->disable_pcsm_interrupt_timer();
+            _hw_interval = 0;
+        }
+        return;
+    }
+    // the hardware reload is already due at the deadline
+    if (_hw_interval && (_head->_deadline == _hw_next)) {
+        return;
+    }
+    uint64_t interval = 2; // (the minimum)
+    if (_head->_deadline > (now + interval)) {
+        interval = _head->_deadline - now;
+    }
+    if (interval > M0N0_System::kInttimerMaxTicks) {
+        interval = M0N0_System::kInttimerMaxTicks;
+    }
+    sys->enable_pcsm_interrupt_timer_rtc_ticks((uint32_t)interval, 
+            &SoftTimer::_dispatch);
+    _hw_interval = (uint32_t)interval;
+    _hw_next = now + interval;
+}
+
+void SoftTimer::_dispatch(void) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    uint64_t now = sys->get_rtc();
+    if (_hw_interval) {
+        _hw_next += _hw_interval; // (reloaded by the hardware)
+    }
+    _dispatching = true;
+    while ((_head != NULL) && (_head->_deadline <= now)) {
+        SoftTimer* timer = _head;
+        _head = timer->_next;
+        timer->_expiries++;
+        if (timer->_period) {
+            timer->_deadline += timer->_period;
+            if (timer->_deadline <= now) {
+                // missed expiries are skipped (counted once)
+                timer->_deadline = now + timer->_period;
+            }
+            timer->_insert();
+        } else {
+            timer->_active = false;
+        }
+        if (timer->_callback != NULL) {
+            timer->_callback();
+            now = sys->get_rtc();
+        }
+    }
+    _dispatching = false;
+    SoftTimer::_rearm(now);
+    if (_head != NULL) {
+        __NVIC_EnableIRQ(Interrupt5_IRQn); // (callbacks may have disabled it)
+    }
+}
+
+void SoftTimer::start(uint64_t rtc_ticks, Handler_Func callback, 
+        bool periodic) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    __NVIC_DisableIRQ(Interrupt5_IRQn);
+    if (this->_active) {
+        this->_remove();
+    }
+    uint64_t now = sys->get_rtc();
+    this->_deadline = now + rtc_ticks;
+    this->_period = periodic ? rtc_ticks : 0;
+    this->_callback = callback;
+    this->_active = true;
+    this->_insert();
+    if (!_dispatching) {
+        SoftTimer::_rearm(now);
+        __NVIC_EnableIRQ(Interrupt5_IRQn);
+    }
+}
+
+void SoftTimer::start_ms(uint32_t interval_ms, Handler_Func callback, 
+        bool periodic) {
+    this->start(M0N0_System::ms_to_rtc(interval_ms), callback, periodic);
+}
+
+void SoftTimer::stop() {
+    M0N0_System* sys = M0N0_System::get_sys();
+    __NVIC_DisableIRQ(Interrupt5_IRQn);
+    if (this->_active) {
+        this->_remove();
+        this->_active = false;
+    }
+    if (!_dispatching) {
+        SoftTimer::_rearm(sys->get_rtc());
+        if (_head != NULL) {
+            __NVIC_EnableIRQ(Interrupt5_IRQn);
+        }
+    }
+}
+
+bool SoftTimer::is_active() {
+    return this->_active;
+}
+
+uint32_t SoftTimer::take_expiries() {
+    __NVIC_DisableIRQ(Interrupt5_IRQn);
+    uint32_t expiries = this->_expiries;
+    this->_expiries = 0;
+    if (_head != NULL) {
+        __NVIC_EnableIRQ(Interrupt5_IRQn);
+    }
+    return expiries;
+}
+
+bool SoftTimer::is_running() {
+    return (_head != NULL);
+}
+
+EventQueue::EventQueue() {
+    this->_pending = 0;
+    for (uint32_t i = 0; i < 32; i++) {
+        this->_counts[i] = 0;
+        this->_handlers[i] = NULL;
+    }
+    this->_idle_perf = 0;
+    this->_active_perf = 0;
+    this->_idle_ticks = 0;
+    this->_stats_start = 0;
+    this->_wakeups = 0;
+}
+
+void EventQueue::add_event(uint32_t id, Handler_Func handler) {
+#ifdef EXTRA_CHECKS
+    if (id > 31) {
+        M0N0_System::error("Invalid event ID");
+    }
+#endif
+    this->_handlers[id] = handler;
+}
+
+void EventQueue::post(uint32_t id) {
+    // (the count first: a set bit always has a post to run)
+    __atomic_fetch_add(&this->_counts[id], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&this->_pending, (1u << id), __ATOMIC_RELEASE);
+}
+
+bool EventQueue::is_pending() {
+    return (this->_pending != 0);
+}
+
+bool EventQueue::dispatch_one() {
+    uint32_t pending = __atomic_load_n(&this->_pending, __ATOMIC_ACQUIRE);
+    if (pending == 0) {
+        return false;
+    }
+    uint32_t id = 31 - __CLZ(pending);
+    __atomic_fetch_and(&this->_pending, ~(1u << id), __ATOMIC_RELAXED);
+    if (__atomic_fetch_sub(&this->_counts[id], 1, __ATOMIC_RELAXED) > 1) {
+        // more posts: keep it pending (behind any higher priority event)
+        __atomic_fetch_or(&this->_pending, (1u << id), __ATOMIC_RELAXED);
+    }
+    if (this->_handlers[id] != NULL) {
+        this->_handlers[id]();
+    }
+    return true;
+}
+
+void EventQueue::_idle() {
+    M0N0_System* sys = M0N0_System::get_sys();
+    bool lowered = false;
+    __disable_irq();
+    // (interrupts are masked from the check to the WFI, so a post cannot
+    // be missed: the WFI still wakes up and its handler runs after)
+    while (this->_pending == 0) {
+        if (!lowered && (this->_idle_perf != kIdlePerfUnchanged) && 
+                (this->_idle_perf != this->_active_perf) && 
+                !sys->spi->get_is_autosampling()) {
+            sys->set_perf(this->_idle_perf);
+            lowered = true;
+        }
+        uint32_t start = M0N0_System::get_rtc_lsbs();
+        sys->break_tcro_window();
+        __WFI();
+        this->_idle_ticks += M0N0_System::rtc_elapsed(start);
+        this->_wakeups++;
+        __enable_irq(); // handlers run here
+        M0N0_refresh_deve();
+        __disable_irq();
+    }
+    __enable_irq();
+    if (lowered) {
+        sys->set_perf(this->_active_perf);
+    }
+}
+
+void EventQueue::run() {
+    M0N0_System* sys = M0N0_System::get_sys();
+    this->_active_perf = sys->get_perf();
+    sys->clear_cpu_deepsleep();
+    while (1) {
+        if (!this->dispatch_one()) {
+            this->_idle();
+        }
+    }
+}
+
+void EventQueue::set_idle_perf(uint8_t perf) {
+    this->_idle_perf = perf;
+}
+
+void EventQueue::reset_stats() {
+    M0N0_System* sys = M0N0_System::get_sys();
+    this->_idle_ticks = 0;
+    this->_wakeups = 0;
+    this->_stats_start = sys->get_rtc();
+}
+
+uint64_t EventQueue::get_idle_ticks() {
+    return this->_idle_ticks;
+}
+
+uint64_t EventQueue::get_stats_ticks() {
+    M0N0_System* sys = M0N0_System::get_sys();
+    return sys->get_rtc() - this->_stats_start;
+}
+
+uint32_t EventQueue::get_wakeups() {
+    return this->_wakeups;
+}
+
+CoTask::CoTask() {
+    this->_co_line = 0;
+    this->_co_state = CO_READY;
+    this->_co_deadline = 0;
+    this->_co_flag = NULL;
+    this->_co_flag_value = false;
+}
+
+bool CoTask::is_done() {
+    return (this->_co_state == CO_DONE);
+}
+
+void CoTask::restart() {
+    this->_co_line = 0;
+    this->_co_state = CO_READY;
+}
+
+void CoTask::_co_wait(CoState state, uint32_t line) {
+    this->_co_state = state;
+    this->_co_line = line;
+}
+
+void CoTask::_co_sleep(uint64_t rtc_ticks, uint32_t line) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    this->_co_deadline = sys->get_rtc() + rtc_ticks;
+    this->_co_state = CO_SLEEP;
+    this->_co_line = line;
+}
+
+void CoTask::_co_wait_flag(volatile bool* flag, bool value, uint32_t line) {
+    this->_co_flag = flag;
+    this->_co_flag_value = value;
+    this->_co_state = CO_FLAG;
+    this->_co_line = line;
+}
+
+void CoTask::_co_done() {
+    this->_co_state = CO_DONE;
+    this->_co_line = 0;
+}
+
+CoScheduler::CoScheduler() {
+    this->_num_tasks = 0;
+    this->_wakeups = 0;
+}
+
+bool CoScheduler::add(CoTask* task) {
+    if (this->_num_tasks >= kMaxTasks) {
+        return false;
+    }
+    this->_tasks[this->_num_tasks++] = task;
+    return true;
+}
+
+bool CoScheduler::_is_runnable(CoTask* task, uint64_t now) {
+    switch (task->_co_state) {
+        case CoTask::CO_DONE:
+            return false;
+        case CoTask::CO_SLEEP:
+            return (now >= task->_co_deadline);
+        case CoTask::CO_FLAG:
+            return (*(task->_co_flag) == task->_co_flag_value);
+        default:
+            return true;
+    }
+}
+
+bool CoScheduler::step() {
+    M0N0_System* sys = M0N0_System::get_sys();
+    uint64_t now = sys->get_rtc();
+    bool active = false;
+    for (uint32_t i = 0; i < this->_num_tasks; i++) {
+        CoTask* task = this->_tasks[i];
+        if (this->_is_runnable(task, now)) {
+            task->run();
+        }
+        active |= !task->is_done();
+    }
+    return active;
+}
+
+void CoScheduler::run() {
+    M0N0_System* sys = M0N0_System::get_sys();
+    sys->clear_cpu_deepsleep();
+    while (this->step()) {
+        // WFI unless a task can run (or is polling)
+        uint64_t now = sys->get_rtc();
+        uint64_t deadline = UINT64_MAX;
+        bool runnable = false;
+        for (uint32_t i = 0; i < this->_num_tasks; i++) {
+            CoTask* task = this->_tasks[i];
+            if (task->_co_state == CoTask::CO_SLEEP) {
+                if (task->_co_deadline < deadline) {
+                    deadline = task->_co_deadline;
+                }
+            }
+            runnable |= this->_is_runnable(task, now);
+        }
+        if (runnable) {
+            continue;
+        }
+        if (deadline != UINT64_MAX) {
+            this->_wake_timer.start(deadline - now, NULL, false);
+        }
+        // (masked from the check to the WFI: a flag set by an interrupt 
+        // in between still wakes it up)
+        __disable_irq();
+        now = sys->get_rtc();
+        runnable = false;
+        for (uint32_t i = 0; i < this->_num_tasks; i++) {
+            runnable |= this->_is_runnable(this->_tasks[i], now);
+        }
+        if (!runnable) {
+            sys->break_tcro_window();
+            __WFI();
+            this->_wakeups++;
+        }
+        __enable_irq();
+        M0N0_refresh_deve();
+    }
+    this->_wake_timer.stop();
+}
+
+uint32_t CoScheduler::get_wakeups() {
+    return this->_wakeups;
+}
+
+SPITransfer::SPITransfer() {
+    this->_spi = NULL;
+    this->_tx = NULL;
+    this->_rx = NULL;
+    this->_len = 0;
+    this->_pos = 0;
+    this->_in_byte = false;
+    this->_done = true;
+    this->_unmask_inttimer = false;
+}
+
+void SPITransfer::start(SPIClass* spi, SPI_SS_t slave, const uint8_t* tx, 
+        uint8_t* rx, uint32_t len) {
+    this->_spi = spi;
+    this->_tx = tx;
+    this->_rx = rx;
+    this->_len = len;
+    this->_pos = 0;
+    this->_in_byte = false;
+    this->_done = false;
+    this->_unmask_inttimer = (__NVIC_GetEnableIRQ(Interrupt5_IRQn) != 0);
+    __NVIC_DisableIRQ(Interrupt5_IRQn);
+    spi->set_slave(slave);
+}
+
+bool SPITransfer::poll() {
+    if (this->_done) {
+        return true;
+    }
+    if (this->_spi->is_busy()) {
+        return false;
+    }
+    if (this->_in_byte) {
+        uint8_t data = this->_spi->get_read_byte();
+        if (this->_rx != NULL) {
+            this->_rx[this->_pos] = data;
+        }
+        this->_pos++;
+        this->_in_byte = false;
+        return false; // (not busy again before the next byte)
+    }
+    if (this->_pos < this->_len) {
+        this->_spi->start_byte(
+                (this->_tx != NULL) ? this->_tx[this->_pos] : 0);
+        this->_in_byte = true;
+        return false;
+    }
+    SPI_SS_t deselect = DESELECT;
+    this->_spi->set_slave(deselect);
+    this->_done = true;
+    if (this->_unmask_inttimer) {
+        __NVIC_EnableIRQ(Interrupt5_IRQn);
+    }
+    return true;
+}
+
+AESOperation::AESOperation() {
+    this->_aes = NULL;
+    this->_data = NULL;
+    this->_size = 0;
+    this->_result = NULL;
+    this->_pos = 0;
+    this->_decrypt = false;
+}
+
+void AESOperation::_start(AESClass* aes, const uint32_t* data, 
+        uint32_t size, uint32_t* result, bool decrypt) {
+    this->_aes = aes;
+    this->_data = data;
+    this->_size = size;
+    this->_result = result;
+    this->_pos = 0;
+    this->_decrypt = decrypt;
+    if (size > 0) {
+        aes->start_block(data, decrypt);
+    }
+}
+
+void AESOperation::start_encrypt(AESClass* aes, const uint32_t* data, 
+        uint32_t size, uint32_t* result) {
+    this->_start(aes, data, size, result, false);
+}
+
+void AESOperation::start_decrypt(AESClass* aes, const uint32_t* data, 
+        uint32_t size, uint32_t* result) {
+    this->_start(aes, data, size, result, true);
+}
+
+bool AESOperation::poll() {
+    if (this->_pos >= this->_size) {
+        return true;
+    }
+    if (!this->_aes->is_complete()) {
+        return false;
+    }
+    this->_aes->read_block(this->_result + this->_pos);
+    this->_pos += 4;
+    if (this->_pos < this->_size) {
+        this->_aes->start_block(this->_data + this->_pos, this->_decrypt);
+        return false;
+    }
+    return true;
 }
 
 CircBuffer::CircBuffer(
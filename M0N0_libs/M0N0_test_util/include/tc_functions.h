@@ -53,7 +53,24 @@ typedef enum  {
   SANITY_TC,
   AES_TC,
   RTC_TC,
-  PERF_TC
+  PERF_TC,
+  REG_ACCESS_TC,
+  SHADOW_REGS_TC,
+  REG_TRACE_TC,
+  LOG_TC,
+  PRINTF_TC,
+  SINK_TC,
+  FMT_TC,
+  SLEEP_TC,
+  SOFT_TIMER_TC,
+  EVENT_QUEUE_TC,
+  CO_TC,
+  DVFS_GOV_TC,
+  PERF_FREQ_TC,
+  TCRO_TC,
+  PROFILE_TC,
+  PC_SAMPLE_TC,
+  IRQ_LATENCY_TC
 } testcase_id_t;
 
 /** Value returned from testcase when it has passed successfully (test passed)
@@ -182,6 +199,158 @@ int tc_rtc(uint32_t verbose);
  *     tests so will always return TCPASS
  */
 int tc_perf(uint32_t verbose);
+/** Testcase that compares the CPU cycles of run-time (RegClass) and 
+ *     compile-time (m0n0_regs.h) register accesses, using the DWT cycle counter
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL). Fails if the two access methods read different values
+ */
+int tc_reg_access(uint32_t verbose);
+/** Testcase that reports the register accesses saved by the shadow 
+ *     registers (M0N0_SHADOW_REGS) for SPI, PCSM and GPIO operations
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL). Fails if a shadow does not match its register
+ */
+int tc_shadow_regs(uint32_t verbose);
+/** Testcase that sends the register access trace (M0N0_REG_TRACE) recorded
+ *     since start-up or the last run of this testcase via an ADP transaction
+ *     ("reg_trace"), then clears it
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL). Note that many testcases are used as utilities rather than
+ *     tests so will always return TCPASS
+ */
+int tc_reg_trace(uint32_t verbose);
+/** Testcase that measures the CPU cycles of a log_info call, when printed 
+ *     and when filtered by the log level, using the DWT cycle counter
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL). Note that many testcases are used as utilities rather than
+ *     tests so will always return TCPASS
+ */
+int tc_log(uint32_t verbose);
+/** Testcase that measures the CPU cycles of formatting 64-bit and 
+ *     fixed-point values (into a RAM buffer) with the new specifiers, 
+ *     compared with the previous approach (32-bit halves and soft-float), 
+ *     using the DWT cycle counter
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL). Fails if the two approaches print different text. 
+ */
+int tc_printf(uint32_t verbose);
+/** Testcase for the m0n0_printf output sinks. Checks the truncation of 
+ *     m0n0_snprintf and a SHRAM ring (in the last 64 bytes of SHRAM, which 
+ *     are restored), and measures the CPU cycles of printing a line to 
+ *     STDOUT one character at a time compared with in batches (checking 
+ *     that batches are faster with M0N0_STDOUT_BUFFERED: otherwise both 
+ *     are limited by the STDOUT FIFO)
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_sink(uint32_t verbose);
+/** Testcase that measures the CPU cycles of formatting typical log lines
+ *     (into a RAM buffer) with the format string parsed at run-time 
+ *     (m0n0_sink_printf) and at compile time (M0N0_FMT_SINK_PRINTF)
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL). Fails if the two print different text. 
+ */
+int tc_fmt(uint32_t verbose);
+/** Testcase that characterises the sleep mechanisms and checks that 
+ *     sleep_for (RETAIN_CONTEXT) waits for at least the interval with the 
+ *     mechanism chosen by plan_sleep
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_sleep(uint32_t verbose);
+/** Testcase that runs three software timers (SoftTimer) on INTTIMER0, 
+ *     waiting with WFI (and RTCTimer::wait_lp_inttimer), and checks the 
+ *     number of times each expired
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_soft_timer(uint32_t verbose);
+/** Testcase that posts events to an EventQueue from the main code and from
+ *     an interrupt (SoftTimer) and checks they run in priority order
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_event_queue(uint32_t verbose);
+/** Testcase that runs coroutines (CoTask) that sleep, wait for an interrupt
+ *     flag and await SPI and AES operations, checking the AES results 
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_coroutines(uint32_t verbose);
+/** Testcase that runs a synthetic job (its time scales with the perf) 
+ *     with the DVFS governor and checks that it settles at a level that 
+ *     meets the budget, and returns to the maximum perf after a miss
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_dvfs_governor(uint32_t verbose);
+/** Testcase that characterises the core frequency at each perf level and 
+ *     checks that set_perf updates SystemCoreClock from the table
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_perf_freqs(uint32_t verbose);
+/** Testcase that tracks the core frequency in the background (sampled by a 
+ *     SoftTimer), compares it with estimate_tcro and checks that WFIs do 
+ *     not corrupt it
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_tcro_tracking(uint32_t verbose);
+/** Testcase that profiles a 2 ms busy wait (M0N0_PROFILE_SCOPE) and an 
+ *     inner region (M0N0_PROFILE_BEGIN/END), checks the recorded cycles, 
+ *     RTC ticks and perf, and sends the profile via ADP
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_profile(uint32_t verbose);
+/** Testcase that samples the PC on a 1 ms SysTick, chained with an existing
+ *     SysTick callback and then on its own, checks the histogram and the 
+ *     overhead and sends the samples via ADP
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_pc_sampling(uint32_t verbose);
+/** Testcase that measures the cycles from pending the PCSM interrupt timer
+ *     interrupt (IRQ5) to its callback being called
+ *
+ * @param verbose Whether the testcase should issue STDOUT (TRUE) or not
+ * @return Flag indicating whether the testcase has passed (TCPASS) or failed
+ *     (TCFAIL)
+ */
+int tc_irq_latency(uint32_t verbose);
 
 /** Function that calls a testcase using the ID enum
   *
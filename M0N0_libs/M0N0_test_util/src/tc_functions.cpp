@@ -26,8 +26,14 @@
  * 
  */
 
+#include <string.h>
 #include "tc_functions.h"
 #include "m0n0.h"
+#include "m0n0_regs.h"
+
+extern "C" {
+    #include "m0n0_printf.h"
+}
 
 /* some testcases can't be called (only declared for
  * viewing over GPIO, and so have an empty
@@ -47,6 +53,23 @@ Testcase_Func tc_fncs[NUM_TESCASES] = {
   tc_aes, // AES_TC
   tc_rtc, // RTC_TC
   tc_perf, // PERF_TC
+  tc_reg_access, // REG_ACCESS_TC
+  tc_shadow_regs, // SHADOW_REGS_TC
+  tc_reg_trace, // REG_TRACE_TC
+  tc_log, // LOG_TC
+  tc_printf, // PRINTF_TC
+  tc_sink, // SINK_TC
+  tc_fmt, // FMT_TC
+  tc_sleep, // SLEEP_TC
+  tc_soft_timer, // SOFT_TIMER_TC
+  tc_event_queue, // EVENT_QUEUE_TC
+  tc_coroutines, // CO_TC
+  tc_dvfs_governor, // DVFS_GOV_TC
+  tc_perf_freqs, // PERF_FREQ_TC
+  tc_tcro_tracking, // TCRO_TC
+  tc_profile, // PROFILE_TC
+  tc_pc_sampling, // PC_SAMPLE_TC
+  tc_irq_latency, // IRQ_LATENCY_TC
 };
 
 int empty_test(uint32_t verbose) {
@@ -193,8 +216,8 @@ int tc_rtc(uint32_t verbose) {
     M0N0_System* sys = M0N0_System::get_sys();
     if (verbose) sys->print("--- tc_rtc ---\n");
     uint64_t rtc = sys->get_rtc();
-    sys->log_info("RTC: 0x%08x%08x", (uint32_t)(rtc >> 32), (uint32_t)(rtc));
-    sys->log_info("Microseconds: %d", (uint32_t)sys->get_rtc_us());
+    sys->log_info("RTC: 0x%016llx", rtc);
+    sys->log_info("Microseconds: %llu", M0N0_System::rtc_to_us(rtc));
     sys->log_info("Read time?: %d", sys->is_rtc_real_time());
     return TCPASS;
 }
@@ -212,6 +235,800 @@ int tc_perf(uint32_t verbose) {
     return TCPASS;
 }
 
+int tc_reg_access(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_reg_access ---\n");
+    const uint32_t kIters = 100;
+    volatile uint32_t sink = 0;
+    int result = TCPASS;
+    M0N0_cyccnt_enable();
+    // 1. bit-group read: RegClass (run-time mask_to_shift)
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        sink = sys->status->read(STATUS_STATUS_7_REG, STATUS_R07_PERF_BIT_MASK);
+    }
+    uint32_t rt_read = DWT->CYCCNT - start;
+    uint32_t rt_val = sink;
+    // 2. bit-group read: BitField (compile-time)
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        sink = StatusPerf::read();
+    }
+    uint32_t ct_read = DWT->CYCCNT - start;
+    if (sink != rt_val) {
+        result = TCFAIL;
+    }
+    // 3. bit-group write (writes back the current value: no change)
+    uint32_t ctrl4 = sys->ctrl->read(CONTROL_CTRL_4_REG,
+            CONTROL_R04_SHRAM_DELAY_BIT_MASK);
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        sys->ctrl->write(CONTROL_CTRL_4_REG, CONTROL_R04_SHRAM_DELAY_BIT_MASK,
+                ctrl4);
+    }
+    uint32_t rt_write = DWT->CYCCNT - start;
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        BitField<CONTROL_CTRL_4_REG, CONTROL_R04_SHRAM_DELAY_BIT_MASK>::write(ctrl4);
+    }
+    uint32_t ct_write = DWT->CYCCNT - start;
+    // 4. full RTC read
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        sink = (uint32_t)sys->get_rtc();
+    }
+    uint32_t rtc_read = DWT->CYCCNT - start;
+    sys->log_info("Cycles per access (x%d iterations):", kIters);
+    sys->log_info("Read  - RegClass: %d, BitField: %d", 
+            rt_read/kIters, ct_read/kIters);
+    sys->log_info("Write - RegClass: %d, BitField: %d",
+            rt_write/kIters, ct_write/kIters);
+    sys->log_info("get_rtc: %d", rtc_read/kIters);
+    return result;
+}
+
+int tc_shadow_regs(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_shadow_regs ---\n");
+#ifdef M0N0_SHADOW_REGS
+    int result = TCPASS;
+    PeriphShadowReg* spi_shadow = sys->spi->get_ctrl_shadow();
+    PeriphShadowReg* gpio_shadow = sys->gpio->get_direction_shadow();
+    // set_slave
+    spi_shadow->reset_counters();
+    sys->spi->set_slave(DESELECT);
+    sys->log_info("set_slave saved: %d", spi_shadow->get_accesses_saved());
+    // pcsm_write (re-writes the current performance level)
+    spi_shadow->reset_counters();
+    sys->set_perf(sys->get_perf());
+    sys->log_info("pcsm_write saved: %d", spi_shadow->get_accesses_saved());
+    // GPIO direction
+    gpio_shadow->reset_counters();
+    uint8_t dir = sys->gpio->get_direction();
+    sys->gpio->set_direction(dir);
+    sys->gpio->get_direction();
+    sys->log_info("GPIO direction saved: %d", 
+            gpio_shadow->get_accesses_saved());
+    // check the shadows match the registers
+    if (spi_shadow->read() != M0N0_read(SPI_CONTROL_REG)) {
+        sys->log_error("SPI control shadow mismatch");
+        result = TCFAIL;
+    }
+    if (gpio_shadow->read() != M0N0_read(GPIO_DIRECTION_REG)) {
+        sys->log_error("GPIO direction shadow mismatch");
+        result = TCFAIL;
+    }
+    return result;
+#else
+    sys->log_info("M0N0_SHADOW_REGS not defined");
+    return TCPASS;
+#endif
+}
+
+int tc_reg_trace(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_reg_trace ---\n");
+#ifdef M0N0_REG_TRACE
+    M0N0_Reg_Trace::stop(); // don't record the accesses of the dump
+    sys->adp_tx_start("reg_trace");
+    sys->print("\ndepth : %d", M0N0_REG_TRACE_DEPTH);
+    sys->print("\ncount : %d", M0N0_Reg_Trace::get_count());
+    sys->print("\ntotal : %d", M0N0_Reg_Trace::get_total());
+    sys->adp_tx_end_of_params();
+    M0N0_Reg_Trace::send_via_adp();
+    sys->adp_tx_end();
+    M0N0_Reg_Trace::clear();
+    M0N0_Reg_Trace::start();
+#else
+    sys->log_info("M0N0_REG_TRACE not defined");
+#endif
+    return TCPASS;
+}
+
+int tc_log(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_log ---\n");
+    const uint32_t kIters = 10;
+    LOG_LEVEL_t orig_level = sys->get_log_level();
+    M0N0_cyccnt_enable();
+    // 1. printed (includes the STDOUT FIFO writes)
+    sys->set_log_level(DEBUG);
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        sys->log_info("log %d", i);
+    }
+    uint32_t printed = DWT->CYCCNT - start;
+    // 2. filtered by the log level
+    sys->set_log_level(ERROR);
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        sys->log_info("log %d", i);
+    }
+    uint32_t filtered = DWT->CYCCNT - start;
+    sys->set_log_level(orig_level);
+    sys->log_info("Cycles per log_info (x%d iterations):", kIters);
+    sys->log_info("Printed: %d, filtered: %d", 
+            printed/kIters, filtered/kIters);
+    return TCPASS;
+}
+
+int tc_printf(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_printf ---\n");
+    const uint32_t kIters = 10;
+    char buf_a[32];
+    char buf_b[32];
+    uint64_t rtc = sys->get_rtc() | 0x100000000ULL; // (upper half non-zero)
+    M0N0_cyccnt_enable();
+    // 1. 64-bit hex: two 32-bit halves vs %llx
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_simple_sprintf(buf_a, "0x%x%08x", 
+                (uint32_t)(rtc >> 32), (uint32_t)rtc);
+    }
+    uint32_t hex_halves = DWT->CYCCNT - start;
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_simple_sprintf(buf_b, "0x%llx", rtc);
+    }
+    uint32_t hex_ll = DWT->CYCCNT - start;
+    int result = TCPASS;
+    if (strcmp(buf_a, buf_b)) {
+        sys->log_error("64-bit hex mismatch");
+        result = TCFAIL;
+    }
+    // 2. 64-bit decimal
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_simple_sprintf(buf_b, "%llu", rtc);
+    }
+    uint32_t dec_ll = DWT->CYCCNT - start;
+    // 3. RTC ticks to microseconds: soft-float vs Q16.16
+    uint32_t rtc_lsbs = (uint32_t)rtc;
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_simple_sprintf(buf_a, "%u", 
+                (uint32_t)(rtc_lsbs * M0N0_System::kRtcPeriodUs));
+    }
+    uint32_t us_float = DWT->CYCCNT - start;
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_simple_sprintf(buf_b, "%llu", ((uint64_t)rtc_lsbs * 
+                M0N0_System::kRtcPeriodUsQ16) >> 16);
+    }
+    uint32_t us_fixed = DWT->CYCCNT - start;
+    // 4. fixed-point (Q16.16) as decimal
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_simple_sprintf(buf_b, "%.4q16", (int32_t)rtc_lsbs);
+    }
+    uint32_t q16 = DWT->CYCCNT - start;
+    sys->log_info("Cycles per sprintf (x%d iterations):", kIters);
+    sys->log_info("hex (2 halves): %d, hex (ll): %d, dec (ll): %d", 
+            hex_halves/kIters, hex_ll/kIters, dec_ll/kIters);
+    sys->log_info("us (float): %d, us (Q16.16): %d, Q16.16 frac: %d", 
+            us_float/kIters, us_fixed/kIters, q16/kIters);
+    return result;
+}
+
+// writes each character separately (as m0n0_printf did before the sinks)
+static void tc_sink_char_write(m0n0_sink_t *sink, const char *data, 
+        size_t len) {
+    (void)sink;
+    while (len--) {
+        M0N0_write_stdout((uint8_t)*data++);
+    }
+}
+
+int tc_sink(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_sink ---\n");
+    int result = TCPASS;
+    char buf[16];
+    // bounded: truncated and terminated, returns the full length
+    int len = m0n0_snprintf(buf, 8, "0x%llx", 0x123456789ULL);
+    if ((len != 11) || strcmp(buf, "0x12345")) {
+        sys->log_error("snprintf: %d '%s'", len, buf);
+        result = TCFAIL;
+    }
+    // SHRAM ring (12 characters) that wraps
+    const uint32_t kRingBase = MEM_MAP_SHRAM_SIZE - 64;
+    const uint32_t kRingSize = 16;
+    uint32_t saved[kRingSize/4];
+    for (uint32_t i = 0; i < kRingSize/4; i++) {
+        saved[i] = sys->shram->read(kRingBase + i*4);
+    }
+    m0n0_shram_ring_t ring;
+    m0n0_shram_ring_init(&ring, kRingBase, kRingSize, 1);
+    m0n0_sink_printf(&ring.sink, "abc%d", 12345);
+    m0n0_sink_printf(&ring.sink, "-%s", "xyz12");
+    m0n0_shram_ring_read(&ring, buf, sizeof(buf));
+    if (strcmp(buf, "c12345-xyz12")) {
+        sys->log_error("ring: '%s'", buf);
+        result = TCFAIL;
+    }
+    for (uint32_t i = 0; i < kRingSize/4; i++) {
+        sys->shram->write(kRingBase + i*4, saved[i]);
+    }
+    // STDOUT: per character vs batched (starting from an empty queue)
+    m0n0_sink_t char_sink = { tc_sink_char_write };
+    M0N0_flush_stdout();
+    uint64_t rtc = sys->get_rtc();
+    M0N0_cyccnt_enable();
+    uint32_t start = DWT->CYCCNT;
+    m0n0_sink_printf(&char_sink, "RTC: 0x%016llx (per char)\n", rtc);
+    uint32_t per_char = DWT->CYCCNT - start;
+    start = DWT->CYCCNT;
+    m0n0_sink_printf(&m0n0_stdout_sink, "RTC: 0x%016llx (batched)\n", rtc);
+    uint32_t batched = DWT->CYCCNT - start;
+    sys->log_info("STDOUT cycles per char: %d, batched: %d", 
+            per_char, batched);
+#ifdef M0N0_STDOUT_BUFFERED
+    // (both lines fit in the queue; unbuffered, both wait on the FIFO)
+    if (batched >= per_char) {
+        sys->log_error("batched STDOUT not faster");
+        result = TCFAIL;
+    }
+#endif
+    return result;
+}
+
+int tc_fmt(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_fmt ---\n");
+    const uint32_t kIters = 10;
+    char buf_a[128]; // (the 3 lines are up to ~75 characters)
+    char buf_b[128];
+    m0n0_buf_sink_t sink_a;
+    m0n0_buf_sink_t sink_b;
+    uint64_t rtc = sys->get_rtc();
+    uint32_t val = (uint32_t)rtc;
+    M0N0_cyccnt_enable();
+    // typical log lines (as in m0n0.cpp and the projects)
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_buf_sink_init(&sink_a, buf_a, sizeof(buf_a));
+        m0n0_sink_printf(&sink_a.sink, "Loop count: %d", val);
+        m0n0_sink_printf(&sink_a.sink, "Reg: 0x%08X val: %d", val, i);
+        m0n0_sink_printf(&sink_a.sink, "rtc start 0x%llx", rtc);
+    }
+    uint32_t runtime = DWT->CYCCNT - start;
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kIters; i++) {
+        m0n0_buf_sink_init(&sink_b, buf_b, sizeof(buf_b));
+        M0N0_FMT_SINK_PRINTF(&sink_b.sink, "Loop count: %d", val);
+        M0N0_FMT_SINK_PRINTF(&sink_b.sink, "Reg: 0x%08X val: %d", val, i);
+        M0N0_FMT_SINK_PRINTF(&sink_b.sink, "rtc start 0x%llx", rtc);
+    }
+    uint32_t compile_time = DWT->CYCCNT - start;
+    // (a truncated buffer would only compare a prefix)
+    int result = (strcmp(buf_a, buf_b) || 
+            (sink_a.len >= (sizeof(buf_a) - 1))) ? TCFAIL : TCPASS;
+    if (result == TCFAIL) {
+        sys->log_error("'%s' != '%s'", buf_a, buf_b);
+    }
+    sys->log_info("Cycles per 3 lines (x%d): run-time: %d, compile time: %d", 
+            kIters, runtime/kIters, compile_time/kIters);
+    return result;
+}
+
+static void tc_sleep_callback(void) {
+}
+
+int tc_sleep(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_sleep ---\n");
+    const uint32_t kIntervalsMs[] = {0, 1, 5, 50};
+    int result = TCPASS;
+    sys->characterise_sleep();
+    sys->log_info("Sleep costs (rtc tks): lp %d, wfi %d, shtdwn %d",
+            sys->get_sleep_cost(SLEEP_SPIN_LP),
+            sys->get_sleep_cost(SLEEP_WFI),
+            sys->get_sleep_cost(SLEEP_TIMED_SHUTDOWN));
+    for (uint32_t i = 0; i < 4; i++) {
+        uint64_t ticks = M0N0_System::ms_to_rtc(kIntervalsMs[i]);
+        SLEEP_MECHANISM_t planned = sys->plan_sleep(ticks, RETAIN_CONTEXT);
+        uint64_t start = sys->get_rtc();
+        SLEEP_MECHANISM_t used = sys->sleep_for(ticks, RETAIN_CONTEXT);
+        uint64_t elapsed = sys->get_rtc() - start;
+        if ((used != planned) || (used == SLEEP_TIMED_SHUTDOWN) || 
+                (elapsed < ticks)) {
+            result = TCFAIL;
+        }
+        sys->log_info("%d ms: mechanism %d (shtdwn: %d), %llu rtc tks", 
+                kIntervalsMs[i], used, 
+                sys->plan_sleep(ticks, RETAIN_SHRAM), elapsed);
+    }
+    // the interrupt timer is not borrowed while a callback uses it
+    sys->enable_pcsm_interrupt_timer_ms(1000, &tc_sleep_callback);
+    SLEEP_MECHANISM_t planned = sys->plan_sleep(
+            M0N0_System::ms_to_rtc(50), RETAIN_SHRAM);
+    sys->disable_pcsm_interrupt_timer();
+    if (planned > SLEEP_SPIN_LP) {
+        sys->log_error("Inttimer in use but planned mechanism %d", planned);
+        result = TCFAIL;
+    }
+    // the perf is not changed (over SPI) while autosampling
+    sys->enable_autosampling_ms(1000, &tc_sleep_callback);
+    sys->characterise_sleep();
+    SLEEP_MECHANISM_t used = sys->sleep_for(
+            M0N0_System::ms_to_rtc(5), RETAIN_SHRAM);
+    sys->disable_autosampling();
+    if (used != SLEEP_SPIN) {
+        sys->log_error("Autosampling but slept with mechanism %d", used);
+        result = TCFAIL;
+    }
+    return result;
+}
+
+static volatile uint32_t soft_timer_calls = 0;
+
+static void soft_timer_callback(void) {
+    soft_timer_calls++;
+}
+
+int tc_soft_timer(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_soft_timer ---\n");
+    SoftTimer fast;
+    SoftTimer slow;
+    SoftTimer once;
+    soft_timer_calls = 0;
+    fast.start_ms(2, &soft_timer_callback, true);
+    slow.start_ms(3, NULL, true);
+    once.start_ms(5, NULL, false);
+    uint32_t wakeups = 0;
+    RTCTimer run_timer;
+    run_timer.set_interval_ms(20);
+    run_timer.reset();
+    // the timers own INTTIMER0, so this must not take it from them
+    RTCTimer lp_timer;
+    lp_timer.set_interval_ms(4);
+    lp_timer.wait_lp_inttimer();
+    while (!run_timer.check_interval()) {
+        __WFI();
+        M0N0_refresh_deve();
+        wakeups++;
+    }
+    fast.stop();
+    slow.stop();
+    uint32_t fast_count = soft_timer_calls;
+    uint32_t slow_count = slow.take_expiries();
+    uint32_t once_count = once.take_expiries();
+    int result = TCPASS;
+    if ((fast_count < 9) || (fast_count > 10) || (slow_count < 6) || 
+            (slow_count > 7) || (once_count != 1) || once.is_active() || 
+            SoftTimer::is_running()) {
+        result = TCFAIL;
+    }
+    sys->log_info("20 ms: 2 ms x%d, 3 ms x%d, 5 ms one-shot x%d, wakeups %d",
+            fast_count, slow_count, once_count, wakeups);
+    return result;
+}
+
+static EventQueue* tc_events = NULL;
+static uint32_t tc_event_log = 0; // event IDs run (one hex digit each)
+
+static void tc_event_low(void) {
+    tc_event_log = (tc_event_log << 4) | 1;
+}
+
+static void tc_event_high(void) {
+    tc_event_log = (tc_event_log << 4) | 5;
+}
+
+static void tc_event_post_from_irq(void) {
+    tc_events->post(5);
+}
+
+int tc_event_queue(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_event_queue ---\n");
+    EventQueue events;
+    tc_events = &events;
+    tc_event_log = 0;
+    events.add_event(1, &tc_event_low);
+    events.add_event(5, &tc_event_high);
+    // 1. posted from the main code: run highest ID first, once per post
+    events.post(1);
+    events.post(5);
+    events.post(1);
+    while (events.dispatch_one()) {
+    }
+    uint32_t main_log = tc_event_log;
+    // 2. posted from an interrupt while waiting (WFI)
+    tc_event_log = 0;
+    SoftTimer post_timer;
+    post_timer.start_ms(2, &tc_event_post_from_irq, false);
+    events.post(1);
+    uint32_t wakeups = 0;
+    while (tc_event_log != 0x15) {
+        if (!events.dispatch_one()) {
+            __WFI();
+            M0N0_refresh_deve();
+            if (++wakeups > 100) {
+                break;
+            }
+        }
+    }
+    tc_events = NULL;
+    sys->log_info("Events run: main 0x%X, irq 0x%X (wakeups %d)", 
+            main_log, tc_event_log, wakeups);
+    return ((main_log == 0x511) && (tc_event_log == 0x15)) ? TCPASS : TCFAIL;
+}
+
+static volatile bool tc_co_flag = false;
+
+static void tc_co_set_flag(void) {
+    tc_co_flag = true;
+}
+
+// sleeps, then waits for a flag set by an interrupt
+class TcSleepTask : public CoTask {
+    public:
+        uint32_t count;
+        uint64_t start_rtc;
+        uint64_t end_rtc;
+        SoftTimer flag_timer;
+        void run() {
+            M0N0_CO_BEGIN();
+            this->start_rtc = M0N0_System::get_sys()->get_rtc();
+            for (this->count = 0; this->count < 3; this->count++) {
+                M0N0_CO_SLEEP_MS(2);
+            }
+            tc_co_flag = false;
+            this->flag_timer.start_ms(1, &tc_co_set_flag, false);
+            M0N0_CO_WAIT_FLAG(tc_co_flag, true);
+            this->end_rtc = M0N0_System::get_sys()->get_rtc();
+            M0N0_CO_END();
+        }
+};
+
+// reads the temperature sensor (SS0), then encrypts and decrypts
+class TcIoTask : public CoTask {
+    public:
+        uint8_t rx[2];
+        uint32_t data[8];
+        uint32_t encr[8];
+        uint32_t decr[8];
+        SPITransfer xfer;
+        AESOperation aes_op;
+        void run() {
+            M0N0_System* sys = M0N0_System::get_sys();
+            M0N0_CO_BEGIN();
+            this->xfer.start(sys->spi, SS0, NULL, this->rx, 2);
+            M0N0_CO_AWAIT(this->xfer);
+            M0N0_CO_YIELD();
+            this->aes_op.start_encrypt(sys->aes, this->data, 8, this->encr);
+            M0N0_CO_AWAIT(this->aes_op);
+            this->aes_op.start_decrypt(sys->aes, this->encr, 8, this->decr);
+            M0N0_CO_AWAIT(this->aes_op);
+            M0N0_CO_END();
+        }
+};
+
+int tc_coroutines(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_coroutines ---\n");
+    uint32_t key_256 [8] = {0x524f4841, 0x4e4b4152, 0x5448494b, 0x4d454700,
+            0xaaaaaaaa, 0xaaaaaaaa, 0xaaaaaaaa, 0xaaaaaaaa}; // ROHANKARTHINMEG
+    TcSleepTask sleep_task;
+    TcIoTask io_task;
+    for (uint32_t i = 0; i < 8; i++) {
+        io_task.data[i] = 0x57656c63 + i;
+    }
+    sys->aes->set_key(key_256);
+    uint32_t expected[8];
+    sys->aes->encrypt_blocking(io_task.data, 8, expected);
+    CoScheduler scheduler;
+    scheduler.add(&sleep_task);
+    scheduler.add(&io_task);
+    scheduler.run();
+    int result = TCPASS;
+    for (uint32_t i = 0; i < 8; i++) {
+        if ((io_task.encr[i] != expected[i]) || 
+                (io_task.decr[i] != io_task.data[i])) {
+            result = TCFAIL;
+        }
+    }
+    uint32_t slept_us = (uint32_t)M0N0_System::rtc_to_us(
+            sleep_task.end_rtc - sleep_task.start_rtc);
+    if ((sleep_task.count != 3) || (slept_us < 6000)) {
+        result = TCFAIL;
+    }
+    sys->log_info("Coroutines: slept %d us, SPI 0x%02X%02X (wakeups %d)", 
+            slept_us, io_task.rx[0], io_task.rx[1], scheduler.get_wakeups());
+    return result;
+}
+
+// a job that takes work_ticks at the maximum perf (and scales with perf)
+static void tc_dvfs_job(uint32_t work_ticks) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    sys->begin_dvfs_job();
+    uint32_t ticks = (work_ticks * 16) / (sys->get_perf() + 1);
+    uint32_t start = M0N0_System::get_rtc_lsbs();
+    while (M0N0_System::rtc_elapsed(start) < ticks) {
+    }
+    sys->end_dvfs_job();
+}
+
+int tc_dvfs_governor(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_dvfs_governor ---\n");
+    uint8_t orig_perf = sys->get_perf();
+    const uint32_t deadline = 200;
+    const uint32_t budget = 160;
+    int result = TCPASS;
+    // 1. settles at the lowest level within budget (4: 128 ticks)
+    sys->enable_dvfs_governor(deadline, budget);
+    for (uint32_t i = 0; i < 80; i++) {
+        tc_dvfs_job(40);
+    }
+    uint8_t settled = sys->get_dvfs_level();
+    uint32_t misses = 0;
+    for (uint8_t p = 0; p < 16; p++) {
+        misses += sys->get_dvfs_misses(p);
+    }
+    if ((settled < 3) || (settled > 6) || (misses != 0)) {
+        result = TCFAIL;
+    }
+    // 2. a heavier job misses the deadline: back to the maximum
+    tc_dvfs_job(100);
+    if ((sys->get_dvfs_level() != 15) || 
+            (sys->get_dvfs_misses(settled) != 1)) {
+        result = TCFAIL;
+    }
+    if (verbose) sys->print_dvfs_stats();
+    sys->disable_dvfs_governor();
+    sys->set_perf(orig_perf);
+    sys->log_info("DVFS governor settled at perf %d", settled);
+    return result;
+}
+
+int tc_perf_freqs(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_perf_freqs ---\n");
+    uint8_t orig_perf = sys->get_perf();
+    sys->characterise_perf_freqs();
+    int result = sys->is_perf_freq_characterised() ? TCPASS : TCFAIL;
+    for (uint8_t perf = 0; perf < 16; perf++) {
+        uint32_t freq_khz = sys->get_perf_freq_khz(perf);
+        sys->set_perf(perf);
+        if ((freq_khz == 0) || (SystemCoreClock != (freq_khz * 1000))) {
+            result = TCFAIL;
+        }
+        if (verbose) sys->log_info("Perf %d: %d kHz", perf, freq_khz);
+    }
+    sys->set_perf(orig_perf);
+    sys->log_info("SystemCoreClock: %d Hz", SystemCoreClock);
+    return result;
+}
+
+int tc_tcro_tracking(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_tcro_tracking ---\n");
+    uint32_t reference_khz = sys->estimate_tcro();
+    sys->enable_tcro_tracking();
+    // 1. sampled by a 1 ms SoftTimer (PCSM interrupt timer) while busy
+    SoftTimer sample_timer;
+    sample_timer.start_ms(1, NULL, true);
+    RTCTimer busy;
+    busy.set_interval_ms(50);
+    busy.reset();
+    while (!busy.check_interval()) {
+    }
+    uint32_t busy_khz = sys->get_tcro_khz();
+    uint32_t busy_error_ppm = sys->get_tcro_error_ppm();
+    // 2. WFIs (the cycle counter stops) must not pull the estimate down
+    for (uint32_t i = 0; i < 20; i++) {
+        sys->clear_cpu_deepsleep();
+        __WFI();
+        M0N0_refresh_deve();
+    }
+    sample_timer.stop();
+    uint32_t slept_khz = sys->get_tcro_khz();
+    sys->disable_tcro_tracking();
+    int result = TCPASS;
+    // within 5% of the blocking estimate
+    if ((busy_khz * 20 < reference_khz * 19) || 
+            (busy_khz * 20 > reference_khz * 21) ||
+            (slept_khz * 20 < reference_khz * 19) ||
+            (busy_error_ppm > 50000)) {
+        result = TCFAIL;
+    }
+    sys->log_info("TCRO: blocking %d kHz, tracked %d kHz (+/- %d ppm), "
+            "after WFIs %d kHz", reference_khz, busy_khz, busy_error_ppm,
+            slept_khz);
+    return result;
+}
+
+int tc_profile(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_profile ---\n");
+#ifdef M0N0_PROFILE
+    const uint32_t kRepeats = 4;
+    M0N0_profile_reset();
+    RTCTimer busy;
+    busy.set_interval_ms(2);
+    for (uint32_t i = 0; i < kRepeats; i++) {
+        M0N0_PROFILE_SCOPE(tc_profile_busy);
+        busy.reset();
+        while (!busy.check_interval()) {
+        }
+        M0N0_PROFILE_BEGIN(tc_profile_inner);
+        __NOP();
+        M0N0_PROFILE_END(tc_profile_inner);
+    }
+    const M0N0_Profile_Region* outer = NULL;
+    const M0N0_Profile_Region* inner = NULL;
+    for (uint32_t i = 0; M0N0_profile_get_region(i) != NULL; i++) {
+        const M0N0_Profile_Region* region = M0N0_profile_get_region(i);
+        if (strcmp(region->name, "tc_profile_busy") == 0) {
+            outer = region;
+        } else if (strcmp(region->name, "tc_profile_inner") == 0) {
+            inner = region;
+        }
+    }
+    int result = TCPASS;
+    uint32_t min_rtc = (uint32_t)M0N0_System::ms_to_rtc(2);
+    uint8_t perf = sys->get_perf();
+    if ((outer == NULL) || (inner == NULL) || 
+            (outer->count != kRepeats) || (inner->count != kRepeats) ||
+            (outer->rtc_min < min_rtc) || 
+            (outer->cycles_min <= inner->cycles_max) ||
+            (outer->cycles_max < outer->cycles_min) ||
+            (outer->perf_min != perf) || (outer->perf_max != perf)) {
+        result = TCFAIL;
+    }
+    if (outer != NULL) {
+        sys->log_info("Busy: %d cycles (min), %d RTC ticks (min, >= %d)",
+                outer->cycles_min, outer->rtc_min, min_rtc);
+    }
+    if (inner != NULL) {
+        sys->log_info("Inner: %d cycles (max)", inner->cycles_max);
+    }
+    sys->send_profile_via_adp();
+    return result;
+#else
+    sys->log_info("M0N0_PROFILE not defined");
+    return TCPASS;
+#endif
+}
+
+#ifdef M0N0_PC_SAMPLE
+static volatile uint32_t tc_pc_sampling_ticks = 0;
+
+static void tc_pc_sampling_tick(void) {
+    tc_pc_sampling_ticks++;
+}
+
+static void tc_pc_sampling_busy(uint32_t interval_ms) {
+    RTCTimer busy;
+    busy.set_interval_ms(interval_ms);
+    busy.reset();
+    while (!busy.check_interval()) {
+    }
+}
+#endif
+
+int tc_pc_sampling(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_pc_sampling ---\n");
+#ifdef M0N0_PC_SAMPLE
+    const uint32_t kMaxOverheadPpm = 50000;
+    uint32_t period = SystemCoreClock / 1000;
+    int result = TCPASS;
+    // 1. chained with an existing SysTick callback
+    sys->enable_systick(period - 1, &tc_pc_sampling_tick);
+    sys->start_pc_sampling(period);
+    tc_pc_sampling_ticks = 0;
+    tc_pc_sampling_busy(50);
+    sys->stop_pc_sampling();
+    uint32_t ticks = tc_pc_sampling_ticks;
+    uint32_t chained_samples = M0N0_pc_sample_get_stats()->samples;
+    bool kept = (SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) != 0;
+    sys->disable_systick();
+    if (!kept || (chained_samples < 25) || 
+            (ticks + 1 < chained_samples) || (ticks > chained_samples + 1)) {
+        result = TCFAIL;
+    }
+    sys->log_info("Chained: %d samples, %d callbacks", chained_samples, ticks);
+    // 2. the SysTick is enabled (and disabled) by the profiler
+    sys->start_pc_sampling(period);
+    tc_pc_sampling_busy(50);
+    sys->stop_pc_sampling();
+    const M0N0_PC_Sample_Stats* stats = M0N0_pc_sample_get_stats();
+    uint32_t binned = 0;
+    for (uint32_t i = 0; i < M0N0_PC_SAMPLE_BINS; i++) {
+        binned += M0N0_pc_sample_get_bins()[i];
+    }
+    uint32_t overhead_ppm = M0N0_pc_sample_overhead_ppm();
+    if ((SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) || 
+            (stats->samples < 25) ||
+            (binned + stats->out_of_range != stats->samples) ||
+            (overhead_ppm > kMaxOverheadPpm)) {
+        result = TCFAIL;
+    }
+    sys->log_info("Samples: %d (%d out of range), ISR: %d cycles (max), "
+            "overhead: %d ppm", stats->samples, stats->out_of_range, 
+            stats->isr_cycles_max, overhead_ppm);
+    sys->send_pc_samples_via_adp();
+    return result;
+#else
+    sys->log_info("M0N0_PC_SAMPLE not defined");
+    return TCPASS;
+#endif
+}
+
+static volatile uint32_t tc_irq_latency_cycles = 0;
+static volatile bool tc_irq_latency_called = false;
+
+static void tc_irq_latency_callback(void) {
+    tc_irq_latency_cycles = DWT->CYCCNT;
+    tc_irq_latency_called = true;
+}
+
+int tc_irq_latency(uint32_t verbose) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    if (verbose) sys->print("--- tc_irq_latency ---\n");
+    const uint32_t kRepeats = 256;
+    const uint32_t kMaxLatency = 1000; // (sanity check)
+    const uint32_t kTimeout = (uint32_t)M0N0_System::ms_to_rtc(10);
+    M0N0_cyccnt_enable();
+    // the interval is long enough for the timer not to fire in the test
+    sys->enable_pcsm_interrupt_timer_ms(1000, &tc_irq_latency_callback);
+    uint32_t min = 0xFFFFFFFF;
+    uint32_t max = 0;
+    uint32_t total = 0;
+    int result = TCPASS;
+    for (uint32_t i = 0; i < kRepeats; i++) {
+        tc_irq_latency_called = false;
+        uint32_t start = DWT->CYCCNT;
+        __NVIC_SetPendingIRQ(Interrupt5_IRQn);
+        __DSB();
+        __ISB();
+        uint32_t rtc_start = M0N0_System::get_rtc_lsbs();
+        while (!tc_irq_latency_called) {
+            if (M0N0_System::rtc_elapsed(rtc_start) > kTimeout) {
+                sys->disable_pcsm_interrupt_timer();
+                sys->log_error("IRQ5 callback not called (repeat %d)", i);
+                return TCFAIL;
+            }
+        }
+        uint32_t latency = tc_irq_latency_cycles - start;
+        min = (latency < min) ? latency : min;
+        max = (latency > max) ? latency : max;
+        total += latency;
+    }
+    sys->disable_pcsm_interrupt_timer();
+    if (max > kMaxLatency) {
+        result = TCFAIL;
+    }
+    sys->log_info("IRQ5 pend to callback: %d/%d/%d cycles (min/mean/max)", 
+            min, total / kRepeats, max);
+    return result;
+}
+
 // End: System Tests
 
 
@@ -224,8 +1041,8 @@ int tc_funcs_run_testcase(testcase_id_t tc, uint32_t verbose, uint64_t repeat_de
     // 0, off
     // RTC delay
     uint64_t rtc_start = sys->get_rtc();
-    sys->print("Repeat delay: 0x%x%x, RTC Start: 0x%x%x)\n",
-          (uint32_t)(repeat_delay>>32),(uint32_t)repeat_delay,(uint32_t)(rtc_start>>32),(uint32_t)rtc_start);
+    sys->print("Repeat delay: 0x%llx, RTC Start: 0x%llx)\n",
+          repeat_delay, rtc_start);
     uint64_t rtc_cur = sys->get_rtc();
     int temp_result = 0; 
     do {
@@ -241,8 +1058,7 @@ int tc_funcs_run_testcase(testcase_id_t tc, uint32_t verbose, uint64_t repeat_de
       temp_result += (tc_fncs[tc])(0);
       rtc_cur = sys->get_rtc();
     } while ((rtc_cur - rtc_start) <= repeat_delay);
-    sys->print("Finished power loop, rtc_cur: 0x%x%x)\n",
-          (uint32_t)(rtc_cur>>32),(uint32_t)rtc_cur);
+    sys->print("Finished power loop, rtc_cur: 0x%llx)\n", rtc_cur);
     sys->print("Temp result: %d\n",temp_result);
   }
   // 2. run function
@@ -33,6 +33,9 @@ import time
 
 import silicon_libs.testchip as testchip
 import silicon_libs.utils as utils
+import silicon_libs.reg_trace as reg_trace
+import silicon_libs.region_profile as region_profile
+import silicon_libs.pc_sample as pc_sample
 
 # Paths
 LOG_FILEPATH = os.path.join('logs', 'adpdev.log')
@@ -58,8 +61,19 @@ def main(params, logger):
     # Pass special callbacks for interpreting M0N0 STDOUT
     # for general ADPDev testing, these are not required:
     audio_reader = utils.AudioReader(logger)
+    reg_trace_reader = reg_trace.RegTraceReader(logger)
+    profile_reader = region_profile.ProfileReader(logger)
+    # the ELF file (copied to the software directory by make) symbolises
+    # the PC samples
+    elf_path = os.path.join(params['software'], 'm0n0.elf')
+    pc_sample_reader = pc_sample.PcSampleReader(
+            logger, 
+            elf_path if os.path.isfile(elf_path) else None)
     chip.set_adp_tx_callbacks({
-        'demoboard_audio': audio_reader.demoboard_audio
+        'demoboard_audio': audio_reader.demoboard_audio,
+        'reg_trace': reg_trace_reader.reg_trace,
+        'profile': profile_reader.profile,
+        'pc_samples': pc_sample_reader.pc_samples
     })
     # Custom code can go here
     # Go to an interactive python prompt:
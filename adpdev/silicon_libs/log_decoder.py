@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+################################################################################
+# Copyright (c) 2020, Arm Limited
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the <organization> nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+################################################################################
+
+"""Decodes the tokenized log messages sent by M0N0 (M0N0_LOG_TOKENIZED)
+
+With M0N0_LOG_TOKENIZED, the log_* functions only record the ID of the format
+string (its offset in the "m0n0_fmt" ELF section, which is not loaded on the
+chip) and the raw 32-bit arguments. The records are sent to STDOUT as base64
+lines:
+
+    3d7db2ae_log:<base64 of the little endian 32-bit words>
+
+Each record is a header word (ID in bits 19:0, number of argument words in bits
+23:20 and the level in bits 25:24) followed by the arguments. The format 
+strings are read from the ELF file of the software (copied to the build 
+directory by "make"). 
+
+Can be run on a saved STDOUT log:
+
+    python3 -m silicon_libs.log_decoder logs/stdout.log --elf m0n0.elf
+"""
+
+import re
+import struct
+import base64
+import logging
+
+LOG_LINE_REGEX = r"3d7db2ae_log:([A-Za-z0-9+/=]+)"
+FMT_SECTION_NAME = 'm0n0_fmt'
+LEVEL_PREFIXES = ["DEBUG: ", "INFO:  ", "WARN:  ", "ERROR: "]
+PRINTF_SPEC_REGEX = r"%([-0]*)(\d*)(?:\.(\d*))?(l*)(q\d*|[duxXcs%])"
+Q_DEFAULT_DIGITS = 4
+Q_MAX_DIGITS = 9
+ELF_SHF_ALLOC = 0x2
+ELF_SHT_NOBITS = 8
+
+
+class ElfSections:
+    """Minimal ELF (32 or 64-bit, little endian) section reader
+    """
+    def __init__(self, elf_path):
+        with open(elf_path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF':
+            raise ValueError("Not an ELF file: {}".format(elf_path))
+        is_64 = data[4] == 2
+        self.is_64 = is_64
+        if is_64:
+            shoff, = struct.unpack_from('<Q', data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x3A)
+            sh_fmt = '<IIQQQQIIQQ'
+        else:
+            shoff, = struct.unpack_from('<I', data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x2E)
+            sh_fmt = '<IIIIIIIIII'
+        headers = [struct.unpack_from(sh_fmt, data, shoff + i*shentsize)
+                   for i in range(shnum)]
+        strtab = headers[shstrndx]
+        strtab_data = data[strtab[4]:strtab[4]+strtab[5]]
+        # name -> (address, flags, contents)
+        self.sections = {}
+        for name_off, sh_type, flags, addr, offset, size in \
+                (h[:6] for h in headers):
+            name = strtab_data[name_off:strtab_data.index(b'\0', name_off)]
+            contents = b'' if sh_type == ELF_SHT_NOBITS else \
+                    data[offset:offset+size]
+            self.sections[name.decode('ascii')] = (addr, flags, contents)
+
+    def read_string(self, address):
+        """Reads a null terminated string from a loaded section
+
+        :param address: The address of the string on the target
+        :type address: int
+        :return: The string, or None if not in a loaded section
+        :rtype: str
+        """
+        for addr, flags, contents in self.sections.values():
+            if (flags & ELF_SHF_ALLOC) and addr <= address < addr+len(contents):
+                start = address - addr
+                end = contents.find(b'\0', start)
+                end = len(contents) if end < 0 else end
+                return contents[start:end].decode('utf-8', 'replace')
+        return None
+
+
+def format_message(fmt, args, read_string=None):
+    """Formats a message using the simple printf subset supported by M0N0
+    (d, u, x, X, c, s with optional '0'/'-' flags and width, "ll" for 64-bit
+    integers, which use two words, and q<bits> for fixed-point values)
+
+    :param fmt: The format string
+    :type fmt: str
+    :param args: The raw 32-bit arguments
+    :type args: list of int
+    :param read_string: Function for reading a string (for %s) from an
+                        address, returns None if it is not known
+    :type read_string: function
+    :return: The formatted message
+    :rtype: str
+    """
+    args = list(args)
+    def replace(match):
+        flags, width, precision, length, spec = match.groups()
+        if spec == '%':
+            return '%'
+        if not args:
+            return '<missing>'
+        value = args.pop(0)
+        bits = 32
+        if len(length) >= 2 and spec in 'duxX':
+            value |= (args.pop(0) if args else 0) << 32
+            bits = 64
+        if spec == 'd':
+            text = str(value - (1 << bits) if value >> (bits - 1) else value)
+        elif spec == 'u':
+            text = str(value)
+        elif spec == 'x':
+            text = "{:x}".format(value)
+        elif spec == 'X':
+            text = "{:X}".format(value)
+        elif spec == 'c':
+            text = chr(value & 0xFF)
+        elif spec[0] == 'q':
+            frac_bits = min(int(spec[1:] or 0), 31)
+            digits = Q_DEFAULT_DIGITS if precision is None else \
+                    min(int(precision or 0), Q_MAX_DIGITS)
+            signed = value - (1 << 32) if value & 0x80000000 else value
+            # round half up (away from zero) as on M0N0
+            scaled = (abs(signed) * (10 ** digits) * 2 + (1 << frac_bits)) \
+                    // (1 << (frac_bits + 1))
+            text = "{}{}".format('-' if signed < 0 else '', 
+                                 scaled // (10 ** digits))
+            if digits:
+                text += ".{:0{}d}".format(scaled % (10 ** digits), digits)
+        else:
+            text = read_string(value) if read_string else None
+            if text is None:
+                text = "<0x{:08X}>".format(value)
+        width = int(width) if width else 0
+        if '-' in flags:
+            return text.ljust(width)
+        if '0' in flags and spec != 's':
+            if text.startswith('-'):
+                return '-' + text[1:].rjust(width - 1, '0')
+            return text.rjust(width, '0')
+        return text.rjust(width)
+    return re.sub(PRINTF_SPEC_REGEX, replace, fmt)
+
+
+class LogDecoder:
+    """Class for decoding the tokenized log messages using the ELF file
+    """
+    def __init__(self, elf_path):
+        self._elf = ElfSections(elf_path)
+        if FMT_SECTION_NAME not in self._elf.sections:
+            raise ValueError("No {} section in {} (not built with "
+                             "M0N0_LOG_TOKENIZED?)".format(
+                                     FMT_SECTION_NAME, elf_path))
+        self._fmt_data = self._elf.sections[FMT_SECTION_NAME][2]
+
+    def get_format(self, fmt_id):
+        """Gets the format string from its ID
+
+        :param fmt_id: The format string ID (offset in the m0n0_fmt section)
+        :type fmt_id: int
+        :return: The format string
+        :rtype: str
+        """
+        if fmt_id >= len(self._fmt_data):
+            return "<unknown log ID 0x{:X}>".format(fmt_id)
+        end = self._fmt_data.find(b'\0', fmt_id)
+        return self._fmt_data[fmt_id:end].decode('utf-8', 'replace')
+
+    def decode_words(self, words):
+        """Decodes the records in a list of words
+
+        :param words: The 32-bit words received from M0N0
+        :type words: list of int
+        :return: The messages (with the level prefix)
+        :rtype: list of str
+        """
+        lines = []
+        i = 0
+        while i < len(words):
+            header = words[i]
+            nargs = (header >> 20) & 0xF
+            level = (header >> 24) & 0x3
+            args = words[i+1:i+1+nargs]
+            i += 1 + nargs
+            lines.append(LEVEL_PREFIXES[level] + format_message(
+                    self.get_format(header & 0xFFFFF),
+                    args,
+                    self._elf.read_string))
+        return lines
+
+    def decode_line(self, encoded):
+        """Decodes the base64 part of a "3d7db2ae_log:" line
+
+        :param encoded: The base64 text
+        :type encoded: str
+        :return: The messages
+        :rtype: list of str
+        """
+        raw = base64.b64decode(encoded)
+        words = list(struct.unpack('<{:d}I'.format(len(raw)//4), 
+                                   raw[:len(raw) - (len(raw) % 4)]))
+        return self.decode_words(words)
+
+    def decode_text(self, text):
+        """Replaces the "3d7db2ae_log:" lines in M0N0 STDOUT text with the
+        decoded messages
+
+        :param text: The STDOUT text (e.g. from a log file)
+        :type text: str
+        :return: The text with the messages decoded
+        :rtype: str
+        """
+        return re.sub(
+                LOG_LINE_REGEX,
+                lambda m: '\n'.join(self.decode_line(m.group(1))),
+                text.replace('<', '').replace('>', ''))
+
+
+if __name__ == "__main__":
+    import argparse
+    parser = argparse.ArgumentParser(
+            description="Decodes the tokenized log messages "
+                        "(M0N0_LOG_TOKENIZED) in a STDOUT log")
+    parser.add_argument(
+            'log_file',
+            help="File containing the M0N0 STDOUT")
+    parser.add_argument(
+            '--elf',
+            required=True,
+            help="The ELF file of the software running on M0N0")
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(message)s')
+    decoder = LogDecoder(args.elf)
+    with open(args.log_file, 'r') as f:
+        text = f.read()
+    print(decoder.decode_text(text), end='')
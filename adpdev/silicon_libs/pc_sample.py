@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+################################################################################
+# Copyright (c) 2020, Arm Limited
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the <organization> nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+################################################################################
+
+
+"""Symbolises the PC sampling histograms recorded by M0N0 (M0N0_PC_SAMPLE)
+
+M0N0_System::send_pc_samples_via_adp (or M0N0_pc_sample_send_via_adp in C)
+sends the histogram as an ADP transaction named "pc_samples". The parameters
+are the histogram layout (base and bin_size), the sample counts and the 
+overhead of the sampling (the cycles spent counting the samples and the 
+sampled cycles). The payload has one "address count" line per non-empty bin.
+
+Each bin is attributed to the function symbols (from the ELF file copied to
+the project build directory by "make") that it overlaps, in proportion to
+the overlap, so the bin size should be small compared to the functions (see
+M0N0_PC_SAMPLE_BINS). 
+
+Can be used as an ADP TX callback (see PcSampleReader) or run on a saved
+STDOUT log:
+
+    python3 -m silicon_libs.pc_sample logs/stdout.log --elf m0n0.elf
+"""
+
+import re
+import struct
+import bisect
+import logging
+import collections
+
+from silicon_libs.log_decoder import ElfSections
+from silicon_libs.region_profile import parse_params
+
+ADP_TX_REGEX = r"3d7db2ae_tx_start<<pc_samples>>\n(([\s\S]*?)(3d7db2ae_params_end))?([\s\S]*?)3d7db2ae_tx_end<<pc_samples>>"
+ELF_STT_FUNC = 2
+UNKNOWN_NAME = "(unknown)"
+
+FunctionSymbol = collections.namedtuple(
+        'FunctionSymbol', ['address', 'size', 'name'])
+
+
+def load_function_symbols(elf_path):
+    """Reads the function symbols from the symbol table of an ELF file
+
+    :param elf_path: The ELF file of the software
+    :type elf_path: str
+    :return: The functions, sorted by address (the Thumb bit is cleared)
+    :rtype: list of FunctionSymbol
+    """
+    elf = ElfSections(elf_path)
+    if '.symtab' not in elf.sections or '.strtab' not in elf.sections:
+        raise ValueError("No symbol table in {}".format(elf_path))
+    symtab = elf.sections['.symtab'][2]
+    strtab = elf.sections['.strtab'][2]
+    if elf.is_64:
+        entry_size = 24
+        def unpack(offset):
+            name, info, _, _, value, size = struct.unpack_from(
+                    '<IBBHQQ', symtab, offset)
+            return name, value, size, info
+    else:
+        entry_size = 16
+        def unpack(offset):
+            name, value, size, info, _, _ = struct.unpack_from(
+                    '<IIIBBH', symtab, offset)
+            return name, value, size, info
+    functions = {}
+    for offset in range(0, len(symtab) - entry_size + 1, entry_size):
+        name_off, value, size, info = unpack(offset)
+        if (info & 0xF) != ELF_STT_FUNC or size == 0:
+            continue
+        name = strtab[name_off:strtab.index(b'\0', name_off)].decode(
+                'utf-8', 'replace')
+        functions[value & ~1] = FunctionSymbol(value & ~1, size, name)
+    return sorted(functions.values())
+
+
+def parse_histogram(tx_payload):
+    """Converts the payload of a "pc_samples" ADP TX to a list of bins
+
+    :param tx_payload: The raw text from the payload of the ADP TX
+    :type tx_payload: str
+    :return: List of (bin address, count)
+    :rtype: list of tuple
+    """
+    bins = []
+    for line in tx_payload.strip().split('\n'):
+        fields = line.split()
+        if len(fields) != 2:
+            continue
+        try:
+            bins.append((int(fields[0], 0), int(fields[1], 0)))
+        except ValueError:
+            continue # (not a bin line)
+    return bins
+
+
+def attribute_samples(bins, bin_size, functions):
+    """Shares the count of each bin between the functions it overlaps
+
+    :param bins: List of (bin address, count)
+    :type bins: list of tuple
+    :param bin_size: The size of each bin (bytes)
+    :type bin_size: int
+    :param functions: The function symbols, sorted by address
+    :type functions: list of FunctionSymbol
+    :return: The (fractional) samples per function name
+    :rtype: dict
+    """
+    starts = [f.address for f in functions]
+    samples = collections.defaultdict(float)
+    for address, count in bins:
+        end = address + bin_size
+        # the functions that start before the end of the bin
+        i = bisect.bisect_left(starts, end) - 1
+        covered = 0
+        while i >= 0 and functions[i].address + functions[i].size > address:
+            overlap = min(end, functions[i].address + functions[i].size) - \
+                    max(address, functions[i].address)
+            samples[functions[i].name] += count * overlap / bin_size
+            covered += overlap
+            i -= 1
+        if covered < bin_size:
+            samples[UNKNOWN_NAME] += count * (bin_size - covered) / bin_size
+    return samples
+
+
+def summarise(params, bins, functions=None, max_rows=20):
+    """Creates a text summary of the samples and the sampling overhead
+
+    :param params: The parameters of the ADP TX
+    :type params: dict
+    :param bins: List of (bin address, count)
+    :type bins: list of tuple
+    :param functions: The function symbols (None: the bins are listed)
+    :type functions: list of FunctionSymbol
+    :param max_rows: The maximum number of functions (or bins) listed
+    :type max_rows: int
+    :return: The summary
+    :rtype: str
+    """
+    samples = params.get('samples', sum(x[1] for x in bins))
+    res = "Samples: {:d} ({:d} out of range), every {} cycles\n".format(
+            samples, params.get('out_of_range', 0),
+            params.get('period_cycles', '?'))
+    if 'overhead_ppm' in params:
+        res += "Overhead: {:.3f}% ({} cycles max per sample, excluding the "\
+               "exception entry/exit)\n".format(
+                    params['overhead_ppm'] / 1e4, 
+                    params.get('isr_cycles_max', '?'))
+    bin_size = params.get('bin_size', 1)
+    if functions:
+        rows = attribute_samples(bins, bin_size, functions).items()
+        res += "{:<40} {:>10} {:>8}\n".format("Function", "Samples", "%")
+    else:
+        rows = [("0x{:08X}".format(a), c) for a, c in bins]
+        res += "{:<40} {:>10} {:>8}\n".format("Bin", "Samples", "%")
+    for name, count in sorted(rows, key=lambda x: -x[1])[:max_rows]:
+        res += "{:<40} {:>10.1f} {:>8.1f}\n".format(
+                name, count, (100.0 * count / samples) if samples else 0)
+    return res
+
+
+class PcSampleReader:
+    """Class for symbolising "pc_samples" ADP transactions received from M0N0
+    """
+    def __init__(self, logger, elf_path=None):
+        self._logger = logger
+        self._functions = load_function_symbols(elf_path) if elf_path \
+                else None
+        self.params = {}
+        self.bins = []
+
+    def pc_samples(self, tx_name, tx_params, tx_payload):
+        """Decodes the histogram received via the ADP TX and logs a summary
+        
+        :param tx_name: The name of the transaction
+        :type tx_name: str
+        :param tx_params: The raw text from the parameter part of the ADP TX
+        :type tx_params: str
+        :param tx_payload: The raw text from the payload of the ADP TX
+        :type tx_payload: str
+        """
+        self.params = parse_params(tx_params)
+        self.bins = parse_histogram(tx_payload)
+        self._logger.info("PC samples ({}):\n{}".format(
+                tx_name,
+                summarise(self.params, self.bins, self._functions)))
+
+
+if __name__ == "__main__":
+    import argparse
+    parser = argparse.ArgumentParser(
+            description="Symbolises the PC sampling histograms "
+                        "(pc_samples ADP transactions) in a STDOUT log")
+    parser.add_argument(
+            'log_file',
+            help="File containing the M0N0 STDOUT")
+    parser.add_argument(
+            '--elf',
+            required=False,
+            default=None,
+            help="ELF file of the software (the bins are listed without it)")
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(message)s')
+    reader = PcSampleReader(logging.getLogger(__name__), args.elf)
+    with open(args.log_file, 'r') as f:
+        text = f.read()
+    for match in re.finditer(ADP_TX_REGEX, text):
+        reader.pc_samples('pc_samples', match.group(2), match.group(4))
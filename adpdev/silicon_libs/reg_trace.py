@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+################################################################################
+# Copyright (c) 2020, Arm Limited
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the <organization> nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+################################################################################
+
+"""Summarises register access traces recorded by M0N0 (M0N0_REG_TRACE)
+
+The REG_TRACE_TC testcase sends the trace as an ADP transaction named
+"reg_trace", with one "rtc address value" line per access (bit 0 of the
+address is set for writes). The accesses are grouped by register name using
+the YAML register models, and the PCSM writes made through the SPI (SS3) are
+decoded. 
+
+Can be used as an ADP TX callback (see RegTraceReader) or run on a saved
+STDOUT log:
+
+    python3 -m silicon_libs.reg_trace logs/stdout.log
+"""
+
+import os
+import re
+import glob
+import logging
+import collections
+import yaml
+
+REG_MODELS_DIR = os.path.join('registers_models', 'M0N0S2')
+ADP_TX_REGEX = r"3d7db2ae_tx_start<<reg_trace>>\n(([\s\S]*?)(3d7db2ae_params_end))?([\s\S]*?)3d7db2ae_tx_end<<reg_trace>>"
+WRITE_FLAG = 0x1
+SPI_CONTROL_ADDR = 0xB8000014
+SPI_DATA_WRITE_ADDR = 0xB8000008
+SPI_CHIP_SELECT_MASK = 0x78
+SPI_CHIP_SELECT_SHIFT = 3
+SPI_SS_PCSM = 8 # SS3
+
+TraceEntry = collections.namedtuple(
+        'TraceEntry', ['rtc', 'address', 'is_write', 'value'])
+
+
+def load_register_names(models_dir=REG_MODELS_DIR):
+    """Creates a dictionary of register names from the YAML register models
+
+    :param models_dir: The directory containing the *.regs.yaml and 
+                       mem_map.map.yaml files
+    :type models_dir: str
+    :return: Tuple of the register names (address -> name), the PCSM 
+             register names (PCSM address -> name) and the memory map regions
+             (list of (base, size, name))
+    :rtype: tuple
+    """
+    names = {}
+    pcsm_names = {}
+    for path in sorted(glob.glob(os.path.join(models_dir, '*.regs.yaml'))):
+        periph = os.path.basename(path).split('.')[0].upper()
+        with open(path, 'r') as f:
+            model = yaml.safe_load(f)
+        if 'base_addr' not in model:
+            # PCSM (accessed through the SPI)
+            for addr, reg in model['registers'].items():
+                pcsm_names[addr] = "PCSM.{}".format(reg['name'])
+            continue
+        base = model['base_addr']
+        offset = model.get('reg_offset', 4)
+        for index, reg in model['registers'].items():
+            address = base + (index * offset)
+            names[address] = "{}.{}".format(periph, reg['name'])
+            if 'set_addr_offset' in model:
+                names[address + model['set_addr_offset']] = \
+                        "{}.{} (set)".format(periph, reg['name'])
+            if 'clr_addr_offset' in model:
+                names[address + model['clr_addr_offset']] = \
+                        "{}.{} (clear)".format(periph, reg['name'])
+    regions = []
+    def add_regions(mem_map):
+        for submap in mem_map.get('submaps', []):
+            if 'submaps' in submap:
+                add_regions(submap)
+            else:
+                regions.append(
+                        (submap['base'], submap['size'], submap['name']))
+    map_path = os.path.join(models_dir, 'mem_map.map.yaml')
+    if os.path.exists(map_path):
+        with open(map_path, 'r') as f:
+            add_regions(yaml.safe_load(f))
+    return names, pcsm_names, regions
+
+
+def parse_trace(tx_payload):
+    """Converts the payload of a "reg_trace" ADP TX to a list of entries
+
+    :param tx_payload: The raw text from the payload of the ADP TX
+    :type tx_payload: str
+    :return: The accesses, oldest first
+    :rtype: list of TraceEntry
+    """
+    entries = []
+    for line in tx_payload.strip().split('\n'):
+        fields = line.split()
+        if len(fields) != 3:
+            continue
+        address = int(fields[1], 0)
+        entries.append(TraceEntry(
+                rtc=int(fields[0], 0),
+                address=address & ~WRITE_FLAG,
+                is_write=bool(address & WRITE_FLAG),
+                value=int(fields[2], 0)))
+    return entries
+
+
+def decode_pcsm_writes(entries):
+    """Finds the PCSM writes (4 SPI bytes to SS3: address, then 24 data bits)
+
+    :param entries: The trace entries
+    :type entries: list of TraceEntry
+    :return: List of (PCSM address, data, number of register accesses used)
+    :rtype: list of tuple
+    """
+    writes = []
+    selected = False
+    data_bytes = []
+    start = 0
+    for i, entry in enumerate(entries):
+        if entry.address == SPI_CONTROL_ADDR and entry.is_write:
+            cs = (entry.value & SPI_CHIP_SELECT_MASK) >> SPI_CHIP_SELECT_SHIFT
+            if cs == SPI_SS_PCSM and not selected:
+                selected = True
+                data_bytes = []
+                start = i
+            elif cs != SPI_SS_PCSM and selected:
+                selected = False
+                if len(data_bytes) == 4:
+                    writes.append((
+                            data_bytes[0],
+                            (data_bytes[1] << 16) | (data_bytes[2] << 8) | 
+                            data_bytes[3],
+                            i + 1 - start))
+        elif selected and entry.address == SPI_DATA_WRITE_ADDR and \
+                entry.is_write:
+            data_bytes.append(entry.value & 0xFF)
+    return writes
+
+
+def summarise(entries, names, pcsm_names=None, regions=None):
+    """Creates a text summary of the accesses grouped by register
+
+    :param entries: The trace entries
+    :type entries: list of TraceEntry
+    :param names: Register names (address -> name)
+    :type names: dict
+    :param pcsm_names: PCSM register names (PCSM address -> name)
+    :type pcsm_names: dict
+    :param regions: Memory map regions (list of (base, size, name))
+    :type regions: list
+    :return: The summary
+    :rtype: str
+    """
+    pcsm_names = pcsm_names or {}
+    regions = regions or []
+    def get_name(address):
+        if address in names:
+            return names[address]
+        for base, size, name in regions:
+            if base <= address < (base + size):
+                return "{}+0x{:X}".format(name, address - base)
+        return "0x{:08X}".format(address)
+    counts = collections.OrderedDict()
+    for entry in entries:
+        name = get_name(entry.address)
+        if name not in counts:
+            counts[name] = [0, 0]
+        counts[name][1 if entry.is_write else 0] += 1
+    res = "Register accesses: {:d}".format(len(entries))
+    if entries:
+        res += " over {:d} RTC ticks".format(entries[-1].rtc - entries[0].rtc)
+    res += "\n{:<32} {:>8} {:>8} {:>8}\n".format(
+            "Register", "Reads", "Writes", "Total")
+    for name, (reads, writes) in sorted(
+            counts.items(), key=lambda x: -sum(x[1])):
+        res += "{:<32} {:>8d} {:>8d} {:>8d}\n".format(
+                name, reads, writes, reads + writes)
+    pcsm_writes = decode_pcsm_writes(entries)
+    if pcsm_writes:
+        res += "PCSM writes: {:d}\n".format(len(pcsm_writes))
+        for address, data, accesses in pcsm_writes:
+            res += "    {:<28} = 0x{:06X} ({:d} register accesses)\n".format(
+                    pcsm_names.get(address, "PCSM.0x{:02X}".format(address)),
+                    data,
+                    accesses)
+    return res
+
+
+class RegTraceReader:
+    """Class for summarising "reg_trace" ADP transactions received from M0N0
+    """
+    def __init__(self, logger, models_dir=REG_MODELS_DIR):
+        self._logger = logger
+        self._names, self._pcsm_names, self._regions = \
+                load_register_names(models_dir)
+        self.entries = []
+
+    def reg_trace(self, tx_name, tx_params, tx_payload):
+        """Decodes the trace received via the ADP TX and logs a summary
+        
+        :param tx_name: The name of the transaction
+        :type tx_name: str
+        :param tx_params: The raw text from the parameter part of the ADP TX
+        :type tx_params: str
+        :param tx_payload: The raw text from the payload of the ADP TX
+        :type tx_payload: str
+        """
+        if tx_params and tx_params.strip():
+            self._logger.info("Trace parameters: {}".format(
+                    ", ".join(x.strip() for x in tx_params.strip().split('\n'))))
+        self.entries = parse_trace(tx_payload)
+        self._logger.info("Register trace ({}):\n{}".format(
+                tx_name,
+                summarise(
+                        self.entries,
+                        self._names,
+                        self._pcsm_names,
+                        self._regions)))
+
+
+if __name__ == "__main__":
+    import argparse
+    parser = argparse.ArgumentParser(
+            description="Summarises the register access traces "
+                        "(reg_trace ADP transactions) in a STDOUT log")
+    parser.add_argument(
+            'log_file',
+            help="File containing the M0N0 STDOUT")
+    parser.add_argument(
+            '--models-dir',
+            required=False,
+            default=REG_MODELS_DIR,
+            help="Directory of the YAML register models")
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(message)s')
+    reader = RegTraceReader(logging.getLogger(__name__), args.models_dir)
+    with open(args.log_file, 'r') as f:
+        text = f.read()
+    for match in re.finditer(ADP_TX_REGEX, text):
+        reader.reg_trace('reg_trace', match.group(2), match.group(4))
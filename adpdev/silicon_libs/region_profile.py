@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+################################################################################
+# Copyright (c) 2020, Arm Limited
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the <organization> nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+################################################################################
+
+
+"""Summarises the region profiles recorded by M0N0 (M0N0_PROFILE)
+
+M0N0_System::send_profile_via_adp (or M0N0_profile_send_via_adp in C) sends 
+the profile as an ADP transaction named "profile", with one "name count 
+cycles_min cycles_max cycles_total rtc_min rtc_max rtc_total perf_min 
+perf_max" line per region. The cycles are the DWT cycle count (at the core
+frequency of the region), the RTC ticks are converted to us with the 
+rtc_freq_millihz parameter (the RTC calibration, in mHz) when it is sent. 
+
+Can be used as an ADP TX callback (see ProfileReader) or run on a saved
+STDOUT log:
+
+    python3 -m silicon_libs.region_profile logs/stdout.log
+"""
+
+import re
+import logging
+import collections
+
+ADP_TX_REGEX = r"3d7db2ae_tx_start<<profile>>\n(([\s\S]*?)(3d7db2ae_params_end))?([\s\S]*?)3d7db2ae_tx_end<<profile>>"
+NOMINAL_RTC_FREQ_MILLIHZ = 33000000 # used if the RTC is not calibrated
+
+ProfileRegion = collections.namedtuple(
+        'ProfileRegion', [
+            'name', 'count', 
+            'cycles_min', 'cycles_max', 'cycles_total',
+            'rtc_min', 'rtc_max', 'rtc_total',
+            'perf_min', 'perf_max'])
+
+
+def parse_params(tx_params):
+    """Converts the "key : value" parameters of the ADP TX to a dictionary
+
+    :param tx_params: The raw text from the parameter part of the ADP TX
+    :type tx_params: str
+    :return: The parameters (integer values converted)
+    :rtype: dict
+    """
+    params = {}
+    for line in (tx_params or '').strip().split('\n'):
+        if ':' not in line:
+            continue
+        key, value = [x.strip() for x in line.split(':', 1)]
+        try:
+            params[key] = int(value, 0)
+        except ValueError:
+            params[key] = value
+    return params
+
+
+def parse_profile(tx_payload):
+    """Converts the payload of a "profile" ADP TX to a list of regions
+
+    :param tx_payload: The raw text from the payload of the ADP TX
+    :type tx_payload: str
+    :return: The regions (in the order they were first entered)
+    :rtype: list of ProfileRegion
+    """
+    regions = []
+    for line in tx_payload.strip().split('\n'):
+        fields = line.split()
+        if len(fields) != len(ProfileRegion._fields):
+            continue
+        try:
+            regions.append(ProfileRegion(
+                    fields[0], *[int(x, 0) for x in fields[1:]]))
+        except ValueError:
+            continue # (not a region line)
+    return regions
+
+
+def summarise(regions, rtc_freq_millihz=NOMINAL_RTC_FREQ_MILLIHZ):
+    """Creates a text table of the regions
+
+    :param regions: The profiled regions
+    :type regions: list of ProfileRegion
+    :param rtc_freq_millihz: The RTC frequency (in mHz)
+    :type rtc_freq_millihz: int
+    :return: The summary
+    :rtype: str
+    """
+    if not rtc_freq_millihz:
+        rtc_freq_millihz = NOMINAL_RTC_FREQ_MILLIHZ
+    def to_us(ticks):
+        return ticks * 1e9 / rtc_freq_millihz
+    res = "{:<16} {:>6} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>5}\n".format(
+            "Region", "Count", 
+            "Cyc min", "Cyc mean", "Cyc max", 
+            "us min", "us mean", "us max", "Perf")
+    for r in regions:
+        if r.count == 0:
+            continue
+        perf = "{:d}".format(r.perf_min) if r.perf_min == r.perf_max \
+                else "{:d}-{:d}".format(r.perf_min, r.perf_max)
+        res += "{:<16} {:>6d} {:>10d} {:>10d} {:>10d} {:>10.0f} {:>10.0f} {:>10.0f} {:>5}\n".format(
+                r.name, r.count,
+                r.cycles_min, r.cycles_total // r.count, r.cycles_max,
+                to_us(r.rtc_min), to_us(r.rtc_total / r.count), 
+                to_us(r.rtc_max), perf)
+    return res
+
+
+class ProfileReader:
+    """Class for summarising "profile" ADP transactions received from M0N0
+    """
+    def __init__(self, logger):
+        self._logger = logger
+        self.regions = []
+        self.params = {}
+
+    def profile(self, tx_name, tx_params, tx_payload):
+        """Decodes the profile received via the ADP TX and logs a table
+        
+        :param tx_name: The name of the transaction
+        :type tx_name: str
+        :param tx_params: The raw text from the parameter part of the ADP TX
+        :type tx_params: str
+        :param tx_payload: The raw text from the payload of the ADP TX
+        :type tx_payload: str
+        """
+        self.params = parse_params(tx_params)
+        self.regions = parse_profile(tx_payload)
+        self._logger.info("Region profile ({}):\n{}".format(
+                tx_name,
+                summarise(
+                        self.regions,
+                        self.params.get('rtc_freq_millihz', 
+                                        NOMINAL_RTC_FREQ_MILLIHZ))))
+
+
+if __name__ == "__main__":
+    import argparse
+    parser = argparse.ArgumentParser(
+            description="Summarises the region profiles "
+                        "(profile ADP transactions) in a STDOUT log")
+    parser.add_argument(
+            'log_file',
+            help="File containing the M0N0 STDOUT")
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(message)s')
+    reader = ProfileReader(logging.getLogger(__name__))
+    with open(args.log_file, 'r') as f:
+        text = f.read()
+    for match in re.finditer(ADP_TX_REGEX, text):
+        reader.profile('profile', match.group(2), match.group(4))
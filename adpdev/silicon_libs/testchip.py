@@ -609,6 +609,18 @@ class M0N0S2(TestChip):
 
     RTC_PERIOD_US = 30.3030303  
     RTC_ONE_MS_TICKS = 33;
+    # SHRAM offset of the RTC calibration read by the M0N0 library
+    # (M0N0_RTC_CAL_SHRAM_ADDR: frequency in mHz, then its complement)
+    RTC_CAL_SHRAM_OFFSET = 0xFF8
+    # SHRAM offset of the sleep cost record (M0N0_SLEEP_COST_SHRAM_ADDR)
+    SLEEP_COST_SHRAM_OFFSET = RTC_CAL_SHRAM_OFFSET - 32
+    # SHRAM offset of the perf frequency table written by the M0N0 library
+    # (M0N0_PERF_FREQ_SHRAM_ADDR: kHz for each perf level, then a tag)
+    PERF_FREQ_SHRAM_OFFSET = SLEEP_COST_SHRAM_OFFSET - 128
+    PERF_FREQ_TAG = 0x46524551
+
+    # measured perf frequencies (see read_perf_freq_table)
+    _perf_freq_table = None
 
     @property
     def perf_labels(self):
@@ -656,8 +668,35 @@ class M0N0S2(TestChip):
         """
         if isinstance(perf, (str)):
             perf = self._perf_label_lookup[perf]
+        if self._perf_freq_table is not None:
+            return self._perf_freq_table[perf]
         return self._pcsm_regs.get_value_table('perf_ctrl','perf')[perf]
 
+    def read_perf_freq_table(self):
+        """Reads the core frequency of each perf level, as measured on the 
+        chip by M0N0_System::characterise_perf_freqs and stored in SHRAM. 
+        Once read, perf_to_freq_estimate uses these instead of the example 
+        values. 
+
+        :return: The frequency (MHz) for each perf HW ID, or None if the 
+                 table has not been characterised (invalid tag)
+        :rtype: dict
+        """
+        table_addr = (self._mem_map.get_base('SHRAM') 
+                + self.PERF_FREQ_SHRAM_OFFSET)
+        freqs_khz = [self._adp_sock.memory_read(table_addr + (i * 4)) 
+                for i in range(16)]
+        tag = self._adp_sock.memory_read(table_addr + (16 * 4))
+        if (sum(freqs_khz) == 0 or 
+                tag != (self.PERF_FREQ_TAG ^ (sum(freqs_khz) & 0xFFFFFFFF))):
+            self._logger.warning("Perf frequency table not characterised")
+            return None
+        self._perf_freq_table = {hw_id : freqs_khz[level] / 1000.0 
+                for level, hw_id in enumerate(self.ordered_perfs)}
+        self._logger.info("Perf frequency table read (MHz): {}".format(
+                [freqs_khz[level] / 1000.0 for level in range(16)]))
+        return self._perf_freq_table
+
     def set_perf(self, perf):
         """Sets the current perf (DVFS level) of the chip
 
@@ -1083,7 +1122,31 @@ class M0N0S2(TestChip):
                 'rtc_freq_hz' : rtc_freq }
 
     
-    def derive_rtc_trim(self, time_period_s=5, recursion_depth=14):
+    def write_rtc_calibration(self, rtc_freq_hz):
+        """Writes the measured RTC frequency to SHRAM, where it is used by 
+        the M0N0 library time conversions (M0N0_System::rtc_to_us etc.). 
+        It is loaded when the M0N0_System is constructed (or by calling 
+        load_rtc_calibration). 
+
+        :param rtc_freq_hz: The RTC frequency in Hz (e.g. from measure_rtc)
+        :type rtc_freq_hz: float
+        :return: The calibration value written (mHz)
+        :rtype: int
+        """
+        rtc_freq_millihz = int(round(rtc_freq_hz * 1000.0))
+        if rtc_freq_millihz < 4000000 or rtc_freq_millihz > 250000000:
+            raise ValueError("RTC frequency out of range: {:0.1f} Hz".format(
+                    rtc_freq_hz))
+        cal_addr = self._mem_map.get_base('SHRAM') + self.RTC_CAL_SHRAM_OFFSET
+        self._adp_sock.memory_write(cal_addr, rtc_freq_millihz)
+        self._adp_sock.memory_write(cal_addr + 4, 
+                                    (~rtc_freq_millihz) & 0xFFFFFFFF)
+        self._logger.info("RTC calibration written: {:d} mHz".format(
+                rtc_freq_millihz))
+        return rtc_freq_millihz
+
+    def derive_rtc_trim(self, time_period_s=5, recursion_depth=14,
+            write_calibration=True):
         """ Derives the RTC trim value for active mode. The result is printed to screen. 
 
         :param time_period_s: The time duration over which to measure the RTC
@@ -1092,6 +1155,12 @@ class M0N0S2(TestChip):
         :type time_period_s: int
         :param recursion_depth: Binary search recursion depth
         :type recursion_depth: int
+        :param write_calibration: Write the RTC frequency measured with the 
+                                  final trim to SHRAM (see 
+                                  write_rtc_calibration)
+        :type write_calibration: bool, optional
+        :return: The binary search result (including the final measurement)
+        :rtype: dict
         """
         self._logger.info("Enabling RTC Forward Body Bias (FBB)")
         self._pcsm_regs.write('rtc_ctrl1', 1, bit_group='en_fbb')
@@ -1122,6 +1191,9 @@ class M0N0S2(TestChip):
                 rtc_trim_inner,
                 args,
                 is_int=True)
+        if write_calibration:
+            self.write_rtc_calibration(temp_res['results']['rtc_freq_hz'])
+        return temp_res
 
     def derive_rtc_trim_timed_shutdown(self, time_period_s=5, recursion_depth=14):
         """ Derives the RTC trim value for timed-shutdown mode. The result is printed to screen. 
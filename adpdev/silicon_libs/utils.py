@@ -220,6 +220,12 @@ class AudioReader:
                         .format(
                         record_time_s,
                         tx_params['recording_rtc_cycles']))
+                if 'recording_awake_rtc_cycles' in tx_params:
+                    self._logger.info("CPU awake: {:0.1f} % ({:d} wake ups)"\
+                            .format(
+                            100.0 * tx_params['recording_awake_rtc_cycles'] 
+                            / max(tx_params['recording_rtc_cycles'], 1),
+                            tx_params.get('recording_wakeups', 0)))
         audio_lines = [x.strip() for x in tx_payload.strip().split('\n')]
         audio_words = [int(x,0) for x in audio_lines]
         def twos_comp(val, bits):
@@ -36,6 +36,9 @@ void set_state_finished(void);
 void buffer_read_error_callback(void);
 void extwake_callback(void);
 void audio_callback(void);
+// events:
+void start_recording_event(void);
+void send_recording_event(void);
 // audio sampling:
 void enable_uphone_sampling(uint32_t sample_interval_rtc_ticks);
 void disable_uphone_sampling();
@@ -50,12 +53,17 @@ CircBuffer audio_buf(
             NULL, // callback when full (NA if overwriting)
             NULL, // callback when removing from empty buf
             &buffer_read_error_callback); // callback when a read error
-volatile bool has_finished = false;
 uint32_t interval_rtc = 4 ;
 
+// The interrupt callbacks post events, which run in the main loop
+const uint32_t kStartRecordingEvent = 0;
+const uint32_t kSendRecordingEvent = 1;
+EventQueue events;
+
 // for timing audio sample
 RTCTimer audio_timer;
 uint32_t audio_recording_rtc_cycles = 0;
+uint32_t audio_recording_idle_cycles = 0;
 
 void set_state_idle() {
     M0N0_System* sys = M0N0_System::get_sys();
@@ -78,10 +86,8 @@ void buffer_read_error_callback() {
 
 void extwake_callback(void) {
     M0N0_System* sys = M0N0_System::get_sys();
-    sys->log_info("Extwake pressed");
     sys->disable_extwake_interrupt();
-    set_state_acquiring();
-    enable_uphone_sampling(interval_rtc);
+    events.post(kStartRecordingEvent);
 }
 
 void audio_callback(void) {
@@ -92,11 +98,36 @@ void audio_callback(void) {
     audio_buf.append(audio_frame);
     if (audio_buf.is_full()) {
         audio_recording_rtc_cycles = audio_timer.get_cycles();
+        audio_recording_idle_cycles = events.get_idle_ticks();
         sys->disable_autosampling();
-        has_finished = true;
+        events.post(kSendRecordingEvent);
     }
 }
 
+void start_recording_event(void) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    sys->log_info("Extwake pressed");
+    set_state_acquiring();
+    enable_uphone_sampling(interval_rtc);
+}
+
+void send_recording_event(void) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    set_state_finished();
+    sys->adp_tx_start("demoboard_audio");
+    sys->print("\nsample_freq_hz : 8000");
+    sys->print("\nperiod_rtc_ticks : %d", interval_rtc);
+    sys->print("\nrecording_rtc_cycles : %d", audio_recording_rtc_cycles);
+    // the CPU was in WFI for the rest of the recording:
+    sys->print("\nrecording_awake_rtc_cycles : %d", 
+            audio_recording_rtc_cycles - audio_recording_idle_cycles);
+    sys->print("\nrecording_wakeups : %d", events.get_wakeups());
+    sys->adp_tx_end_of_params();
+    audio_buf.send_via_adp();
+    sys->adp_tx_end();
+    sys->enable_extwake_interrupt(&extwake_callback);
+}
+
 void enable_uphone_sampling(uint32_t sample_interval_rtc_ticks) {
     // setting up SPI
     // In this specific example, this function is rather redundant
@@ -109,6 +140,7 @@ void enable_uphone_sampling(uint32_t sample_interval_rtc_ticks) {
             sample_interval_rtc_ticks,
             &audio_callback);
     audio_timer.reset();
+    events.reset_stats();
 }
 
 int main(void) {
@@ -131,22 +163,11 @@ int main(void) {
         audio_buf.store_to_shram();
     }
     sys->log_info("Setting up uphone");
+    events.add_event(kStartRecordingEvent, &start_recording_event);
+    events.add_event(kSendRecordingEvent, &send_recording_event);
     sys->enable_extwake_interrupt(&extwake_callback);
     sys->log_info("Running audio example");
-    while (1) {
-        if (has_finished) {
-            set_state_finished();
-            sys->adp_tx_start("demoboard_audio");
-            sys->print("\nsample_freq_hz : 8000");
-            sys->print("\nperiod_rtc_ticks : %d", interval_rtc);
-            sys->print("\nrecording_rtc_cycles : %d", audio_recording_rtc_cycles);
-            sys->adp_tx_end_of_params();
-            audio_buf.send_via_adp();
-            sys->adp_tx_end();
-            has_finished = false;
-            sys->enable_extwake_interrupt(&extwake_callback);
-        }
-    }
+    events.run(); // WFI (at perf 0 when not sampling) between events
     sys->log_info("Ending program"); // shouldn't reach this
 }
 
@@ -90,7 +90,7 @@ void run_kws(uint8_t global_verbose)
 	// reset buffers and constants
 	reset_system();
 
-	if (verbose) m0n0_printf("\n\n** STARTING KWS **\n\n");
+	if (verbose) M0N0_PRINTF_INFO("\n\n** STARTING KWS **\n\n");
 	// enable data from sensor
 	enable_data_from_sensor();
 
@@ -162,7 +162,7 @@ void enable_data_from_sensor()
 {
 	// set up interruptions
 	// Clear loop timer in case it has been running
-    m0n0_printf("A");
+    M0N0_PRINTF_DEBUG("A");
 	clear_loop_timer();
 	// Setup a looping timer interrupt in PCSM
 	set_loop_timer(4);
@@ -176,7 +176,7 @@ void enable_data_from_sensor()
 
 	// Enable polling bit
 	spi_enable_adc_polling();
-    m0n0_printf("B");
+    M0N0_PRINTF_DEBUG("B");
 }
 
 // Method called after a 40ms window is filled
@@ -189,9 +189,11 @@ void process_audio_window()
 	#endif
 
 	// compute mfcc
+	M0N0_PROFILE_BEGIN(mfcc);
 	mfcc_compute(&mfcc_conf,
 		(q15_t *)audio_buffer[compute_window_counter],
 		&mfcc_buffer[mfcc_window_counter * NUM_MFCC_COEFFS]);
+	M0N0_PROFILE_END(mfcc);
 
 	#ifdef M0N0_KWS_DEBUG
 	if (verbose) m0n0_printf("\nprocessed %u wc\n", mfcc_window_counter);
@@ -221,7 +223,9 @@ void classify()
 	if (!race_condition){
 		
 		// emulation of nn
+		M0N0_PROFILE_BEGIN(nn);
 		run_nn(mfcc_buffer, output);
+		M0N0_PROFILE_END(nn);
 		// softmax: could be removed
 		// should only the class be required
 		arm_softmax_q7(output, OUT_DIM, output);
@@ -251,16 +255,20 @@ void classify()
 		
 		// report
 		if (verbose){
-			m0n0_printf("\nC-%d, %d\n", classification_result, output[classification_result]);
+			M0N0_PRINTF_INFO("\nC-%d, %d\n", classification_result, output[classification_result]);
 		}
 		write_gpio(classification_result);
 	}else{
 		// report
 		if (verbose){
-			m0n0_printf("\nRC error\n");
+			M0N0_PRINTF_INFO("\nRC error\n");
 		}
 		write_gpio(RC_ERROR);
 	}
+	#ifdef M0N0_PROFILE
+	// mfcc/nn timing (decoded by adpdev)
+	if (verbose) M0N0_profile_send_via_adp();
+	#endif // M0N0_PROFILE
 	
 	// reset pointers
 	buff_counter = 0;
@@ -48,9 +48,7 @@ int main()
 
 
 uint32_t is_deve(void) {
-    return M0N0_read_bit_group(
-            STATUS_STATUS_7_REG,
-            STATUS_R07_DEVE_CORE_BIT_MASK);
+    return M0N0_is_deve(); // cached
 }
 
 void HardFault_Handler(void) {
@@ -43,19 +43,16 @@ void systick_callback(void) {
     sys->gpio->write_data(~sys->gpio->read_data()); // invert GPIO
 }
 
-void setup_systick(void) {
-    // in a function so that we can reset after hijacking 
-    //the systick for frequency measurement
-    M0N0_System* sys = M0N0_System::get_sys();
-    sys->enable_systick(2000000, &systick_callback);
-}
-
 int main(void) {
     LOG_LEVEL_t log_level = DEBUG;
     M0N0_System* sys = M0N0_System::get_sys(log_level);
     sys->set_recommended_settings();
     sys->log_info("Starting DVFS Example");
     sys->print_info();  // show print_info function
+    if (sys->is_vbat_por() || !sys->is_perf_freq_characterised()) {
+        // measure the frequency of each perf level once (kept in SHRAM)
+        sys->characterise_perf_freqs();
+    }
     // setup GPIO
     sys->gpio->set_direction(0xF); // set all four GPIOs to output
     sys->gpio->write_data(0x0); // set all four GPIOs to OFF
@@ -66,18 +63,23 @@ int main(void) {
     timer.set_interval_ms(1500);
     timer.reset();
     // setup SYSTICK
-    setup_systick();
+    sys->enable_systick(2000000, &systick_callback);
+    // track the frequency at the SysTick and EXTWAKE interrupts
+    sys->enable_tcro_tracking();
     while (1) {
         if (timer.check_interval()) {
             timer.reset();
             sys->log_info("==============");
         }
         if (sys->is_extwake()) { // displays current freq just before change
-            sys->log_info("Perf: %d, Estimated frequency: %d kHz ",
+            // (tracked in the background: the SysTick keeps running)
+            sys->log_info("Perf: %d, Estimated frequency: %d kHz "
+                    "(+/- %d ppm, characterised: %d kHz)",
                     sys->get_perf(),
-                    sys->estimate_tcro());
+                    sys->get_tcro_khz(),
+                    sys->get_tcro_error_ppm(),
+                    sys->get_perf_freq_khz(sys->get_perf()));
             while(sys->is_extwake());
-            setup_systick(); // must re-enable systick as estimate_tcro resets it
         }
         if (button_pressed) { // when extwake button released
             button_pressed = false;
@@ -31,11 +31,22 @@ const uint32_t kNumExtwakes = 5;
 const uint32_t kShramAddress = 29; // Any world-aligned unused shram address
 
 uint32_t extwake_count = 0;
+volatile bool gpio_due = false;
+volatile bool extwake_print_due = false;
 
 void extwake_func(void) {
     extwake_count++;
 }
 
+// SoftTimer callbacks (run in the interrupt: only set flags)
+void gpio_timer_func(void) {
+    gpio_due = true;
+}
+
+void extwake_timer_func(void) {
+    extwake_print_due = true;
+}
+
 void save_to_shutdown_ram() {
     M0N0_System* sys = M0N0_System::get_sys();
     sys->log_info("Saving extwake_count to Shutdown RAM");
@@ -70,17 +81,16 @@ int main(void)
     }
     sys->enable_extwake_interrupt(&extwake_func); // set EXTWAKE interrupt
     sys->gpio->set_direction(0xF); // Set GPIO as output
-    RTCTimer gpio_timer; // Setup GPIO software timer
-    gpio_timer.set_interval_ms(1500);
-    gpio_timer.reset();
-    RTCTimer extwake_timer; // Setup extwake print timer
-    extwake_timer.set_interval_ms(10000);
-    extwake_timer.reset();
+    // Both timers share the PCSM interrupt timer, so the loop can WFI
+    SoftTimer gpio_timer; // Setup GPIO software timer
+    gpio_timer.start_ms(1500, &gpio_timer_func, true);
+    SoftTimer extwake_timer; // Setup extwake print timer
+    extwake_timer.start_ms(10000, &extwake_timer_func, true);
     uint32_t gpio_count = 0;
     uint32_t loop_count = 0;
     while (1) {
-        if (gpio_timer.check_interval()) {
-            gpio_timer.reset();
+        if (gpio_due) {
+            gpio_due = false;
             if (gpio_count >= 15) {
                 gpio_count = 0;
             } else {
@@ -89,8 +99,8 @@ int main(void)
             sys->gpio->write_data(gpio_count);
             sys->log_info("GPIO: %d (loop count: %d)", gpio_count, loop_count);
         }
-        if (extwake_timer.check_interval()) {
-            extwake_timer.reset();
+        if (extwake_print_due) {
+            extwake_print_due = false;
             sys->log_info("EXTWAKE Count: %d", extwake_count);
             if ((extwake_count - last_extwake_count) >= kNumExtwakes) {
                 // if more than kNumExtwakes since last print, go to shutdown
@@ -100,7 +110,16 @@ int main(void)
             }
             last_extwake_count = extwake_count;
         }
-        loop_count++;
+        loop_count++; // (wake ups)
+        sys->clear_cpu_deepsleep();
+        __disable_irq();
+        // (interrupts are masked from the check to the WFI, so a timer 
+        // expiring in between still wakes it: its handler runs after)
+        if (!gpio_due && !extwake_print_due) {
+            __WFI();
+        }
+        __enable_irq();
+        M0N0_refresh_deve();
     }
     sys->log_info("Ending program");
 }
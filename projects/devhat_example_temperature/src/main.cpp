@@ -87,7 +87,7 @@ int16_t read_temperature() {
 void measure_and_store() {
     M0N0_System* sys = M0N0_System::get_sys();
     // measure:
-    uint32_t time_ms = sys->get_rtc_us()/1000;
+    uint32_t time_ms = (uint32_t)sys->get_time_ms();
     int16_t temperature = read_temperature();
     // store:
     time_buf.append(time_ms);
@@ -164,6 +164,20 @@ void timed_shutdown(uint32_t interval_ms) {
     sys->timed_shutdown_ms(interval_ms);
 }
 
+void planned_sleep(uint32_t interval_ms) {
+    M0N0_System* sys = M0N0_System::get_sys();
+    sys->print("===========================\n");
+    sys->log_info("Example E: Planned sleep");
+    sys->print("===========================\n");
+    while (1) {
+        measure_and_store();
+        time_buf.store_to_shram(); // in case a timed shutdown is chosen
+        temperature_buf.store_to_shram();
+        // the buffers are in SHRAM, so a timed shutdown is allowed:
+        sys->sleep_for_ms(interval_ms, RETAIN_SHRAM);
+    }
+}
+
 int main(void) {
     LOG_LEVEL_t log_level = DEBUG;
     M0N0_System* sys = M0N0_System::get_sys(log_level);
@@ -198,6 +212,8 @@ int main(void) {
         sys->log_info("Initialising");
         time_buf.store_to_shram();
         temperature_buf.store_to_shram();
+        // measure the sleep entry/exit costs once (kept in SHRAM)
+        sys->characterise_sleep();
     }
     sys->log_info("Setting up sensor");
     setup_temperature_sensor();
@@ -209,6 +225,7 @@ int main(void) {
     //blocking_sw_timer_low_power(interval_ms);
     //blocking_inttimer_timer_low_power(interval_ms);
     //timed_shutdown(interval_ms);
+    //planned_sleep(interval_ms);
     /*
      * ^^ Uncomment to leave the remaining timer above ^^
      */